@@ -0,0 +1,53 @@
+﻿#include "file_system.h"
+#include <fstream>
+#include <iostream>
+
+template<> FileSystem* Singleton<FileSystem>::singleton = nullptr;
+
+bool FileSystem::mount(const std::string& pack_path)
+{
+	std::unique_ptr<PackFile> pack(new PackFile());
+	if (!pack->open(pack_path))
+	{
+		std::cout << "FileSystem can not mount " << pack_path << ", reading loose files" << std::endl;
+		return false;
+	}
+	std::cout << "FileSystem mounted " << pack_path << " with " << pack->get_entry_count() << " files" << std::endl;
+	_packs.insert(_packs.begin(), std::move(pack));
+	return true;
+}
+
+bool FileSystem::exists(const std::string& path) const
+{
+	for (const auto& pack : _packs)
+	{
+		if (pack->find(path))
+			return true;
+	}
+	return std::ifstream(path).good();
+}
+
+bool FileSystem::read(const std::string& path, FileData& file) const
+{
+	for (const auto& pack : _packs)
+	{
+		if (const PackFile::Entry* entry = pack->find(path))
+			return pack->read(*entry, file.data, file.size, file.storage);
+	}
+	return read_loose(path, file);
+}
+
+bool FileSystem::read_loose(const std::string& path, FileData& file)
+{
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream)
+		return false;
+	const std::streamoff size = stream.tellg();
+	file.storage.resize((size_t)size);
+	stream.seekg(0);
+	if (size > 0 && !stream.read(reinterpret_cast<char*>(file.storage.data()), size))
+		return false;
+	file.data = file.storage.data();
+	file.size = file.storage.size();
+	return true;
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "singleton.h"
+#include "pack_file.h"
+
+// Contents of a file, pointing into a mounted pack or owned by storage.
+// Keep it alive while data is in use.
+struct FileData
+{
+	const unsigned char* data{ nullptr };
+	size_t size{ 0 };
+	std::vector<unsigned char> storage{ };
+};
+
+// Resolves asset paths against the mounted packs first and falls back to loose files.
+// Mounting is not thread safe, reading is.
+class FileSystem : public Singleton<FileSystem>
+{
+public:
+	FileSystem() = default;
+	~FileSystem() = default;
+
+	FileSystem(const FileSystem&) = delete;
+	FileSystem(FileSystem&&) = delete;
+	FileSystem& operator=(const FileSystem&) = delete;
+	FileSystem& operator=(FileSystem&&) = delete;
+
+	// packs mounted later take precedence
+	bool mount(const std::string& pack_path);
+	void unmount_all() { _packs.clear(); }
+	size_t get_pack_count() const { return _packs.size(); }
+
+	bool exists(const std::string& path) const;
+	bool read(const std::string& path, FileData& file) const;
+	// skips the packs, for files edited while running
+	static bool read_loose(const std::string& path, FileData& file);
+
+private:
+	std::vector<std::unique_ptr<PackFile>> _packs{ };
+};
@@ -0,0 +1,154 @@
+﻿#include "file_watcher.h"
+#include <chrono>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	std::string get_directory(const std::string& path)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+#ifndef __linux__
+	long long get_modification_time(const std::string& path)
+	{
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? (long long)info.st_mtime : -1;
+	}
+#endif
+}
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+	_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotify < 0)
+	{
+		std::cout << "FileWatcher can not create an inotify instance" << std::endl;
+		return;
+	}
+#endif
+	_thread = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_condition.notify_all();
+	if (_thread.joinable())
+		_thread.join();
+#ifdef __linux__
+	if (_inotify >= 0)
+		close(_inotify);
+#endif
+}
+
+bool FileWatcher::watch(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+#ifdef __linux__
+	if (_inotify < 0)
+		return false;
+	if (!_files.insert(path).second)
+		return true;
+
+	const std::string directory = get_directory(path);
+	for (const auto& pair : _directories)
+	{
+		if (pair.second == directory)
+			return true;
+	}
+	const int wd = inotify_add_watch(_inotify, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0)
+	{
+		std::cout << "FileWatcher can not watch " << path << std::endl;
+		_files.erase(path);
+		return false;
+	}
+	_directories[wd] = directory;
+#else
+	if (_files.find(path) == _files.end())
+		_files[path] = get_modification_time(path);
+#endif
+	return true;
+}
+
+std::vector<std::string> FileWatcher::take_changed()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<std::string> changed(_changed.begin(), _changed.end());
+	_changed.clear();
+	return changed;
+}
+
+void FileWatcher::add_changed(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+#ifdef __linux__
+	if (_files.find(path) != _files.end())
+		_changed.insert(path);
+#else
+	_changed.insert(path);
+#endif
+}
+
+void FileWatcher::run()
+{
+#ifdef __linux__
+	alignas(struct inotify_event) char buffer[4096];
+	while (_running)
+	{
+		// wakes up regularly to notice the destructor
+		pollfd fd{ _inotify, POLLIN, 0 };
+		if (poll(&fd, 1, 100) <= 0)
+			continue;
+
+		ssize_t length;
+		while ((length = read(_inotify, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* p = buffer; p < buffer + length; )
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+				p += sizeof(inotify_event) + event->len;
+				if (event->len == 0)
+					continue;
+
+				std::string directory;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					const auto iter = _directories.find(event->wd);
+					if (iter == _directories.end())
+						continue;
+					directory = iter->second;
+				}
+				add_changed(directory + event->name);
+			}
+		}
+	}
+#else
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (_running)
+	{
+		_condition.wait_for(lock, std::chrono::milliseconds(250));
+		for (auto& pair : _files)
+		{
+			const long long time = get_modification_time(pair.first);
+			if (time != pair.second)
+			{
+				pair.second = time;
+				_changed.insert(pair.first);
+			}
+		}
+	}
+#endif
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches loose files on a background thread. Uses inotify on Linux, where the directories are
+// watched so that editors saving through a rename are seen as well, and polls modification times
+// elsewhere. Changes are collected until take_changed is called.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher(FileWatcher&&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+	FileWatcher& operator=(FileWatcher&&) = delete;
+
+	// the path is reported as given, watching it again does nothing
+	bool watch(const std::string& path);
+	// the paths changed since the last call, each one once
+	std::vector<std::string> take_changed();
+
+private:
+	void run();
+	void add_changed(const std::string& path);
+
+	std::thread _thread{ };
+	std::atomic<bool> _running{ true };
+	std::mutex _mutex{ };
+	std::condition_variable _condition{ };
+	std::set<std::string> _changed{ };
+#ifdef __linux__
+	int _inotify{ -1 };
+	std::map<int, std::string> _directories{ };		// watch descriptor to directory
+	std::set<std::string> _files{ };
+#else
+	std::map<std::string, long long> _files{ };		// path to last modification time
+#endif
+};
@@ -0,0 +1,49 @@
+﻿#include "frame_arena.h"
+#include <cstdint>
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (_blocks.empty() || _offset + size + alignment > _blocks.back().size)
+	{
+		// large enough for the allocation whatever the alignment of the block
+		add_block(std::max(_block_size, size + alignment));
+	}
+
+	Block& block = _blocks.back();
+	const uintptr_t base = (uintptr_t)block.data.get();
+	const size_t offset = (size_t)(((base + _offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+	_offset = offset + size;
+	_stats.used = _used_before + _offset;
+	_stats.peak = std::max(_stats.peak, _stats.used);
+	return block.data.get() + offset;
+}
+
+void FrameArena::reset()
+{
+	// the blocks of a frame that did not fit in one become a single block for the next
+	if (_blocks.size() > 1)
+	{
+		size_t size = 0;
+		for (const auto& block : _blocks)
+		{
+			size += block.size;
+		}
+		_blocks.clear();
+		_stats.capacity = 0;
+		add_block(size);
+	}
+	_offset = 0;
+	_used_before = 0;
+	_stats.used = 0;
+}
+
+void FrameArena::add_block(size_t size)
+{
+	if (!_blocks.empty())
+		_used_before += _offset;
+	_offset = 0;
+	_blocks.push_back(Block{ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+	_stats.capacity += size;
+	++_stats.heap_allocations;
+}
@@ -0,0 +1,127 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for the data of a single frame. Allocations bump an offset into blocks kept from
+// frame to frame, reset drops them all at once without destroying anything. A frame outgrowing the
+// blocks gets another one, and reset merges them into a single block, so that steady frames do not
+// touch the heap.
+class FrameArena
+{
+public:
+	struct Stats
+	{
+		size_t used;					// by the frame so far, alignment padding included
+		size_t peak;					// the most a frame used
+		size_t capacity;
+		unsigned int heap_allocations;	// of blocks, since the arena was created
+	};
+
+	explicit FrameArena(size_t block_size = 64 * 1024) : _block_size(block_size) { }
+	~FrameArena() = default;
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena(FrameArena&&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+	FrameArena& operator=(FrameArena&&) = delete;
+
+	void* allocate(size_t size, size_t alignment);
+	// uninitialized, the elements are never destroyed
+	template<typename T>
+	T* allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "frame arena memory is dropped without destruction");
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+	// everything allocated before is invalid afterwards
+	void reset();
+
+	const Stats& get_stats() const { return _stats; }
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+	};
+	void add_block(size_t size);
+
+	std::vector<Block> _blocks{ };
+	size_t _block_size;
+	size_t _offset{ 0 };		// into the last block
+	size_t _used_before{ 0 };	// in the blocks before the last
+	Stats _stats{ };
+};
+
+// Growable array in frame arena memory. Growing copies the elements into a larger allocation and
+// leaves the old one to the arena until its reset. clear lets go of the storage as well, so that an
+// array cleared at the start of its frame never points into memory of the frame before.
+template<typename T>
+class FrameArray
+{
+public:
+	explicit FrameArray(FrameArena& arena) : _arena(&arena) { }
+
+	FrameArray(const FrameArray&) = delete;
+	FrameArray& operator=(const FrameArray&) = delete;
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	T* data() { return _data; }
+	const T* data() const { return _data; }
+	T* begin() { return _data; }
+	T* end() { return _data + _size; }
+	const T* begin() const { return _data; }
+	const T* end() const { return _data + _size; }
+	T& operator[](size_t index) { assert(index < _size); return _data[index]; }
+	const T& operator[](size_t index) const { assert(index < _size); return _data[index]; }
+
+	void clear()
+	{
+		_data = nullptr;
+		_size = 0;
+		_capacity = 0;
+	}
+
+	void reserve(size_t capacity)
+	{
+		if (capacity <= _capacity)
+			return;
+		T* data = _arena->allocate<T>(capacity);
+		for (size_t i = 0; i < _size; ++i)
+		{
+			new (&data[i]) T(_data[i]);
+		}
+		_data = data;
+		_capacity = capacity;
+	}
+
+	void resize(size_t size)
+	{
+		reserve(size);
+		for (size_t i = _size; i < size; ++i)
+		{
+			new (&_data[i]) T();
+		}
+		_size = size;
+	}
+
+	void push_back(const T& value)
+	{
+		if (_size == _capacity)
+			reserve(std::max<size_t>(_capacity * 2, 16));
+		new (&_data[_size++]) T(value);
+	}
+
+private:
+	FrameArena* _arena;
+	T* _data{ nullptr };
+	size_t _size{ 0 };
+	size_t _capacity{ 0 };
+};
@@ -0,0 +1,23 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit FNV-1a, pass a previous result as seed to hash several buffers as one
+inline uint64_t hash_fnv1a(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline uint64_t hash_fnv1a(const std::string& str, uint64_t seed = 14695981039346656037ull)
+{
+	return hash_fnv1a(str.data(), str.size(), seed);
+}
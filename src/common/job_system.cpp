@@ -0,0 +1,126 @@
+﻿#include "job_system.h"
+#include <algorithm>
+#include <string>
+#include "profiler.h"
+
+template<> JobSystem* Singleton<JobSystem>::singleton = nullptr;
+
+JobSystem::JobSystem(unsigned int worker_count)
+{
+	if (worker_count == 0)
+	{
+		const unsigned int threads = std::thread::hardware_concurrency();
+		worker_count = threads > 1 ? threads - 1 : 1;
+	}
+	_workers.reserve(worker_count);
+	for (unsigned int i = 0; i < worker_count; ++i)
+	{
+		_workers.emplace_back(&JobSystem::worker_loop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_condition.notify_all();
+	for (auto& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::submit(Job job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+	_condition.notify_one();
+}
+
+void JobSystem::parallel_for(size_t count, const std::function<void(size_t)>& func)
+{
+	if (count == 0)
+		return;
+
+	// workers join the task only while it is listed, and it is unlisted before waiting for those that did
+	Task task;
+	task.func = &func;
+	task.count = count;
+	task.next = 0;
+	task.helpers = 0;
+	if (count > 1 && !_workers.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_tasks.push_back(&task);
+		}
+		_condition.notify_all();
+	}
+	run_task(task);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	const auto iter = std::find(_tasks.begin(), _tasks.end(), &task);
+	if (iter != _tasks.end())
+		_tasks.erase(iter);
+	_task_finished.wait(lock, [&task]() { return task.helpers == 0; });
+}
+
+void JobSystem::run_task(Task& task)
+{
+	for (size_t i = task.next++; i < task.count; i = task.next++)
+	{
+		(*task.func)(i);
+	}
+}
+
+JobSystem::Task* JobSystem::find_open_task() const
+{
+	for (Task* task : _tasks)
+	{
+		if (task->next.load() < task->count)
+			return task;
+	}
+	return nullptr;
+}
+
+void JobSystem::worker_loop(unsigned int index)
+{
+	Profiler::set_thread_name("worker " + std::to_string(index));
+	for (;;)
+	{
+		Job job;
+		Task* task = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this, &task]() { return (task = find_open_task()) != nullptr || _quit || !_jobs.empty(); });
+			// a parallel_for goes first, its caller is waiting
+			if (task)
+			{
+				++task->helpers;
+			}
+			else if (_jobs.empty())
+			{
+				return;
+			}
+			else
+			{
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+		}
+		if (task)
+		{
+			run_task(*task);
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--task->helpers == 0)
+				_task_finished.notify_all();
+			continue;
+		}
+		PROFILE_ZONE("JobSystem::job");
+		job();
+	}
+}
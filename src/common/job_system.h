@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "singleton.h"
+
+// Fixed pool of worker threads shared by the engine.
+class JobSystem : public Singleton<JobSystem>
+{
+public:
+	typedef std::function<void()> Job;
+
+	// worker_count 0 uses one worker per hardware thread except the calling one
+	explicit JobSystem(unsigned int worker_count = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem(JobSystem&&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	JobSystem& operator=(JobSystem&&) = delete;
+
+	// Queues a job and returns immediately.
+	void submit(Job job);
+
+	// Runs func(i) for every i in [0, count) and returns once all calls finished.
+	// The calling thread takes part, so this may be called from a job as well. Idle workers join in,
+	// nothing is allocated.
+	void parallel_for(size_t count, const std::function<void(size_t)>& func);
+
+	unsigned int get_worker_count() const { return (unsigned int)_workers.size(); }
+
+private:
+	// a parallel_for, on the stack of its caller
+	struct Task
+	{
+		const std::function<void(size_t)>* func;
+		size_t count;
+		std::atomic<size_t> next;
+		unsigned int helpers;	// workers running it, under the mutex
+	};
+	static void run_task(Task& task);
+	// a listed task with indices left, under the mutex
+	Task* find_open_task() const;
+	void worker_loop(unsigned int index);
+
+	std::vector<std::thread> _workers{ };
+	std::deque<Job> _jobs{ };
+	std::vector<Task*> _tasks{ };
+	std::condition_variable _task_finished{ };
+	std::mutex _mutex{ };
+	std::condition_variable _condition{ };
+	bool _quit{ false };
+};
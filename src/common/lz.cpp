@@ -0,0 +1,142 @@
+﻿#include "lz.h"
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	const size_t MIN_MATCH = 4;
+	const size_t LAST_LITERALS = 5;	// the tail is always stored as literals
+	const size_t MAX_OFFSET = 65535;
+	const unsigned int HASH_BITS = 14;
+
+	inline uint32_t read32(const unsigned char* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline void write_length(std::vector<unsigned char>& dst, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			dst.push_back(255);
+		}
+		dst.push_back((unsigned char)length);
+	}
+
+	inline bool read_length(const unsigned char*& src, const unsigned char* end, size_t& length)
+	{
+		for (;;)
+		{
+			if (src == end)
+				return false;
+			const unsigned char value = *src++;
+			length += value;
+			if (value != 255)
+				return true;
+		}
+	}
+
+	void write_sequence(std::vector<unsigned char>& dst, const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length)
+	{
+		const size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+		dst.push_back((unsigned char)(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15)));
+		if (literal_length >= 15)
+			write_length(dst, literal_length - 15);
+		dst.insert(dst.end(), literals, literals + literal_length);
+		if (match_length == 0)
+			return;
+		dst.push_back((unsigned char)(offset & 0xff));
+		dst.push_back((unsigned char)(offset >> 8));
+		if (match_code >= 15)
+			write_length(dst, match_code - 15);
+	}
+}
+
+size_t lz_compress(const void* src, size_t size, std::vector<unsigned char>& dst)
+{
+	const unsigned char* in = static_cast<const unsigned char*>(src);
+	const size_t begin = dst.size();
+	std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);	// last position + 1 of each hashed sequence
+
+	size_t anchor = 0;
+	size_t pos = 0;
+	while (pos + MIN_MATCH + LAST_LITERALS <= size)
+	{
+		const uint32_t sequence = read32(in + pos);
+		const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+		const size_t candidate = table[hash];
+		table[hash] = (uint32_t)(pos + 1);
+		if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET || read32(in + candidate - 1) != sequence)
+		{
+			++pos;
+			continue;
+		}
+
+		const size_t match = candidate - 1;
+		size_t length = MIN_MATCH;
+		while (pos + length < size - LAST_LITERALS && in[match + length] == in[pos + length])
+			++length;
+
+		write_sequence(dst, in + anchor, pos - anchor, pos - match, length);
+		pos += length;
+		anchor = pos;
+		if (dst.size() - begin >= size)
+			break;
+	}
+	write_sequence(dst, in + anchor, size - anchor, 0, 0);
+
+	if (dst.size() - begin >= size)
+	{
+		dst.resize(begin);
+		return 0;
+	}
+	return dst.size() - begin;
+}
+
+bool lz_decompress(const void* src, size_t src_size, void* dst, size_t dst_size)
+{
+	const unsigned char* in = static_cast<const unsigned char*>(src);
+	const unsigned char* const in_end = in + src_size;
+	unsigned char* out = static_cast<unsigned char*>(dst);
+	unsigned char* const out_begin = out;
+	unsigned char* const out_end = out + dst_size;
+
+	while (in < in_end)
+	{
+		const unsigned char token = *in++;
+		size_t literal_length = token >> 4;
+		if (literal_length == 15 && !read_length(in, in_end, literal_length))
+			return false;
+		if (literal_length > size_t(in_end - in) || literal_length > size_t(out_end - out))
+			return false;
+		memcpy(out, in, literal_length);
+		in += literal_length;
+		out += literal_length;
+
+		// the last sequence has literals only
+		if (in == in_end)
+			break;
+
+		if (in_end - in < 2)
+			return false;
+		const size_t offset = in[0] | (size_t(in[1]) << 8);
+		in += 2;
+		size_t match_length = token & 15;
+		if (match_length == 15 && !read_length(in, in_end, match_length))
+			return false;
+		match_length += MIN_MATCH;
+		if (offset == 0 || offset > size_t(out - out_begin) || match_length > size_t(out_end - out))
+			return false;
+
+		// byte by byte since the match may overlap the bytes it produces
+		const unsigned char* match = out - offset;
+		for (size_t i = 0; i < match_length; ++i)
+		{
+			out[i] = match[i];
+		}
+		out += match_length;
+	}
+	return out == out_end;
+}
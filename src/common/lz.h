@@ -0,0 +1,13 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Byte oriented LZ77 in the spirit of LZ4, cheap enough to inflate assets while loading.
+// Each sequence is a token (literal length, match length), the literals, then a 16 bit match offset.
+
+// Appends the compressed data to dst and returns its size, 0 when it would not be smaller than the input.
+size_t lz_compress(const void* src, size_t size, std::vector<unsigned char>& dst);
+
+// Returns false on corrupted input or when the data does not inflate to exactly dst_size bytes.
+bool lz_decompress(const void* src, size_t src_size, void* dst, size_t dst_size);
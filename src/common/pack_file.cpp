@@ -0,0 +1,219 @@
+﻿#include "pack_file.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "hash.h"
+#include "lz.h"
+
+static_assert(sizeof(PackFile::Header) == 32, "pack header layout");
+static_assert(sizeof(PackFile::Entry) == 48, "pack entry layout");
+
+bool PackFile::open(const std::string& path)
+{
+	close();
+	if (!_file.open(path))
+		return false;
+
+	const unsigned char* data = _file.data();
+	const size_t size = _file.size();
+	const Header* header = reinterpret_cast<const Header*>(data);
+	if (size < sizeof(Header) || header->magic != MAGIC || header->version != VERSION ||
+		header->toc_offset % alignof(Entry) != 0 ||
+		header->toc_offset + uint64_t(header->entry_count) * sizeof(Entry) > header->names_offset || header->names_offset > size)
+	{
+		std::cout << "PackFile invalid header: " << path << std::endl;
+		_file.close();
+		return false;
+	}
+	const Entry* entries = reinterpret_cast<const Entry*>(data + header->toc_offset);
+	for (uint32_t i = 0; i < header->entry_count; ++i)
+	{
+		const Entry& entry = entries[i];
+		if (entry.offset + entry.stored_size > header->toc_offset || header->names_offset + entry.name_offset + entry.name_length > size)
+		{
+			std::cout << "PackFile invalid entry " << i << ": " << path << std::endl;
+			_file.close();
+			return false;
+		}
+	}
+
+	_path = path;
+	_header = header;
+	_entries = entries;
+	_names = reinterpret_cast<const char*>(data + header->names_offset);
+	return true;
+}
+
+void PackFile::close()
+{
+	_file.close();
+	_path.clear();
+	_header = nullptr;
+	_entries = nullptr;
+	_names = nullptr;
+}
+
+const PackFile::Entry* PackFile::find(const std::string& path) const
+{
+	if (!_header)
+		return nullptr;
+
+	const std::string name = normalize_path(path);
+	const uint64_t hash = hash_fnv1a(name);
+	const Entry* end = _entries + _header->entry_count;
+	const Entry* entry = std::lower_bound(_entries, end, hash, [](const Entry& lhs, uint64_t value) { return lhs.hash < value; });
+	for (; entry != end && entry->hash == hash; ++entry)
+	{
+		if (entry->name_length == name.size() && memcmp(_names + entry->name_offset, name.data(), name.size()) == 0)
+			return entry;
+	}
+	return nullptr;
+}
+
+bool PackFile::read(const Entry& entry, const unsigned char*& data, size_t& size, std::vector<unsigned char>& storage) const
+{
+	const unsigned char* blob = _file.data() + entry.offset;
+	switch ((Compression)entry.compression)
+	{
+	case Compression::None:
+		data = blob;
+		size = (size_t)entry.size;
+		return true;
+	case Compression::LZ:
+		storage.resize((size_t)entry.size);
+		if (!lz_decompress(blob, (size_t)entry.stored_size, storage.data(), storage.size()))
+		{
+			std::cout << "PackFile corrupted entry: " << std::string(_names + entry.name_offset, entry.name_length) << std::endl;
+			return false;
+		}
+		data = storage.data();
+		size = storage.size();
+		return true;
+	default:
+		return false;
+	}
+}
+
+std::string PackFile::normalize_path(const std::string& path)
+{
+	std::vector<std::string> parts;
+	size_t begin = 0;
+	while (begin <= path.size())
+	{
+		size_t end = path.find_first_of("/\\", begin);
+		if (end == std::string::npos)
+			end = path.size();
+		const std::string part = path.substr(begin, end - begin);
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (!part.empty() && part != ".")
+			parts.push_back(part);
+		begin = end + 1;
+	}
+
+	std::string result = !path.empty() && (path[0] == '/' || path[0] == '\\') ? "/" : "";
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		if (i > 0)
+			result += '/';
+		result += parts[i];
+	}
+	return result;
+}
+
+void PackWriter::add(const std::string& path, const std::vector<unsigned char>& data, bool compress)
+{
+	Item item;
+	item.name = PackFile::normalize_path(path);
+	item.compression = PackFile::Compression::None;
+	item.size = data.size();
+	if (compress && lz_compress(data.data(), data.size(), item.data) > 0 && item.data.size() <= data.size() - data.size() / 10)
+	{
+		item.compression = PackFile::Compression::LZ;
+	}
+	else
+	{
+		item.data = data;
+	}
+	_entries.push_back(std::move(item));
+}
+
+bool PackWriter::write(const std::string& path) const
+{
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "PackWriter can not open " << path << std::endl;
+		return false;
+	}
+
+	std::vector<PackFile::Entry> entries(_entries.size());
+	std::string names;
+	uint64_t offset = PackFile::ALIGNMENT;
+	for (size_t i = 0; i < _entries.size(); ++i)
+	{
+		const Item& item = _entries[i];
+		PackFile::Entry& entry = entries[i];
+		memset(&entry, 0, sizeof(entry));
+		entry.hash = hash_fnv1a(item.name);
+		entry.offset = offset;
+		entry.stored_size = item.data.size();
+		entry.size = item.size;
+		entry.compression = (uint32_t)item.compression;
+		entry.name_offset = (uint32_t)names.size();
+		entry.name_length = (uint32_t)item.name.size();
+		names += item.name;
+		offset = (offset + item.data.size() + PackFile::ALIGNMENT - 1) & ~uint64_t(PackFile::ALIGNMENT - 1);
+	}
+
+	PackFile::Header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = PackFile::MAGIC;
+	header.version = PackFile::VERSION;
+	header.entry_count = (uint32_t)entries.size();
+	header.toc_offset = offset;
+	header.names_offset = offset + entries.size() * sizeof(PackFile::Entry);
+
+	const std::vector<char> padding(PackFile::ALIGNMENT, 0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(padding.data(), PackFile::ALIGNMENT - sizeof(header));
+	for (size_t i = 0; i < _entries.size(); ++i)
+	{
+		const std::vector<unsigned char>& data = _entries[i].data;
+		stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+		const size_t end = (size_t)(entries[i].offset + data.size());
+		const size_t next = i + 1 < entries.size() ? (size_t)entries[i + 1].offset : (size_t)header.toc_offset;
+		stream.write(padding.data(), next - end);
+	}
+
+	std::stable_sort(entries.begin(), entries.end(), [](const PackFile::Entry& lhs, const PackFile::Entry& rhs) { return lhs.hash < rhs.hash; });
+	stream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackFile::Entry));
+	stream.write(names.data(), names.size());
+	if (!stream)
+	{
+		std::cout << "PackWriter failed writing " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+size_t PackWriter::get_total_size() const
+{
+	size_t size = 0;
+	for (const auto& item : _entries)
+	{
+		size += item.size;
+	}
+	return size;
+}
+
+size_t PackWriter::get_stored_size() const
+{
+	size_t size = 0;
+	for (const auto& item : _entries)
+	{
+		size += item.data.size();
+	}
+	return size;
+}
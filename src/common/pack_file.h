@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+// Read only archive of asset files. The file starts with a header, followed by the blobs aligned
+// to ALIGNMENT, the table of contents sorted by path hash and the path names used to resolve collisions.
+class PackFile
+{
+public:
+	static const uint32_t MAGIC = 0x4b415047;	// "GPAK"
+	static const uint32_t VERSION = 1;
+	static const size_t ALIGNMENT = 64;
+
+	enum class Compression : uint32_t
+	{
+		None = 0,
+		LZ
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entry_count;
+		uint32_t reserved;
+		uint64_t toc_offset;
+		uint64_t names_offset;
+	};
+
+	struct Entry
+	{
+		uint64_t hash;	// of the normalized path
+		uint64_t offset;
+		uint64_t stored_size;
+		uint64_t size;
+		uint32_t compression;
+		uint32_t name_offset;
+		uint32_t name_length;
+		uint32_t reserved;
+	};
+
+	PackFile() = default;
+	~PackFile() = default;
+
+	PackFile(const PackFile&) = delete;
+	PackFile(PackFile&&) = delete;
+	PackFile& operator=(const PackFile&) = delete;
+	PackFile& operator=(PackFile&&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	const Entry* find(const std::string& path) const;
+	// data points into the mapping unless the entry is compressed, then it is inflated into storage
+	bool read(const Entry& entry, const unsigned char*& data, size_t& size, std::vector<unsigned char>& storage) const;
+
+	size_t get_entry_count() const { return _header ? _header->entry_count : 0; }
+	const std::string& get_path() const { return _path; }
+
+	// forward slashes, no "." or ".." components
+	static std::string normalize_path(const std::string& path);
+
+private:
+	MappedFile _file{ };
+	std::string _path{ "" };
+	const Header* _header{ nullptr };
+	const Entry* _entries{ nullptr };
+	const char* _names{ nullptr };
+};
+
+// Builds a pack file, used by the asset packer tool.
+class PackWriter
+{
+public:
+	// compressed entries are only kept when they save at least a tenth of the size
+	void add(const std::string& path, const std::vector<unsigned char>& data, bool compress);
+	bool write(const std::string& path) const;
+
+	size_t get_entry_count() const { return _entries.size(); }
+	size_t get_total_size() const;
+	size_t get_stored_size() const;
+
+private:
+	struct Item
+	{
+		std::string name;
+		PackFile::Compression compression;
+		size_t size;
+		std::vector<unsigned char> data;
+	};
+	std::vector<Item> _entries{ };
+};
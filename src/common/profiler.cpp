@@ -0,0 +1,152 @@
+﻿#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+template<> Profiler* Singleton<Profiler>::singleton = nullptr;
+
+thread_local Profiler::ThreadBuffer* Profiler::_thread_buffer = nullptr;
+thread_local uint64_t Profiler::_thread_buffer_owner = 0;
+thread_local std::string Profiler::_thread_name;
+
+namespace
+{
+	std::atomic<uint64_t> next_profiler_id{ 1 };
+
+	std::string escape_json(const std::string& text)
+	{
+		std::string escaped;
+		for (const char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+}
+
+Profiler::Profiler(size_t events_per_thread)
+	: _events_per_thread(std::max(events_per_thread, (size_t)1))
+	, _id(next_profiler_id++)
+{
+}
+
+void Profiler::clear()
+{
+	std::lock_guard<std::mutex> lock(_buffers_mutex);
+	for (auto& buffer : _buffers)
+	{
+		std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+		buffer->next = 0;
+		buffer->count = 0;
+	}
+}
+
+void Profiler::set_thread_name(const std::string& name)
+{
+	_thread_name = name;
+	const Profiler* profiler = get_singletonPtr();
+	if (profiler && _thread_buffer && _thread_buffer_owner == profiler->_id)
+	{
+		std::lock_guard<std::mutex> lock(_thread_buffer->mutex);
+		_thread_buffer->thread_name = name;
+	}
+}
+
+uint64_t Profiler::now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end)
+{
+	write_event(get_thread_buffer(), name, start, end);
+}
+
+void Profiler::record_gpu(const char* name, uint64_t start, uint64_t end)
+{
+	if (!_gpu_buffer)
+		_gpu_buffer = add_buffer("GPU");
+	write_event(*_gpu_buffer, name, start, end);
+}
+
+void Profiler::write_event(ThreadBuffer& buffer, const char* name, uint64_t start, uint64_t end)
+{
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.events[buffer.next] = { name, start, end };
+	buffer.next = (buffer.next + 1) % buffer.events.size();
+	buffer.count = std::min(buffer.count + 1, buffer.events.size());
+}
+
+Profiler::ThreadBuffer& Profiler::get_thread_buffer()
+{
+	if (_thread_buffer && _thread_buffer_owner == _id)
+		return *_thread_buffer;
+
+	_thread_buffer = add_buffer(_thread_name);
+	_thread_buffer_owner = _id;
+	return *_thread_buffer;
+}
+
+Profiler::ThreadBuffer* Profiler::add_buffer(const std::string& name)
+{
+	std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+	buffer->events.resize(_events_per_thread);
+	buffer->next = 0;
+	buffer->count = 0;
+	buffer->thread_name = name;
+	std::lock_guard<std::mutex> lock(_buffers_mutex);
+	buffer->thread_id = (unsigned int)_buffers.size() + 1;
+	if (buffer->thread_name.empty())
+		buffer->thread_name = "thread " + std::to_string(buffer->thread_id);
+	_buffers.push_back(std::move(buffer));
+	return _buffers.back().get();
+}
+
+bool Profiler::write_chrome_trace(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "Failed to open trace " << path << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_buffers_mutex);
+	// timestamps start at the first zone, in microseconds
+	uint64_t origin = UINT64_MAX;
+	for (const auto& buffer : _buffers)
+	{
+		std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+		const size_t first = (buffer->next + buffer->events.size() - buffer->count) % buffer->events.size();
+		for (size_t i = 0; i < buffer->count; ++i)
+		{
+			origin = std::min(origin, buffer->events[(first + i) % buffer->events.size()].start);
+		}
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first_event = true;
+	char line[512];
+	for (const auto& buffer : _buffers)
+	{
+		std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+		file << (first_event ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+			<< ",\"args\":{\"name\":\"" << escape_json(buffer->thread_name) << "\"}}";
+		first_event = false;
+
+		const size_t first = (buffer->next + buffer->events.size() - buffer->count) % buffer->events.size();
+		for (size_t i = 0; i < buffer->count; ++i)
+		{
+			const Event& event = buffer->events[(first + i) % buffer->events.size()];
+			snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				escape_json(event.name).c_str(), buffer->thread_id, (event.start - origin) / 1000.0, (event.end - event.start) / 1000.0);
+			file << line;
+		}
+	}
+	file << "\n]}\n";
+	return !!file;
+}
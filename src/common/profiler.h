@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "singleton.h"
+
+// Scoped CPU zones of every thread, exported in the Chrome trace format that chrome://tracing and
+// ui.perfetto.dev open. Each thread writes its zones to a ring buffer of its own, which keeps the newest
+// zones once full. A zone costs a pointer check while there is no profiler or it does not capture,
+// and nothing in builds without ENABLE_PROFILER.
+class Profiler : public Singleton<Profiler>
+{
+public:
+	static const size_t DEFAULT_EVENTS_PER_THREAD = 1 << 16;
+
+	explicit Profiler(size_t events_per_thread = DEFAULT_EVENTS_PER_THREAD);
+	~Profiler() = default;
+
+	Profiler(const Profiler&) = delete;
+	Profiler(Profiler&&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+	Profiler& operator=(Profiler&&) = delete;
+
+	void start_capture() { _capturing.store(true, std::memory_order_relaxed); }
+	void stop_capture() { _capturing.store(false, std::memory_order_relaxed); }
+	bool is_capturing() const { return _capturing.load(std::memory_order_relaxed); }
+	void clear();
+
+	// names the calling thread in the trace, may be called before a profiler exists
+	static void set_thread_name(const std::string& name);
+
+	bool write_chrome_trace(const std::string& path) const;
+
+	// nanoseconds of a steady clock
+	static uint64_t now();
+	// name must outlive the profiler, zones take string literals
+	void record(const char* name, uint64_t start, uint64_t end);
+	// zones timed on the GPU, on a track of their own
+	void record_gpu(const char* name, uint64_t start, uint64_t end);
+
+private:
+	struct Event
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	struct ThreadBuffer
+	{
+		std::mutex mutex;		// only contended while the trace is written
+		std::vector<Event> events;
+		size_t next;
+		size_t count;
+		unsigned int thread_id;
+		std::string thread_name;
+	};
+
+	ThreadBuffer& get_thread_buffer();
+	ThreadBuffer* add_buffer(const std::string& name);
+	static void write_event(ThreadBuffer& buffer, const char* name, uint64_t start, uint64_t end);
+
+	static thread_local ThreadBuffer* _thread_buffer;
+	static thread_local uint64_t _thread_buffer_owner;
+	static thread_local std::string _thread_name;
+
+	const size_t _events_per_thread;
+	const uint64_t _id;		// tells the buffers of this profiler from those of an earlier one
+	std::atomic<bool> _capturing{ false };
+	mutable std::mutex _buffers_mutex{ };
+	std::vector<std::unique_ptr<ThreadBuffer>> _buffers{ };
+	ThreadBuffer* _gpu_buffer{ nullptr };
+};
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name)
+		: _name(name)
+	{
+		const Profiler* profiler = Profiler::get_singletonPtr();
+		_active = profiler && profiler->is_capturing();
+		if (_active)
+			_start = Profiler::now();
+	}
+
+	~ProfileZone()
+	{
+		if (!_active)
+			return;
+		if (Profiler* profiler = Profiler::get_singletonPtr())
+			profiler->record(_name, _start, Profiler::now());
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* _name;
+	uint64_t _start{ 0 };
+	bool _active;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef ENABLE_PROFILER
+	// times the rest of the enclosing scope
+	#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+	#define PROFILE_ZONE(name) do { } while (false)
+#endif
@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Stable least significant digit radix sort of unsigned keys and the values moving with them, a byte
+// per pass. A pass is skipped when every key has the same byte in it, so narrow keys in a wide type
+// only cost the passes of their width. The scratch arrays hold count elements too. The sorted data may
+// end up in the scratch arrays, keys and values point at it afterwards and the scratch pointers at the
+// arrays passed in.
+template<typename Key, typename Value>
+void radix_sort(Key*& keys, Value*& values, size_t count, Key*& key_scratch, Value*& value_scratch)
+{
+	static_assert(std::is_unsigned<Key>::value, "radix sort of unsigned keys");
+	if (count < 2)
+		return;
+
+	// the histograms of all bytes in a single read of the keys
+	size_t histograms[sizeof(Key)][256] = { };
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Key key = keys[i];
+		for (unsigned int byte = 0; byte < sizeof(Key); ++byte)
+		{
+			++histograms[byte][(key >> (byte * 8)) & 0xFF];
+		}
+	}
+
+	for (unsigned int byte = 0; byte < sizeof(Key); ++byte)
+	{
+		size_t* histogram = histograms[byte];
+		const unsigned int shift = byte * 8;
+		if (histogram[(keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (unsigned int digit = 0; digit < 256; ++digit)
+		{
+			const size_t digit_count = histogram[digit];
+			histogram[digit] = offset;
+			offset += digit_count;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			const size_t target = histogram[(keys[i] >> shift) & 0xFF]++;
+			key_scratch[target] = keys[i];
+			value_scratch[target] = values[i];
+		}
+		std::swap(keys, key_scratch);
+		std::swap(values, value_scratch);
+	}
+}
@@ -8,10 +8,11 @@ public:
 	Camera(float fov, float aspect, float near, float far, const Vector3& pos, const Vector3& forward, const Vector3& up = Vector3(0.0f, 1.0f, 0.0f));
 	~Camera() = default;
 
-	Camera(const Camera&) = delete;
-	Camera(Camera&&) = delete;
-	Camera& operator=(const Camera&) = delete;
-	Camera& operator=(Camera&&) = delete;
+	// copied into the frame snapshots of the renderer
+	Camera(const Camera&) = default;
+	Camera(Camera&&) = default;
+	Camera& operator=(const Camera&) = default;
+	Camera& operator=(Camera&&) = default;
 
 	void move(const Vector3& displacement) { _position += displacement; }
 	void rotate(float yaw, float pitch, bool constrain_pitch = true);
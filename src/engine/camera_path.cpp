@@ -0,0 +1,62 @@
+﻿#include "camera_path.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "camera.h"
+
+bool CameraPath::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "Failed to open camera path " << path << std::endl;
+		return false;
+	}
+
+	_keys.clear();
+	std::string line;
+	for (unsigned int number = 1; std::getline(file, line); ++number)
+	{
+		const size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+
+		std::istringstream stream(line);
+		Key key;
+		if (!(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.forward.x >> key.forward.y >> key.forward.z))
+		{
+			std::cout << "Invalid camera key at " << path << ":" << number << std::endl;
+			_keys.clear();
+			return false;
+		}
+		add_key(key);
+	}
+	return !_keys.empty();
+}
+
+void CameraPath::add_key(const Key& key)
+{
+	const auto it = std::upper_bound(_keys.begin(), _keys.end(), key.time, [](float time, const Key& other) { return time < other.time; });
+	_keys.insert(it, key);
+}
+
+void CameraPath::apply(Camera& camera, float time) const
+{
+	if (_keys.empty())
+		return;
+
+	const auto next = std::upper_bound(_keys.begin(), _keys.end(), time, [](float time, const Key& key) { return time < key.time; });
+	if (next == _keys.begin() || next == _keys.end())
+	{
+		const Key& key = next == _keys.begin() ? _keys.front() : _keys.back();
+		camera.set_position(key.position);
+		camera.set_forward(glm::normalize(key.forward));
+		return;
+	}
+	const Key& from = *(next - 1);
+	const Key& to = *next;
+	const float t = (time - from.time) / std::max(to.time - from.time, 1e-6f);
+	camera.set_position(glm::mix(from.position, to.position, t));
+	camera.set_forward(glm::normalize(glm::mix(glm::normalize(from.forward), glm::normalize(to.forward), t)));
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include "math/math.h"
+
+class Camera;
+
+// Camera keys over time, played back by the engine in place of the input. A text file with one key
+// per line: time in seconds, position x y z, forward x y z. Lines starting with # are comments.
+class CameraPath
+{
+public:
+	struct Key
+	{
+		float time;
+		Vector3 position;
+		Vector3 forward;
+	};
+
+	bool load(const std::string& path);
+	void add_key(const Key& key);
+
+	// interpolates between the keys around time, holds the first and last key outside them
+	void apply(Camera& camera, float time) const;
+
+	bool empty() const { return _keys.empty(); }
+	float get_duration() const { return _keys.empty() ? 0.0f : _keys.back().time; }
+
+private:
+	std::vector<Key> _keys{ };	// by time
+};
@@ -1,80 +1,380 @@
 ﻿#include "engine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <vector>
 #include "render/renderer.h"
+#include "render/model_loader.h"
+#include "render/shader_manager.h"
+#include "render/gl_extensions.h"
+#include "render/gl_interceptor.h"
+#include "common/profiler.h"
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
 #include "camera.h"
 
-Engine* Singleton<Engine>::singleton = nullptr;
+template<> Engine* Singleton<Engine>::singleton = nullptr;
 
-bool Engine::startup()
+namespace
 {
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+	const float HEADLESS_FRAME_TIME = 1.0f / 60.0f;
+	// a frame after a long stall simulates no more, the time beyond is dropped rather than caught up
+	const unsigned int MAX_STEPS_PER_FRAME = 8;
+}
 
-	_window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
-	if (_window == NULL)
+bool Engine::startup()
+{
+	_start_time = std::chrono::steady_clock::now();
+	Profiler::set_thread_name("main");
+	// a hidden window stands in for the headless context where there is none
+	GLADloadproc loader = nullptr;
+	if (_render_backend == RenderBackend::Null)
 	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return false;
+		_headless = true;
+		_null_device.reset(new NullDevice());
+		loader = GLADloadproc(NullDevice::get_proc_address);
 	}
-	glfwMakeContextCurrent(_window);
+	else if (_headless && _headless_context.create())
+		loader = GLADloadproc(HeadlessContext::get_proc_address);
+	else if (create_window(!_headless))
+		loader = GLADloadproc(glfwGetProcAddress);
+	else
+		return false;
 
-	if (!gladLoadGLLoader(GLADloadproc(glfwGetProcAddress)))
+	if (!gladLoadGLLoader(loader))
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
-		glfwTerminate();
+		shutdown();
 		return false;
 	}
+	load_gl_extensions(loader);
 
-	int width, height;
-	glfwGetFramebufferSize(_window, &width, &height);
+	int width = _width;
+	int height = _height;
+	if (_headless)
+	{
+		if (!_offscreen_target.resize(width, height))
+		{
+			shutdown();
+			return false;
+		}
+		Renderer::get_singleton().set_target_framebuffer(_offscreen_target.get_framebuffer());
+	}
+	else
+	{
+		glfwGetFramebufferSize(_window, &width, &height);
+	}
 	const Vector3 pos(0.0f, 0.0f, 8.0f);
 	const Vector3 forward(0.0f, 0.0f, -1.0f);
 	_camera = new Camera(45.0f, (float)width / (float)height, 0.5f, 100.0f, pos, forward);
+	Renderer::get_singleton().set_viewport_size(width, height);
 
-	glfwSetFramebufferSizeCallback(_window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(_window, mouse_move_callback);
-	glfwSetScrollCallback(_window, mouse_scroll_callback);
+	if (!_headless)
+	{
+		glfwSetFramebufferSizeCallback(_window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(_window, mouse_move_callback);
+		glfwSetScrollCallback(_window, mouse_scroll_callback);
+		apply_swap_mode();
+	}
 
 	_last_frame_time = get_time();
+	_stats_time = _last_frame_time;
 
+	return true;
+}
+
+bool Engine::create_window(bool visible)
+{
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+#ifdef _DEBUG
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+
+	_window = glfwCreateWindow(_width, _height, "LearnOpenGL", NULL, NULL);
+	if (_window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(_window);
 	return true;
 }
 
+void Engine::apply_swap_mode()
+{
+	// the interval belongs to the context, it stays when a render thread takes the context over
+	int interval = 1;
+	if (_swap_mode == SwapMode::Immediate)
+		interval = 0;
+	else if (_swap_mode == SwapMode::Adaptive && (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear")))
+		interval = -1;
+	else if (_swap_mode == SwapMode::Adaptive)
+		std::cout << "Adaptive sync is not supported, using vsync" << std::endl;
+	glfwSwapInterval(interval);
+}
+
 void Engine::shutdown()
 {
-	glfwTerminate();
+	_offscreen_target.release();
+	_headless_context.destroy();
+	_null_device.reset();
+	if (_window)
+	{
+		glfwTerminate();
+		_window = nullptr;
+	}
 }
 
 void Engine::run()
 {
 	Renderer& renderer = Renderer::get_singleton();
-	
-	while (!_should_shutdown && !glfwWindowShouldClose(_window))
+
+	// without a limit a headless run renders the camera path or a single frame
+	unsigned int frame_limit = _frame_limit;
+	if (_headless && frame_limit == 0)
+		frame_limit = (unsigned int)(_camera_path.get_duration() / HEADLESS_FRAME_TIME) + 1;
+	unsigned int frame = 0;
+	bool counting = !_headless;
+	const float start_time = get_time();
+	_step_time = 0.0f;
+	_simulated_position = _camera->get_position();
+	_previous_position = _simulated_position;
+	_frame_pacer.reset();
+	std::chrono::steady_clock::time_point previous_start{ };
+
+	const bool pipelined = _render_thread_enabled && start_render_thread();
+	FrameRecord records[Renderer::SNAPSHOT_COUNT]{ };
+	bool in_flight = false;
+	unsigned int snapshot = 0;
+	while (!_should_shutdown && (_headless || !glfwWindowShouldClose(_window)) && (frame_limit == 0 || frame < frame_limit))
 	{
+		PROFILE_ZONE("Engine::frame");
+		const auto frame_start = std::chrono::steady_clock::now();
+		if (previous_start != std::chrono::steady_clock::time_point())
+		{
+			const float interval_ms = std::chrono::duration<float, std::milli>(frame_start - previous_start).count();
+			_frame_time_sum += interval_ms;
+			_frame_time_square_sum += (double)interval_ms * interval_ms;
+			_frame_time_max = std::max(_frame_time_max, interval_ms);
+			++_frame_time_count;
+		}
+		previous_start = frame_start;
 		const float time = get_time();
-		const float delta = time - _last_frame_time;
+		const float delta = _headless ? HEADLESS_FRAME_TIME : time - _last_frame_time;
 		_last_frame_time = time;
 
-		process_input(delta);
+		// headless frames wait for the streamed models, so captures do not depend on loading times
+		if (!counting)
+		{
+			const auto* loader = ModelLoader::get_singletonPtr();
+			counting = !loader || loader->get_pending_count() == 0;
+		}
+		if (!_camera_path.empty())
+			_camera_path.apply(*_camera, _headless ? frame * HEADLESS_FRAME_TIME : time - start_time);
+		else if (!_headless)
+			simulate(delta);
+
+		FrameRecord& record = records[snapshot];
+		record = { frame, snapshot, counting, 0.0f };
+		renderer.prepare_frame(snapshot);
+		record.cpu_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+		if (counting)
+			++frame;
 
-		renderer.draw(delta);
+		if (pipelined)
+		{
+			// the render thread submitted the frame before meanwhile
+			if (in_flight)
+			{
+				PROFILE_ZONE("Engine::wait_render_thread");
+				_render_thread.wait();
+				finish_frame(records[(snapshot + 1) % Renderer::SNAPSHOT_COUNT], time);
+			}
+			// two pointers fit the storage of std::function, the hand over allocates nothing
+			_render_thread.kick([this, &record]() { update_gl_resources(record); }, [this, &record]() { submit_frame(record); });
+			in_flight = true;
+		}
+		else
+		{
+			update_gl_resources(record);
+			submit_frame(record);
+			finish_frame(record, time);
+		}
+		if (!_headless)
+			glfwPollEvents();
+		snapshot = (snapshot + 1) % Renderer::SNAPSHOT_COUNT;
+		_frame_pacer.wait();
+	}
+
+	if (pipelined)
+	{
+		_render_thread.wait();
+		if (in_flight)
+			finish_frame(records[(snapshot + 1) % Renderer::SNAPSHOT_COUNT], get_time());
+		_render_thread.stop();
+		make_context_current(true);
+	}
+	if (_headless)
+	{
+		const float seconds = get_time() - start_time;
+		std::cout << frame << " frames in " << seconds << " s" << std::endl;
+	}
+}
 
+bool Engine::make_context_current(bool current)
+{
+	if (_null_device)
+		return true;
+	if (_headless_context.valid())
+		return _headless_context.make_current(current);
+	glfwMakeContextCurrent(current ? _window : nullptr);
+	return true;
+}
+
+bool Engine::start_render_thread()
+{
+	// the box of the models still loading is made on first use, on the main thread which will not
+	// have the context anymore
+	if (auto* loader = ModelLoader::get_singletonPtr())
+		loader->get_proxy_mesh();
+	if (!make_context_current(false))
+		return false;
+	_render_thread.start([this]()
+	{
+		Profiler::set_thread_name("render");
+		make_context_current(true);
+	}, [this]()
+	{
+		make_context_current(false);
+	});
+	return true;
+}
+
+void Engine::update_gl_resources(FrameRecord& record)
+{
+	const auto start = std::chrono::steady_clock::now();
+	if (auto* loader = ModelLoader::get_singletonPtr())
+		loader->update();
+	if (auto* shader_mgr = ShaderManager::get_singletonPtr())
+		shader_mgr->update();
+	record.cpu_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Engine::submit_frame(FrameRecord& record)
+{
+	const auto start = std::chrono::steady_clock::now();
+	Renderer::get_singleton().submit_frame(record.snapshot);
+	record.cpu_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (auto* interceptor = GLInterceptor::get_singletonPtr())
+		interceptor->end_frame();
+	if (_null_device)
+		_null_device->end_frame();
+	if (record.counted && !_capture_pattern.empty() && !_null_device && record.number % std::max(_capture_interval, 1u) == 0)
+		capture_frame(record.number);
+
+	PROFILE_ZONE("Engine::present");
+	if (_headless)
+	{
+		// nothing else throttles the frames without a swap
+		glFinish();
+	}
+	else
+	{
 		glfwSwapBuffers(_window);
-		glfwPollEvents();
 	}
 }
 
+void Engine::finish_frame(const FrameRecord& record, float time)
+{
+	update_stats(time);
+	if (record.counted && _frame_handler)
+		_frame_handler(record.number, record.cpu_ms);
+}
+
+void Engine::update_stats(float time)
+{
+	++_stats_frames;
+	if (time - _stats_time < 1.0f)
+		return;
+
+	const auto& stats = Renderer::get_singleton().get_frame_stats();
+	const size_t tested_triangles = stats.triangles + stats.cluster_culled_triangles;
+	const float culled_percent = tested_triangles ? 100.0f * stats.cluster_culled_triangles / tested_triangles : 0.0f;
+	const float clusters_per_ms = stats.cluster_cull_ms > 0.0f ? stats.clusters_tested / stats.cluster_cull_ms : 0.0f;
+	if (_frame_time_count)
+	{
+		const double mean = _frame_time_sum / _frame_time_count;
+		const double variance = std::max(_frame_time_square_sum / _frame_time_count - mean * mean, 0.0);
+		_frame_time_stats = { (float)mean, (float)std::sqrt(variance), _frame_time_max };
+	}
+	_frame_time_count = 0;
+	_frame_time_sum = 0.0;
+	_frame_time_square_sum = 0.0;
+	_frame_time_max = 0.0f;
+	char title[704];
+	int length = snprintf(title, sizeof(title), "LearnOpenGL - %.1f fps, frame %.2f ms (stddev %.2f, max %.2f), %u draws, %zu triangles, %.1f%% culled by clusters (%.0f clusters/ms), %zu light refs (%.2f ms), %.2f shaded/pixel, %u shadow draws (%.2f ms)",
+		_stats_frames / (time - _stats_time), _frame_time_stats.mean_ms, _frame_time_stats.stddev_ms, _frame_time_stats.max_ms, stats.draw_calls, stats.triangles, culled_percent, clusters_per_ms, stats.light_indices, stats.light_assign_ms, stats.shaded_fragments_per_pixel,
+		stats.shadow_draw_calls, stats.shadow_ms);
+	const auto* interceptor = GLInterceptor::get_singletonPtr();
+	if (interceptor && interceptor->is_installed() && length > 0 && (size_t)length < sizeof(title))
+	{
+		const auto& gl_stats = interceptor->get_frame_stats();
+		length += snprintf(title + length, sizeof(title) - length, ", %llu GL calls (%u redundant state changes, %u queries)",
+			(unsigned long long)gl_stats.calls, gl_stats.redundant_state_changes, gl_stats.queries);
+	}
+	if (_null_device && length > 0 && (size_t)length < sizeof(title))
+	{
+		const auto& device_stats = _null_device->get_frame_stats();
+		snprintf(title + length, sizeof(title) - length, ", %llu null device commands (%u errors)",
+			(unsigned long long)device_stats.commands, device_stats.errors);
+	}
+	if (_headless)
+		std::cout << title << std::endl;
+	else
+		glfwSetWindowTitle(_window, title);
+	_stats_time = time;
+	_stats_frames = 0;
+}
+
+bool Engine::capture_frame(unsigned int frame) const
+{
+	// the viewport may have been resized since on the main thread
+	const Renderer& renderer = Renderer::get_singleton();
+	const int width = renderer.get_frame_snapshot().viewport_width;
+	const int height = renderer.get_frame_snapshot().viewport_height;
+	std::vector<unsigned char> pixels((size_t)width * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, renderer.get_target_framebuffer());
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+	char path[512];
+	snprintf(path, sizeof(path), _capture_pattern.c_str(), frame);
+	// the rows of OpenGL go bottom up
+	stbi_flip_vertically_on_write(1);
+	if (!stbi_write_png(path, width, height, 3, pixels.data(), width * 3))
+	{
+		std::cout << "Failed to write frame " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
 float Engine::get_time() const
 {
-	return glfwGetTime();
+	if (!_window)
+		return std::chrono::duration<float>(std::chrono::steady_clock::now() - _start_time).count();
+	return (float)glfwGetTime();
 }
 
 void Engine::framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -94,8 +394,9 @@ void Engine::mouse_scroll_callback(GLFWwindow* window, double xoffset, double yo
 
 void Engine::on_framebuffer_sized(int width, int height)
 {
-	glViewport(0, 0, width, height);
+	// the renderer sets the viewport of every frame, on the thread owning the context
 	_camera->set_aspect((float)width / (float)height);
+	Renderer::get_singleton().set_viewport_size(width, height);
 }
 
 void Engine::on_mouse_moved(Vector2 position)
@@ -120,14 +421,29 @@ void Engine::on_mouse_scrolled(float offset)
 	_camera->set_fov(_camera->get_fov() - offset);
 }
 
-void Engine::process_input(float delta)
+void Engine::simulate(float delta)
+{
+	// the camera renders in between steps, the steps go on from the last simulated position
+	_camera->set_position(_simulated_position);
+	_step_time += std::min(delta, MAX_STEPS_PER_FRAME * _fixed_timestep);
+	while (_step_time >= _fixed_timestep)
+	{
+		_previous_position = _simulated_position;
+		process_input(_fixed_timestep);
+		_simulated_position = _camera->get_position();
+		_step_time -= _fixed_timestep;
+	}
+	_camera->set_position(glm::mix(_previous_position, _simulated_position, _step_time / _fixed_timestep));
+}
+
+void Engine::process_input(float step)
 {
 	if (glfwGetKey(_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 	{
 		glfwSetWindowShouldClose(_window, true);
 	}
 
-	const float camera_speed = 0.05f; // adjust accordingly
+	const float camera_speed = 3.0f * step; // units a second
 	const Vector3& forward = _camera->get_forward(); // already normalized
 	const Vector3& up = _camera->get_up();	// already normalized
 	const Vector3 right = glm::normalize(glm::cross(forward, up));
@@ -1,7 +1,17 @@
 ﻿#pragma once
 
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
 #include "common/singleton.h"
 #include "math/math.h"
+#include "camera_path.h"
+#include "headless_context.h"
+#include "render_thread.h"
+#include "frame_pacer.h"
+#include "render/offscreen_target.h"
+#include "render/null_device.h"
 
 struct GLFWwindow;
 class ShaderProgram;
@@ -9,6 +19,20 @@ class Texture;
 class RenderObject;
 class Camera;
 
+enum class RenderBackend : unsigned int
+{
+	OpenGL,
+	Null,		// the GL calls go to a NullDevice, nothing is drawn
+};
+
+// how the window waits for the vertical blank when it swaps
+enum class SwapMode : unsigned int
+{
+	Immediate,	// no wait, frames may tear
+	VSync,
+	Adaptive,	// waits unless the frame missed the blank, then tears instead of waiting for the next one. VSync where the driver does not support it
+};
+
 class Engine : public Singleton<Engine>
 {
 public:
@@ -24,6 +48,49 @@ public:
 	void shutdown();
 	void run();
 
+	// The options below are set before startup.
+	// Renders into an offscreen framebuffer without a window, with a context from HeadlessContext or a
+	// hidden window where there is none. Frames take a fixed time step, so that runs are reproducible.
+	void set_headless(bool headless) { _headless = headless; }
+	bool is_headless() const { return _headless; }
+	// the null backend runs headless without a context, for the CPU cost of frames alone
+	void set_render_backend(RenderBackend backend) { _render_backend = backend; }
+	RenderBackend get_render_backend() const { return _render_backend; }
+	// the GL side of the frames runs on a render thread owning the context while run lasts, one frame
+	// behind the main thread which prepares the next frame meanwhile
+	void set_render_thread_enabled(bool enabled) { _render_thread_enabled = enabled; }
+	bool is_render_thread_enabled() const { return _render_thread_enabled; }
+	void set_resolution(int width, int height) { _width = width; _height = height; }
+	// run stops after this many frames, 0 for no limit. Headless runs count from the first frame with
+	// every model loaded, and stop at the end of the camera path or after a frame without a limit.
+	void set_frame_limit(unsigned int frames) { _frame_limit = frames; }
+	// writes every interval-th frame to a PNG file, path_pattern is a printf format of the frame number
+	void set_frame_capture(const std::string& path_pattern, unsigned int interval = 1) { _capture_pattern = path_pattern; _capture_interval = interval; }
+	// the camera follows the path instead of the input
+	void set_camera_path(const CameraPath& path) { _camera_path = path; }
+	// called after every counted frame with its number and the CPU time of its update and draw, which
+	// leaves out the wait for the GPU, the buffer swap and the wait between the threads of a pipelined run
+	typedef std::function<void(unsigned int frame, float cpu_ms)> FrameHandler;
+	void set_frame_handler(const FrameHandler& handler) { _frame_handler = handler; }
+	void set_swap_mode(SwapMode mode) { _swap_mode = mode; }
+	SwapMode get_swap_mode() const { return _swap_mode; }
+	// the main loop sleeps to hold the frames to this rate, 0 for no cap
+	void set_frame_cap(float fps) { _frame_pacer.set_frame_cap(fps); }
+	float get_frame_cap() const { return _frame_pacer.get_frame_cap(); }
+	// the input moves the camera in steps of this many seconds whatever the frame rate, frames render
+	// the camera in between the last two steps
+	void set_fixed_timestep(float seconds) { _fixed_timestep = seconds; }
+	float get_fixed_timestep() const { return _fixed_timestep; }
+
+	// between the starts of the frames, over the last second
+	struct FrameTimeStats
+	{
+		float mean_ms;
+		float stddev_ms;
+		float max_ms;
+	};
+	const FrameTimeStats& get_frame_time_stats() const { return _frame_time_stats; }
+
 	void set_camera(Camera* camera) { _camera = camera; }
 	Camera* get_camera() const { return _camera; }
 
@@ -38,13 +105,66 @@ private:
 	void on_framebuffer_sized(int width, int height);
 	void on_mouse_moved(Vector2 position);
 	void on_mouse_scrolled(float offset);
-	void process_input(float delta);
+	bool create_window(bool visible);
+	void apply_swap_mode();
+	// runs the fixed steps due after delta seconds, then puts the camera in between the last two
+	void simulate(float delta);
+	void process_input(float step);
+	void update_stats(float time);
+	bool capture_frame(unsigned int frame) const;
+
+	// a frame from its preparation on the main thread to its submission on the GL thread
+	struct FrameRecord
+	{
+		unsigned int number;
+		unsigned int snapshot;
+		bool counted;
+		float cpu_ms;
+	};
+	bool make_context_current(bool current);
+	bool start_render_thread();
+	// GL thread, the main thread waits meanwhile
+	void update_gl_resources(FrameRecord& record);
+	// GL thread, draws and presents the snapshot of the record
+	void submit_frame(FrameRecord& record);
+	// main thread, once the frame is submitted
+	void finish_frame(const FrameRecord& record, float time);
 
 	struct GLFWwindow* _window = nullptr;
 	Camera* _camera = nullptr;
 	float _last_frame_time = 0.0f;
 	bool _should_shutdown = false;
+	float _stats_time = 0.0f;
+	unsigned int _stats_frames = 0;
+	unsigned int _frame_time_count = 0;
+	double _frame_time_sum = 0.0;
+	double _frame_time_square_sum = 0.0;
+	float _frame_time_max = 0.0f;
+	FrameTimeStats _frame_time_stats{ };
+
+	float _fixed_timestep = 1.0f / 60.0f;
+	float _step_time = 0.0f;				// not simulated yet, less than a step
+	Vector3 _simulated_position{ 0.0f };
+	Vector3 _previous_position{ 0.0f };		// of the step before
+	SwapMode _swap_mode = SwapMode::VSync;
+	FramePacer _frame_pacer{ };
 
 	bool _mouse_moved = false;
 	Vector2 _last_mouse_position{0.0f, 0.0f};
+
+	bool _headless = false;
+	RenderBackend _render_backend = RenderBackend::OpenGL;
+	std::unique_ptr<NullDevice> _null_device{ };
+	bool _render_thread_enabled = false;
+	RenderThread _render_thread{ };
+	int _width = 800;
+	int _height = 600;
+	unsigned int _frame_limit = 0;
+	std::string _capture_pattern{ };
+	unsigned int _capture_interval = 1;
+	CameraPath _camera_path{ };
+	FrameHandler _frame_handler{ };
+	HeadlessContext _headless_context{ };
+	OffscreenTarget _offscreen_target{ };
+	std::chrono::steady_clock::time_point _start_time{ };
 };
@@ -0,0 +1,30 @@
+﻿#include "frame_pacer.h"
+#include <thread>
+
+void FramePacer::wait()
+{
+	if (_frame_cap <= 0.0f)
+		return;
+
+	const Seconds interval(1.0 / _frame_cap);
+	auto now = Clock::now();
+	if (_next != Clock::time_point() && _next > now)
+	{
+		const auto wake = _next - std::chrono::duration_cast<Clock::duration>(_oversleep);
+		if (wake > now)
+		{
+			std::this_thread::sleep_until(wake);
+			now = Clock::now();
+			// averaged, a single late wake up does not make the next frames early
+			const Seconds late = now - wake;
+			_oversleep = (_oversleep * 7.0 + late) / 8.0;
+		}
+	}
+
+	// a frame later than its slot starts the schedule over, instead of the next frames hurrying to catch up
+	const auto step = std::chrono::duration_cast<Clock::duration>(interval);
+	if (_next == Clock::time_point() || now > _next + step)
+		_next = now + step;
+	else
+		_next += step;
+}
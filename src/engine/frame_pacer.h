@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <chrono>
+
+// Holds the frames to a rate by sleeping between them rather than spinning. The OS wakes sleeping
+// threads late by a fairly steady amount, the pacer measures it and goes to sleep that much earlier.
+class FramePacer
+{
+public:
+	FramePacer() = default;
+	~FramePacer() = default;
+
+	FramePacer(const FramePacer&) = delete;
+	FramePacer(FramePacer&&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+	FramePacer& operator=(FramePacer&&) = delete;
+
+	// frames a second, 0 for no cap
+	void set_frame_cap(float fps) { _frame_cap = fps; reset(); }
+	float get_frame_cap() const { return _frame_cap; }
+	void reset() { _next = Clock::time_point(); }
+
+	// once a frame, returns when the next one should start
+	void wait();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::chrono::duration<double> Seconds;
+
+	float _frame_cap{ 0.0f };
+	Clock::time_point _next{ };
+	Seconds _oversleep{ 0.0 };
+};
@@ -0,0 +1,130 @@
+﻿#include "headless_context.h"
+#include <cstring>
+#include <iostream>
+#ifdef HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef HAS_EGL
+bool HeadlessContext::create()
+{
+	destroy();
+
+	// the default display needs a running X server or Wayland compositor
+	EGLDisplay display = EGL_NO_DISPLAY;
+	const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless"))
+	{
+		const auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display)
+			display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		std::cout << "Failed to initialize EGL: " << std::hex << eglGetError() << std::dec << std::endl;
+		return false;
+	}
+	_display = display;
+
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint config_count = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+	{
+		std::cout << "No EGL config for desktop OpenGL" << std::endl;
+		destroy();
+		return false;
+	}
+
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		std::cout << "Failed to create EGL context: " << std::hex << eglGetError() << std::dec << std::endl;
+		destroy();
+		return false;
+	}
+	_context = context;
+
+	// the engine renders into its own framebuffer, the surface only makes the context current
+	// where surfaceless contexts are not supported
+	const EGLint surface_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+	EGLSurface surface = eglCreatePbufferSurface(display, config, surface_attributes);
+	_surface = surface != EGL_NO_SURFACE ? surface : nullptr;
+	if (!eglMakeCurrent(display, surface, surface, context))
+	{
+		std::cout << "Failed to make the EGL context current: " << std::hex << eglGetError() << std::dec << std::endl;
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void HeadlessContext::destroy()
+{
+	if (!_display)
+		return;
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (_surface)
+		eglDestroySurface(_display, _surface);
+	if (_context)
+		eglDestroyContext(_display, _context);
+	eglTerminate(_display);
+	_display = nullptr;
+	_surface = nullptr;
+	_context = nullptr;
+}
+
+bool HeadlessContext::make_current(bool current)
+{
+	if (!_context)
+		return false;
+	EGLSurface surface = current && _surface ? _surface : EGL_NO_SURFACE;
+	if (!eglMakeCurrent(_display, surface, surface, current ? _context : EGL_NO_CONTEXT))
+	{
+		std::cout << "Failed to make the EGL context current: " << std::hex << eglGetError() << std::dec << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void* HeadlessContext::get_proc_address(const char* name)
+{
+	return (void*)eglGetProcAddress(name);
+}
+#else
+bool HeadlessContext::create()
+{
+	return false;
+}
+
+void HeadlessContext::destroy()
+{
+}
+
+bool HeadlessContext::make_current(bool)
+{
+	return false;
+}
+
+void* HeadlessContext::get_proc_address(const char*)
+{
+	return nullptr;
+}
+#endif
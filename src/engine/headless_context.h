@@ -0,0 +1,31 @@
+﻿#pragma once
+
+// An OpenGL 3.3 core context without a window or a display, created with EGL on the Mesa surfaceless
+// platform when there is one, which also works with the llvmpipe software driver. Only available in
+// builds that found EGL (HAS_EGL), create fails otherwise.
+class HeadlessContext
+{
+public:
+	HeadlessContext() = default;
+	~HeadlessContext() { destroy(); }
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext(HeadlessContext&&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(HeadlessContext&&) = delete;
+
+	// creates the context and makes it current, it has no default framebuffer to draw to
+	bool create();
+	void destroy();
+	bool valid() const { return _context != nullptr; }
+	// makes the context current on the calling thread, or releases it from the calling thread
+	bool make_current(bool current);
+
+	// a loader for glad
+	static void* get_proc_address(const char* name);
+
+private:
+	void* _display{ nullptr };
+	void* _surface{ nullptr };
+	void* _context{ nullptr };
+};
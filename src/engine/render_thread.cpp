@@ -0,0 +1,69 @@
+﻿#include "render_thread.h"
+#include <cassert>
+
+void RenderThread::start(const Job& enter, const Job& leave)
+{
+	stop();
+	_quit = false;
+	_state = State::Idle;
+	_thread = std::thread(&RenderThread::loop, this, enter, leave);
+}
+
+void RenderThread::stop()
+{
+	if (!_thread.joinable())
+		return;
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_condition.notify_all();
+	_thread.join();
+}
+
+void RenderThread::kick(const Job& sync, const Job& job)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	assert(_state == State::Idle);
+	_sync = sync;
+	_job = job;
+	_state = State::Kicked;
+	_condition.notify_all();
+	_condition.wait(lock, [this]() { return _state != State::Kicked; });
+}
+
+void RenderThread::wait()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_condition.wait(lock, [this]() { return _state == State::Idle; });
+}
+
+void RenderThread::loop(Job enter, Job leave)
+{
+	enter();
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (;;)
+	{
+		_condition.wait(lock, [this]() { return _quit || _state == State::Kicked; });
+		if (_state != State::Kicked)
+			break;
+
+		lock.unlock();
+		if (_sync)
+			_sync();
+		lock.lock();
+		_state = State::Running;
+		_condition.notify_all();
+
+		lock.unlock();
+		_job();
+		lock.lock();
+		_sync = nullptr;
+		_job = nullptr;
+		_state = State::Idle;
+		_condition.notify_all();
+	}
+	lock.unlock();
+	leave();
+}
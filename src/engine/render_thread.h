@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs the GL side of the frames one frame behind the thread preparing them. kick hands over a frame in
+// two parts: sync runs while the caller waits, so it may touch the state of both threads, then job runs
+// while the caller prepares the next frame. wait returns once job is done.
+class RenderThread
+{
+public:
+	typedef std::function<void()> Job;
+
+	RenderThread() = default;
+	~RenderThread() { stop(); }
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread(RenderThread&&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+	RenderThread& operator=(RenderThread&&) = delete;
+
+	// enter runs first on the thread and leave last, to take the GL context and give it back
+	void start(const Job& enter, const Job& leave);
+	// finishes the frame handed over last
+	void stop();
+	bool is_running() const { return _thread.joinable(); }
+
+	// the frame before must have been waited for
+	void kick(const Job& sync, const Job& job);
+	void wait();
+
+private:
+	enum class State : unsigned int
+	{
+		Idle,
+		Kicked,		// sync is about to run
+		Running,	// job is running
+	};
+
+	void loop(Job enter, Job leave);
+
+	std::thread _thread{ };
+	std::mutex _mutex{ };
+	std::condition_variable _condition{ };
+	State _state{ State::Idle };
+	bool _quit{ false };
+	Job _sync{ };
+	Job _job{ };
+};
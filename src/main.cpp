@@ -1,4 +1,9 @@
-﻿#include <iostream>
+﻿#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
 #include "engine/engine.h"
 #include "render/renderer.h"
 #include "render/shader.h"
@@ -8,13 +13,15 @@
 #include "render/shader_manager.h"
 #include "render/texture_manager.h"
 #include "render/material_manager.h"
+#include "render/model_loader.h"
+#include "render/gpu_profiler.h"
+#include "render/gl_interceptor.h"
+#include "common/job_system.h"
+#include "common/file_system.h"
+#include "common/profiler.h"
 #include "glad/glad.h"
 #include <glm/ext/matrix_transform.inl>
 
-MaterialManager* Singleton<MaterialManager>::singleton = nullptr;
-ShaderManager* Singleton<ShaderManager>::singleton = nullptr;
-TextureManager* Singleton<TextureManager>::singleton = nullptr;
-
 void create_light_cube(ShaderProgram* shader, const Vector3& position, float scale = 1.0f, Vector3 color = Vector3(1.0f))
 {
 	//     7-------6
@@ -53,6 +60,8 @@ void create_light_cube(ShaderProgram* shader, const Vector3& position, float sca
 	if (!material)
 	{
 		material = MaterialManager::get_singleton().create_material("light_cube", shader);
+		// the cube surrounds the light it shows
+		material->set_cast_shadows(false);
 	}
 	Mesh* mesh = new Mesh(vf, vertices, 8, indices, material);
 	auto model = new Model(std::vector<Mesh*>{mesh});
@@ -69,7 +78,7 @@ bool init_boxes()
 	assert(specular_texture);
 
 	ShaderProgram* shader = ShaderManager::get_singleton().get_program("mesh");
-	assert(shader && shader->valid());
+	assert(shader);
 
 	Material* material = MaterialManager::get_singleton().get_material("boxes");
 	if (!material)
@@ -154,24 +163,22 @@ bool init_boxes()
 		// Because the stencil buffer is now filled with several 1s. The parts of the buffer that are 1 are not drawn, thus only drawing 
 		// the objects' size differences, making it look like borders.
 		// -----------------------------------------------------------------------------------------------------------------------------
+		PROFILE_GPU_ZONE("stencil outline");
 		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
 		glStencilMask(0x00);
 
 		Material* border = MaterialManager::get_singleton().get_material("border");
 		if (!border)
 		{
-			ShaderProgram* shader = ShaderManager::get_singleton().load("border", "src/shader/border_vertex.shader", "src/shader/border_fragment.shader");
-			assert(shader && shader->valid());
+			ShaderProgram* shader = ShaderManager::get_singleton().get_program("border");
+			assert(shader);
 
 			border = MaterialManager::get_singleton().create_material("border", shader, {}, {});
 			border->set_enable_depth_test(false);
 		}
 
-		Material* mat = mesh.get_material();
-		mesh.set_material(border);
 		const float scale = 1.1f;
-		mesh.draw(glm::scale(model, glm::vec3(scale, scale, scale)));
-		mesh.set_material(mat);
+		mesh.draw(*border, glm::scale(model, glm::vec3(scale, scale, scale)));
 
 		glStencilMask(0xFF);
 		glStencilFunc(GL_ALWAYS, 0, 0xFF);
@@ -201,9 +208,9 @@ bool init_windows()
 		ShaderProgram* shader = ShaderManager::get_singleton().get_program("window");
 		if (!shader)
 		{
-			shader = ShaderManager::get_singleton().load("window", "src/shader/window_vertex.shader", "src/shader/window_fragment.shader");
+			shader = ShaderManager::get_singleton().request("window", "src/shader/window_vertex.shader", "src/shader/window_fragment.shader");
 		}
-		assert(shader && shader->valid());
+		assert(shader);
 
 		Texture* texture = TextureManager::get_singleton().load_texture("asset/blending_transparent_window.png");
 		assert(texture);
@@ -251,8 +258,8 @@ bool init_windows()
 
 bool init_lights()
 {
-	ShaderProgram* shader = ShaderManager::get_singleton().load("light", "src/shader/light_vertex.shader", "src/shader/light_fragment.shader");
-	assert(shader && shader->valid());
+	ShaderProgram* shader = ShaderManager::get_singleton().get_program("light");
+	assert(shader);
 	Renderer& renderer = Renderer::get_singleton();
 
 	Light& directional = renderer.get_directional_light();
@@ -261,6 +268,7 @@ bool init_lights()
 	directional.diffuse = Vector3(0.4f, 0.4f, 0.4f);
 	directional.specular = Vector3(0.5f, 0.5f, 0.5f);
 	directional.directional.direction = Vector3(-0.2f, -1.0f, -0.3f);
+	directional.cast_shadows = true;
 
 	const Vector3 omni_light_positions[] = {
 		Vector3( 0.7f,  3.2f,  6.0f),
@@ -285,6 +293,7 @@ bool init_lights()
 		omni.omni.constant = 1.0f;
 		omni.omni.linear = 0.09f;
 		omni.omni.quadratic = 0.032f;
+		omni.cast_shadows = true;
 		renderer.add_omni_light(omni);
 		create_light_cube(shader, omni_light_positions[i], 0.2f, omni_light_colors[i]);
 	}
@@ -302,38 +311,250 @@ bool init_lights()
 	spot.spot.quadratic = 0.032f;
 	spot.spot.innerCutOff = glm::cos(glm::radians(12.5f));
 	spot.spot.outerCutOff = glm::cos(glm::radians(15.0f));
+	spot.cast_shadows = true;
 	renderer.add_spot_light(spot);
 
 	return true;
 }
 
-int main()
+// spreads copies of a model on a square grid, used to stress the renderer with a crowd
+void init_crowd(const Model& prototype, size_t count, float spacing)
+{
+	const size_t columns = (size_t)std::ceil(std::sqrt((float)count));
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto model = new Model(prototype);
+		const float x = ((float)(i % columns) - columns * 0.5f) * spacing;
+		const float z = -(float)(i / columns) * spacing;
+		model->set_position(prototype.get_position() + Vector3(x, 0.0f, z));
+		Renderer::get_singleton().add_model(model);
+	}
+}
+
+// scatters small colored lights over the crowd area, one in eight is a spot light facing down
+void init_scattered_lights(size_t count, float extent)
+{
+	Renderer& renderer = Renderer::get_singleton();
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Vector3 color = glm::normalize(Vector3(unit(random), unit(random), unit(random)) + Vector3(0.1f));
+		const Vector3 position((unit(random) - 0.5f) * extent, unit(random) * 6.0f - 2.0f, -unit(random) * extent);
+		Light light;
+		light.ambient = Vector3(0.0f);
+		light.diffuse = color;
+		light.specular = color;
+		if (i % 8 == 7)
+		{
+			light.type = LightType::Spot;
+			light.spot.position = position;
+			light.spot.direction = Vector3(0.0f, -1.0f, 0.0f);
+			light.spot.constant = 1.0f;
+			light.spot.linear = 0.35f;
+			light.spot.quadratic = 0.44f;
+			light.spot.innerCutOff = glm::cos(glm::radians(25.0f));
+			light.spot.outerCutOff = glm::cos(glm::radians(35.0f));
+			renderer.add_spot_light(light);
+		}
+		else
+		{
+			light.type = LightType::Omni;
+			light.omni.position = position;
+			light.omni.constant = 1.0f;
+			light.omni.linear = 0.7f;
+			light.omni.quadratic = 1.8f;
+			renderer.add_omni_light(light);
+		}
+	}
+}
+
+int main(int argc, char** argv)
 {
+	size_t crowd_count = 0;
+	size_t light_count = 0;
+	bool clustered_lighting = true;
+	bool deferred = false;
+	bool depth_prepass = false;
+	bool overdraw_view = false;
+	bool shadows = true;
+	bool headless = false;
+	bool null_backend = false;
+	bool render_thread = false;
+	SwapMode swap_mode = SwapMode::VSync;
+	float frame_cap = 0.0f;
+	int width = 800;
+	int height = 600;
+	unsigned int frame_limit = 0;
+	std::string camera_path{ };
+	std::string capture_pattern{ };
+	unsigned int capture_interval = 1;
+	std::string profile_path{ };
+	bool gl_intercept = false;
+	std::string record_gl_path{ };
+	unsigned int record_gl_frame = 1;
+	std::string pack_path = "asset.pack";
+#ifdef NDEBUG
+	bool hot_reload = false;
+#else
+	bool hot_reload = true;
+#endif
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--crowd" && i + 1 < argc)
+			crowd_count = (size_t)std::atoi(argv[++i]);
+		else if (std::string(argv[i]) == "--lights" && i + 1 < argc)
+			light_count = (size_t)std::atoi(argv[++i]);
+		else if (std::string(argv[i]) == "--no-clustered-lights")
+			clustered_lighting = false;
+		else if (std::string(argv[i]) == "--deferred")
+			deferred = true;
+		else if (std::string(argv[i]) == "--depth-prepass")
+			depth_prepass = true;
+		else if (std::string(argv[i]) == "--overdraw")
+			overdraw_view = true;
+		else if (std::string(argv[i]) == "--no-shadows")
+			shadows = false;
+		else if (std::string(argv[i]) == "--headless")
+			headless = true;
+		else if (std::string(argv[i]) == "--null-backend")
+			null_backend = true;
+		else if (std::string(argv[i]) == "--render-thread")
+			render_thread = true;
+		else if (std::string(argv[i]) == "--vsync" && i + 1 < argc)
+		{
+			const std::string mode = argv[++i];
+			swap_mode = mode == "off" ? SwapMode::Immediate : mode == "adaptive" ? SwapMode::Adaptive : SwapMode::VSync;
+		}
+		else if (std::string(argv[i]) == "--frame-cap" && i + 1 < argc)
+			frame_cap = (float)std::atof(argv[++i]);
+		else if (std::string(argv[i]) == "--resolution" && i + 1 < argc)
+			std::sscanf(argv[++i], "%dx%d", &width, &height);
+		else if (std::string(argv[i]) == "--frames" && i + 1 < argc)
+			frame_limit = (unsigned int)std::atoi(argv[++i]);
+		else if (std::string(argv[i]) == "--camera-path" && i + 1 < argc)
+			camera_path = argv[++i];
+		else if (std::string(argv[i]) == "--capture" && i + 1 < argc)
+			capture_pattern = argv[++i];
+		else if (std::string(argv[i]) == "--capture-interval" && i + 1 < argc)
+			capture_interval = (unsigned int)std::atoi(argv[++i]);
+		else if (std::string(argv[i]) == "--profile" && i + 1 < argc)
+			profile_path = argv[++i];
+		else if (std::string(argv[i]) == "--gl-intercept")
+			gl_intercept = true;
+		else if (std::string(argv[i]) == "--record-gl" && i + 1 < argc)
+			record_gl_path = argv[++i];
+		else if (std::string(argv[i]) == "--record-gl-frame" && i + 1 < argc)
+			record_gl_frame = (unsigned int)std::atoi(argv[++i]);
+		else if (std::string(argv[i]) == "--pack" && i + 1 < argc)
+			pack_path = argv[++i];
+		else if (std::string(argv[i]) == "--hot-reload")
+			hot_reload = true;
+	}
+
+	// created first so that it outlives the worker threads recording into it
+	std::shared_ptr<Profiler> profiler;
+	if (!profile_path.empty())
+	{
+		profiler = std::make_shared<Profiler>();
+		profiler->start_capture();
+	}
+	std::shared_ptr<JobSystem> job_system = std::make_shared<JobSystem>();
+	std::shared_ptr<FileSystem> file_system = std::make_shared<FileSystem>();
+	file_system->mount(pack_path);
 	std::shared_ptr<Engine> engine = std::make_shared<Engine>();
+	engine->set_headless(headless);
+	engine->set_render_backend(null_backend ? RenderBackend::Null : RenderBackend::OpenGL);
+	engine->set_render_thread_enabled(render_thread);
+	engine->set_swap_mode(swap_mode);
+	engine->set_frame_cap(frame_cap);
+	engine->set_resolution(width, height);
+	engine->set_frame_limit(frame_limit);
+	if (!capture_pattern.empty())
+		engine->set_frame_capture(capture_pattern, capture_interval);
+	if (!camera_path.empty())
+	{
+		CameraPath path;
+		if (!path.load(camera_path))
+			return -1;
+		engine->set_camera_path(path);
+	}
 	std::shared_ptr<Renderer> renderer = std::make_shared<Renderer>();
+	renderer->set_clustered_lighting_enabled(clustered_lighting);
+	renderer->set_shading_mode(deferred ? ShadingMode::Deferred : ShadingMode::Forward);
+	renderer->set_depth_prepass_enabled(depth_prepass);
+	renderer->set_overdraw_view_enabled(overdraw_view);
+	renderer->set_shadows_enabled(shadows);
 	std::shared_ptr<MaterialManager> material_mgr = std::make_shared<MaterialManager>();
 	std::shared_ptr<ShaderManager> shader_mgr = std::make_shared<ShaderManager>();
+	if (hot_reload)
+		shader_mgr->enable_hot_reload();
 	std::shared_ptr<TextureManager> texture_mgr = std::make_shared<TextureManager>();
+	std::shared_ptr<ModelLoader> model_loader = std::make_shared<ModelLoader>();
+	std::shared_ptr<GLInterceptor> gl_interceptor;
+	if (gl_intercept || !record_gl_path.empty())
+		gl_interceptor = std::make_shared<GLInterceptor>();
 
 	if (!engine->startup())
 		return -1;
 
-	assert(shader_mgr->load("mesh", "src/shader/mesh_vertex.shader", "src/shader/mesh_fragment.shader"));
+	if (gl_interceptor)
+	{
+		gl_interceptor->install();
+		// the handler runs at the end of a frame, the calls of the next one are recorded
+		if (!record_gl_path.empty() && record_gl_frame == 0)
+		{
+			gl_interceptor->record_frame(record_gl_path);
+		}
+		else if (!record_gl_path.empty())
+		{
+			engine->set_frame_handler([&](unsigned int frame, float)
+			{
+				if (frame + 1 == record_gl_frame)
+					gl_interceptor->record_frame(record_gl_path);
+			});
+		}
+	}
+
+	// the programs compile in the driver while textures and models load, each one waits for its link
+	// when it is first drawn. Mesh materials pick the variant matching their textures and the scene lights.
+	if (!shader_mgr->load_variants("mesh", "src/shader/mesh_vertex.shader", "src/shader/mesh_fragment.shader", ShaderVariant().with_textures(1, 0)) ||
+		!shader_mgr->request("light", "src/shader/light_vertex.shader", "src/shader/light_fragment.shader") ||
+		!shader_mgr->request("window", "src/shader/window_vertex.shader", "src/shader/window_fragment.shader") ||
+		!shader_mgr->request("border", "src/shader/border_vertex.shader", "src/shader/border_fragment.shader"))
+		return -1;
+	if (deferred && !shader_mgr->request("deferred_lighting", "src/shader/deferred_lighting_vertex.shader", "src/shader/deferred_lighting_fragment.shader"))
+		return -1;
+	if ((depth_prepass || shadows) && !shader_mgr->request("depth", "src/shader/depth_vertex.shader", "src/shader/depth_fragment.shader"))
+		return -1;
+	if (overdraw_view && !shader_mgr->request("overdraw", "src/shader/depth_vertex.shader", "src/shader/overdraw_fragment.shader"))
+		return -1;
 
 	if (!init_windows() || !init_lights())	// init_boxes
 		return -1;
 
-	auto model = new Model("asset/model/nanosuit/nanosuit.obj");
+	auto model = new Model("asset/model/nanosuit/nanosuit.obj", true);
 	model->set_position(Vector3(0.0f, 0.0f, -20.0f));
 	model->set_scale(Vector3(0.3f));
+	model->set_static(true);
 	renderer->add_model(model);
+	init_crowd(*model, crowd_count, 10.0f);
+	init_scattered_lights(light_count, std::max(std::sqrt((float)crowd_count), 4.0f) * 10.0f);
 
 	engine->run();
+	if (profiler)
+	{
+		profiler->stop_capture();
+		profiler->write_chrome_trace(profile_path);
+	}
 
+	gl_interceptor.reset();
+	model_loader.reset();
 	texture_mgr.reset();
 	shader_mgr.reset();
 	material_mgr.reset();
 	renderer.reset();
+	engine->shutdown();
 	engine.reset();
 	
     return 0;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cassert>
+#include <cstdio>
 #include "math/math.h"
 #include "shader.h"
 
@@ -16,6 +18,8 @@ struct Light
 	Vector3 ambient;
 	Vector3 diffuse;
 	Vector3 specular;
+	// rendered by ShadowRenderer, local lights only while the shadow atlas has room
+	bool cast_shadows{ false };
 	union
 	{
 		struct
@@ -44,34 +48,41 @@ struct Light
 		} spot;
 	};
 
-	void bind(ShaderProgram& shader, const std::string& name) const
+	void bind(ShaderProgram& shader, const char* name) const
 	{
+		// the member names are built on the stack, binding runs for every program change
+		char uniform[64];
+		const auto member = [&](const char* field) -> const char*
+		{
+			snprintf(uniform, sizeof(uniform), "%s.%s", name, field);
+			return uniform;
+		};
 		switch (type)
 		{
 		case LightType::Directional:
-			shader.set_vector3(name + ".direction", directional.direction);
+			shader.set_vector3(member("direction"), directional.direction);
 			break;
 		case LightType::Omni:
-			shader.set_vector3(name + ".position", omni.position);
-			shader.set_float(name + ".constant", omni.constant);
-			shader.set_float(name + ".linear", omni.linear);
-			shader.set_float(name + ".quadratic", omni.quadratic);
+			shader.set_vector3(member("position"), omni.position);
+			shader.set_float(member("constant"), omni.constant);
+			shader.set_float(member("linear"), omni.linear);
+			shader.set_float(member("quadratic"), omni.quadratic);
 			break;
 		case LightType::Spot:
-			shader.set_vector3(name + ".position", spot.position);
-			shader.set_vector3(name + ".direction", spot.direction);
-			shader.set_float(name + ".constant", spot.constant);
-			shader.set_float(name + ".linear", spot.linear);
-			shader.set_float(name + ".quadratic", spot.quadratic);
-			shader.set_float(name + ".innerCutOff", spot.innerCutOff);
-			shader.set_float(name + ".outerCutOff", spot.outerCutOff);
+			shader.set_vector3(member("position"), spot.position);
+			shader.set_vector3(member("direction"), spot.direction);
+			shader.set_float(member("constant"), spot.constant);
+			shader.set_float(member("linear"), spot.linear);
+			shader.set_float(member("quadratic"), spot.quadratic);
+			shader.set_float(member("innerCutOff"), spot.innerCutOff);
+			shader.set_float(member("outerCutOff"), spot.outerCutOff);
 			break;
 		default:
 			assert(0);
 			break;
 		}
-		shader.set_vector3(name + ".ambient", ambient);
-		shader.set_vector3(name + ".diffuse", diffuse);
-		shader.set_vector3(name + ".specular", specular);
+		shader.set_vector3(member("ambient"), ambient);
+		shader.set_vector3(member("diffuse"), diffuse);
+		shader.set_vector3(member("specular"), specular);
 	}
 };
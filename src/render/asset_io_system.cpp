@@ -0,0 +1,46 @@
+﻿#include "asset_io_system.h"
+#include <algorithm>
+#include <cstring>
+
+size_t AssetIOStream::Read(void* buffer, size_t size, size_t count)
+{
+	if (size == 0 || _position >= _file.size)
+		return 0;
+	count = std::min(count, (_file.size - _position) / size);
+	memcpy(buffer, _file.data + _position, size * count);
+	_position += size * count;
+	return count;
+}
+
+aiReturn AssetIOStream::Seek(size_t offset, aiOrigin origin)
+{
+	size_t position = 0;
+	switch (origin)
+	{
+	case aiOrigin_SET: position = offset; break;
+	case aiOrigin_CUR: position = _position + offset; break;
+	case aiOrigin_END: position = _file.size - offset; break;
+	default: return aiReturn_FAILURE;
+	}
+	if (position > _file.size)
+		return aiReturn_FAILURE;
+	_position = position;
+	return aiReturn_SUCCESS;
+}
+
+bool AssetIOSystem::Exists(const char* path) const
+{
+	return FileSystem::get_singleton().exists(path);
+}
+
+Assimp::IOStream* AssetIOSystem::Open(const char* path, const char* mode)
+{
+	// assets are never written
+	if (strchr(mode, 'w') || strchr(mode, 'a'))
+		return nullptr;
+
+	FileData file;
+	if (!FileSystem::get_singleton().read(path, file))
+		return nullptr;
+	return new AssetIOStream(std::move(file));
+}
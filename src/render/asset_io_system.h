@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include "assimp/IOStream.hpp"
+#include "assimp/IOSystem.hpp"
+#include "common/file_system.h"
+
+// Read only stream over a file of the FileSystem, zero copy for uncompressed pack entries
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+	explicit AssetIOStream(FileData file) : _file(std::move(file)) { }
+	~AssetIOStream() override = default;
+
+	size_t Read(void* buffer, size_t size, size_t count) override;
+	size_t Write(const void*, size_t, size_t) override { return 0; }
+	aiReturn Seek(size_t offset, aiOrigin origin) override;
+	size_t Tell() const override { return _position; }
+	size_t FileSize() const override { return _file.size; }
+	void Flush() override { }
+
+private:
+	FileData _file;
+	size_t _position{ 0 };
+};
+
+// Lets Assimp read models and their material files through the FileSystem
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+	AssetIOSystem() = default;
+	~AssetIOSystem() override = default;
+
+	bool Exists(const char* path) const override;
+	char getOsSeparator() const override { return '/'; }
+	Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+	void Close(Assimp::IOStream* stream) override { delete stream; }
+};
@@ -0,0 +1,100 @@
+﻿#include "gbuffer.h"
+#include <iostream>
+#include "glad/glad.h"
+#include "graphic_api.h"
+#include "shader.h"
+
+namespace
+{
+	const GLenum TARGET_FORMATS[] = { GL_RGBA8, GL_RGBA16F, GL_RGBA8 };
+	const GLenum TARGET_TYPES[] = { GL_UNSIGNED_BYTE, GL_HALF_FLOAT, GL_UNSIGNED_BYTE };
+	const char* const TARGET_NAMES[] = { "gbuffer_albedo", "gbuffer_normal", "gbuffer_specular" };
+
+	void create_target(unsigned int texture, GLenum internal_format, GLenum format, GLenum type, int width, int height)
+	{
+		CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, texture));
+		CHECK_GL_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+		CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	}
+}
+
+bool GBuffer::resize(int width, int height)
+{
+	if (_framebuffer && width == _width && height == _height)
+		return true;
+	release();
+	if (width <= 0 || height <= 0)
+		return false;
+
+	CHECK_GL_ERROR(glGenFramebuffers(1, &_framebuffer));
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+	CHECK_GL_ERROR(glGenTextures(Count, _textures));
+	for (unsigned int i = 0; i < Count; ++i)
+	{
+		create_target(_textures[i], TARGET_FORMATS[i], GL_RGBA, TARGET_TYPES[i], width, height);
+		CHECK_GL_ERROR(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, _textures[i], 0));
+	}
+	// the same format as the default framebuffer, which blitting needs
+	CHECK_GL_ERROR(glGenTextures(1, &_depth_texture));
+	create_target(_depth_texture, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+	CHECK_GL_ERROR(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, _depth_texture, 0));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, 0));
+
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "GBuffer incomplete framebuffer: " << std::hex << status << std::dec << std::endl;
+		release();
+		return false;
+	}
+	_width = width;
+	_height = height;
+	return true;
+}
+
+void GBuffer::release()
+{
+	if (!_framebuffer)
+		return;
+	CHECK_GL_ERROR(glDeleteFramebuffers(1, &_framebuffer));
+	CHECK_GL_ERROR(glDeleteTextures(Count, _textures));
+	CHECK_GL_ERROR(glDeleteTextures(1, &_depth_texture));
+	_framebuffer = 0;
+	_depth_texture = 0;
+	_width = 0;
+	_height = 0;
+}
+
+void GBuffer::bind() const
+{
+	const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	static_assert(sizeof(buffers) / sizeof(buffers[0]) == Count, "a draw buffer per target");
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+	CHECK_GL_ERROR(glDrawBuffers(Count, buffers));
+}
+
+void GBuffer::bind_textures(const ShaderProgram& shader, int first_unit) const
+{
+	for (unsigned int i = 0; i < Count; ++i)
+	{
+		CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + first_unit + i));
+		CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, _textures[i]));
+		shader.set_int(TARGET_NAMES[i], first_unit + i);
+	}
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + first_unit + Count));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, _depth_texture));
+	shader.set_int("gbuffer_depth", first_unit + Count);
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0));
+}
+
+void GBuffer::blit_depth(unsigned int target_framebuffer) const
+{
+	CHECK_GL_ERROR(glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebuffer));
+	CHECK_GL_ERROR(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target_framebuffer));
+	CHECK_GL_ERROR(glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST));
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer));
+}
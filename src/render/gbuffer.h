@@ -0,0 +1,45 @@
+﻿#pragma once
+
+class ShaderProgram;
+
+// Render targets of the deferred geometry pass: albedo, normal and shininess, specular, and a
+// depth stencil texture that the lighting pass reads and the forward pass continues on.
+class GBuffer
+{
+public:
+	enum Target : unsigned int
+	{
+		Albedo = 0,		// RGBA8, diffuse color
+		Normal,			// RGBA16F, world normal and shininess
+		Specular,		// RGBA8, specular color
+		Count
+	};
+
+	GBuffer() = default;
+	~GBuffer() { release(); }
+
+	GBuffer(const GBuffer&) = delete;
+	GBuffer(GBuffer&&) = delete;
+	GBuffer& operator=(const GBuffer&) = delete;
+	GBuffer& operator=(GBuffer&&) = delete;
+
+	// recreates the targets when the size changes
+	bool resize(int width, int height);
+	void release();
+
+	void bind() const;
+	// gbuffer_albedo, gbuffer_normal, gbuffer_specular and gbuffer_depth on consecutive units
+	void bind_textures(const ShaderProgram& shader, int first_unit) const;
+	// copies depth and stencil into the target framebuffer, so forward draws test against the opaque scene
+	void blit_depth(unsigned int target_framebuffer) const;
+
+	int get_width() const { return _width; }
+	int get_height() const { return _height; }
+
+private:
+	unsigned int _framebuffer{ 0 };
+	unsigned int _textures[Count]{ };
+	unsigned int _depth_texture{ 0 };
+	int _width{ 0 };
+	int _height{ 0 };
+};
@@ -0,0 +1,94 @@
+﻿#include "gl_extensions.h"
+#include <cstring>
+#include <iostream>
+#include "graphic_api.h"
+
+namespace
+{
+	GLExtensions extensions;
+
+	bool has_gl_version(int major, int minor)
+	{
+		return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+	}
+
+	void APIENTRY print_debug_message(GLenum, GLenum type, GLuint, GLenum severity, GLsizei, const GLchar* message, const void*)
+	{
+		if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+			return;
+		std::cout << "GL " << (type == GL_DEBUG_TYPE_ERROR ? "error" : "message") << ": " << message << std::endl;
+	}
+}
+
+void load_gl_extensions(GLADloadproc load)
+{
+	extensions = GLExtensions();
+
+	if (has_gl_version(4, 1) || has_gl_extension("GL_ARB_get_program_binary"))
+	{
+		extensions.glGetProgramBinary = (PFN_glGetProgramBinary)load("glGetProgramBinary");
+		extensions.glProgramBinary = (PFN_glProgramBinary)load("glProgramBinary");
+		extensions.glProgramParameteri = (PFN_glProgramParameteri)load("glProgramParameteri");
+		GLint formats = 0;
+		CHECK_GL_ERROR(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
+		extensions.program_binary = extensions.glGetProgramBinary && extensions.glProgramBinary && extensions.glProgramParameteri && formats > 0;
+	}
+
+	if (has_gl_extension("GL_KHR_parallel_shader_compile"))
+	{
+		extensions.glMaxShaderCompilerThreadsKHR = (PFN_glMaxShaderCompilerThreadsKHR)load("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (has_gl_extension("GL_ARB_parallel_shader_compile"))
+	{
+		extensions.glMaxShaderCompilerThreadsKHR = (PFN_glMaxShaderCompilerThreadsKHR)load("glMaxShaderCompilerThreadsARB");
+	}
+	if (extensions.glMaxShaderCompilerThreadsKHR)
+	{
+		// let the driver pick the number of compiler threads
+		CHECK_GL_ERROR(extensions.glMaxShaderCompilerThreadsKHR(0xFFFFFFFF));
+		extensions.parallel_shader_compile = true;
+	}
+
+#ifdef _DEBUG
+	if (has_gl_version(4, 3) || has_gl_extension("GL_KHR_debug"))
+	{
+		// the KHR entry point has no suffix in a desktop context
+		extensions.glDebugMessageCallback = (PFN_glDebugMessageCallback)load("glDebugMessageCallback");
+	}
+	// CHECK_GL_ERROR stops polling glGetError once the callback reports errors, which only a debug
+	// context guarantees; the headless EGL context for instance is not one
+	GLint context_flags = 0;
+	CHECK_GL_ERROR(glGetIntegerv(GL_CONTEXT_FLAGS, &context_flags));
+	if (extensions.glDebugMessageCallback && (context_flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+	{
+		// synchronous so that a breakpoint in the callback stops in the faulty call
+		CHECK_GL_ERROR(glEnable(GL_DEBUG_OUTPUT));
+		CHECK_GL_ERROR(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+		CHECK_GL_ERROR(extensions.glDebugMessageCallback(print_debug_message, nullptr));
+		extensions.debug_output = true;
+	}
+#endif
+
+	std::cout << "GL " << glGetString(GL_VERSION) << ", " << glGetString(GL_RENDERER)
+		<< (extensions.program_binary ? ", program binaries" : "")
+		<< (extensions.parallel_shader_compile ? ", parallel shader compile" : "")
+		<< (extensions.debug_output ? ", debug output" : "") << std::endl;
+}
+
+const GLExtensions& get_gl_extensions()
+{
+	return extensions;
+}
+
+bool has_gl_extension(const char* name)
+{
+	GLint count = 0;
+	CHECK_GL_ERROR(glGetIntegerv(GL_NUM_EXTENSIONS, &count));
+	for (GLint i = 0; i < count; ++i)
+	{
+		const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
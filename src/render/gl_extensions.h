@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include "glad/glad.h"
+
+// Entry points newer than the GL 3.3 core profile glad was generated for. They are loaded in
+// Engine::startup and are only valid when the matching flag of GLExtensions is set.
+
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+
+typedef void (APIENTRYP PFN_glGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_glProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFN_glProgramParameteri)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFN_glMaxShaderCompilerThreadsKHR)(GLuint count);
+typedef void (APIENTRYP PFN_glDebugMessageCallback)(GLDEBUGPROC callback, const void* userParam);
+
+struct GLExtensions
+{
+	// GL 4.1 or ARB_get_program_binary, with at least one binary format
+	bool program_binary{ false };
+	PFN_glGetProgramBinary glGetProgramBinary{ nullptr };
+	PFN_glProgramBinary glProgramBinary{ nullptr };
+	PFN_glProgramParameteri glProgramParameteri{ nullptr };
+
+	// KHR or ARB_parallel_shader_compile, GL_COMPLETION_STATUS_KHR can be queried without blocking
+	bool parallel_shader_compile{ false };
+	PFN_glMaxShaderCompilerThreadsKHR glMaxShaderCompilerThreadsKHR{ nullptr };
+
+	// GL 4.3 or KHR_debug, enabled in debug builds. Errors come to a callback from the call that caused
+	// them, CHECK_GL_ERROR does not poll glGetError then.
+	bool debug_output{ false };
+	PFN_glDebugMessageCallback glDebugMessageCallback{ nullptr };
+};
+
+// needs a current context with glad loaded
+void load_gl_extensions(GLADloadproc load);
+const GLExtensions& get_gl_extensions();
+bool has_gl_extension(const char* name);
@@ -0,0 +1,413 @@
+﻿#include "gl_interceptor.h"
+#include <iostream>
+#include <glad/glad.h>
+#include "common/hash.h"
+
+template<> GLInterceptor* Singleton<GLInterceptor>::singleton = nullptr;
+
+namespace
+{
+	enum class TrackedState : unsigned int
+	{
+		DrawFramebuffer,
+		ReadFramebuffer,
+		VertexArray,
+		ActiveTexture,
+		Texture,			// by unit and target
+		Buffer,				// by target, the element array buffer by vertex array
+		Renderbuffer,
+		Program,
+		Capability,			// by cap
+		DepthFunc,
+		DepthMask,
+		StencilMask,
+		StencilFunc,
+		StencilOp,
+		CullFace,
+		FrontFace,
+		BlendFunc,
+		ColorMask,
+		Viewport,
+		Scissor,
+		PolygonOffset,
+		DrawBuffers,		// by draw framebuffer
+		ReadBuffer,			// by read framebuffer
+		PixelStore,			// by pname
+		ClearColor,
+	};
+
+	void set_state(GLInterceptor& interceptor, TrackedState state, unsigned int sub, uint64_t value)
+	{
+		if (!interceptor.update_state((unsigned int)state, sub, value))
+			interceptor.on_redundant_state();
+	}
+
+	unsigned int get_state(const GLInterceptor& interceptor, TrackedState state, unsigned int sub = 0)
+	{
+		return (unsigned int)interceptor.get_state((unsigned int)state, sub);
+	}
+
+	uint64_t hash_values(uint64_t seed)
+	{
+		return seed;
+	}
+
+	template<typename T, typename... Args>
+	uint64_t hash_values(uint64_t seed, T value, Args... args)
+	{
+		return hash_values(hash_fnv1a(&value, sizeof(value), seed), args...);
+	}
+
+	template<typename... Args>
+	void set_state_of(GLInterceptor& interceptor, TrackedState state, Args... args)
+	{
+		set_state(interceptor, state, 0, hash_values(hash_fnv1a(nullptr, 0), args...));
+	}
+
+	void bind_framebuffer(GLInterceptor& interceptor, GLenum target, GLuint framebuffer)
+	{
+		// GL_FRAMEBUFFER binds both, and changes nothing only when both were bound
+		bool changed = false;
+		if (target != GL_READ_FRAMEBUFFER)
+			changed |= interceptor.update_state((unsigned int)TrackedState::DrawFramebuffer, 0, framebuffer);
+		if (target != GL_DRAW_FRAMEBUFFER)
+			changed |= interceptor.update_state((unsigned int)TrackedState::ReadFramebuffer, 0, framebuffer);
+		if (!changed)
+			interceptor.on_redundant_state();
+	}
+
+	void bind_texture(GLInterceptor& interceptor, GLenum target, GLuint texture)
+	{
+		const unsigned int unit = get_state(interceptor, TrackedState::ActiveTexture);
+		set_state(interceptor, TrackedState::Texture, (unit << 16) ^ target, texture);
+	}
+
+	void bind_buffer(GLInterceptor& interceptor, GLenum target, GLuint buffer)
+	{
+		// the element array buffer belongs to the vertex array
+		const unsigned int sub = target == GL_ELEMENT_ARRAY_BUFFER ? get_state(interceptor, TrackedState::VertexArray) << 16 ^ target : target;
+		set_state(interceptor, TrackedState::Buffer, sub, buffer);
+	}
+
+	void draw_buffers(GLInterceptor& interceptor, GLsizei n, const GLenum* bufs)
+	{
+		const unsigned int framebuffer = get_state(interceptor, TrackedState::DrawFramebuffer);
+		set_state(interceptor, TrackedState::DrawBuffers, framebuffer, hash_fnv1a(bufs, n * sizeof(GLenum)));
+	}
+
+	uint64_t get_image_size(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+	{
+		if (!pixels)
+			return 0;
+
+		unsigned int components = 4;
+		switch (format)
+		{
+		case GL_RED:
+		case GL_RED_INTEGER:
+		case GL_DEPTH_COMPONENT:
+		case GL_STENCIL_INDEX: components = 1; break;
+		case GL_RG:
+		case GL_RG_INTEGER: components = 2; break;
+		case GL_RGB:
+		case GL_BGR:
+		case GL_RGB_INTEGER: components = 3; break;
+		default: break;
+		}
+		unsigned int component_size = 1;
+		switch (type)
+		{
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT:
+		case GL_HALF_FLOAT: component_size = 2; break;
+		case GL_INT:
+		case GL_UNSIGNED_INT:
+		case GL_FLOAT: component_size = 4; break;
+		case GL_UNSIGNED_INT_24_8: components = 1; component_size = 4; break;
+		default: break;
+		}
+		// without the row alignment
+		return (uint64_t)width * height * depth * components * component_size;
+	}
+
+	// arguments of a recorded call, enums and names above 255 in hex
+	void write_arg(std::ostream& out, unsigned int value)
+	{
+		if (value > 0xff)
+			out << "0x" << std::hex << value << std::dec;
+		else
+			out << value;
+	}
+
+	void write_arg(std::ostream& out, unsigned char value)
+	{
+		out << (unsigned int)value;
+	}
+
+	void write_arg(std::ostream& out, const char* value)
+	{
+		out << '"' << value << '"';
+	}
+
+	template<typename T>
+	void write_arg(std::ostream& out, T* value)
+	{
+		out << (const void*)value;
+	}
+
+	template<typename T>
+	void write_arg(std::ostream& out, T value)
+	{
+		out << value;
+	}
+
+	void write_args(std::ostream&)
+	{
+	}
+
+	template<typename T, typename... Args>
+	void write_args(std::ostream& out, T value, Args... args)
+	{
+		write_arg(out, value);
+		if (sizeof...(args) > 0)
+			out << ", ";
+		write_args(out, args...);
+	}
+
+	class CallWriter
+	{
+	public:
+		CallWriter(std::ostream& out, const char* name) : _out(out), _name(name) { }
+
+		template<typename... Args>
+		void operator()(Args... args) const
+		{
+			_out << _name << '(';
+			write_args(_out, args...);
+			_out << ")\n";
+		}
+
+	private:
+		std::ostream& _out;
+		const char* _name;
+	};
+
+	// kind, return type, name without the gl prefix, parameters, arguments, effect on the interceptor
+	#define GL_INTERCEPTED_ENTRIES(X)	\
+		X(Draw, void, DrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count), (void)0)	\
+		X(Draw, void, DrawElements, (GLenum mode, GLsizei count, GLenum type, const void* indices), (mode, count, type, indices), (void)0)	\
+		X(Draw, void, MultiDrawElements, (GLenum mode, const GLsizei* count, GLenum type, const void* const* indices, GLsizei drawcount), (mode, count, type, indices, drawcount), (void)0)	\
+		X(Draw, void, DrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount), (void)0)	\
+		X(Draw, void, DrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount), (mode, count, type, indices, instancecount), (void)0)	\
+		X(Draw, void, DrawElementsBaseVertex, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex), (mode, count, type, indices, basevertex), (void)0)	\
+		X(State, void, BindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer), bind_framebuffer(interceptor, target, framebuffer))	\
+		X(State, void, BindVertexArray, (GLuint array), (array), set_state(interceptor, TrackedState::VertexArray, 0, array))	\
+		X(State, void, ActiveTexture, (GLenum texture), (texture), set_state(interceptor, TrackedState::ActiveTexture, 0, texture))	\
+		X(State, void, BindTexture, (GLenum target, GLuint texture), (target, texture), bind_texture(interceptor, target, texture))	\
+		X(State, void, BindBuffer, (GLenum target, GLuint buffer), (target, buffer), bind_buffer(interceptor, target, buffer))	\
+		X(State, void, BindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer), set_state(interceptor, TrackedState::Renderbuffer, 0, renderbuffer))	\
+		X(State, void, UseProgram, (GLuint program), (program), set_state(interceptor, TrackedState::Program, 0, program))	\
+		X(State, void, Enable, (GLenum cap), (cap), set_state(interceptor, TrackedState::Capability, cap, 1))	\
+		X(State, void, Disable, (GLenum cap), (cap), set_state(interceptor, TrackedState::Capability, cap, 0))	\
+		X(State, void, DepthFunc, (GLenum func), (func), set_state(interceptor, TrackedState::DepthFunc, 0, func))	\
+		X(State, void, DepthMask, (GLboolean flag), (flag), set_state(interceptor, TrackedState::DepthMask, 0, flag))	\
+		X(State, void, StencilMask, (GLuint mask), (mask), set_state(interceptor, TrackedState::StencilMask, 0, mask))	\
+		X(State, void, StencilFunc, (GLenum func, GLint ref, GLuint mask), (func, ref, mask), set_state_of(interceptor, TrackedState::StencilFunc, func, ref, mask))	\
+		X(State, void, StencilOp, (GLenum fail, GLenum zfail, GLenum zpass), (fail, zfail, zpass), set_state_of(interceptor, TrackedState::StencilOp, fail, zfail, zpass))	\
+		X(State, void, CullFace, (GLenum mode), (mode), set_state(interceptor, TrackedState::CullFace, 0, mode))	\
+		X(State, void, FrontFace, (GLenum mode), (mode), set_state(interceptor, TrackedState::FrontFace, 0, mode))	\
+		X(State, void, BlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor), set_state_of(interceptor, TrackedState::BlendFunc, sfactor, dfactor))	\
+		X(State, void, ColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), (red, green, blue, alpha), set_state_of(interceptor, TrackedState::ColorMask, red, green, blue, alpha))	\
+		X(State, void, Viewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), set_state_of(interceptor, TrackedState::Viewport, x, y, width, height))	\
+		X(State, void, Scissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), set_state_of(interceptor, TrackedState::Scissor, x, y, width, height))	\
+		X(State, void, PolygonOffset, (GLfloat factor, GLfloat units), (factor, units), set_state_of(interceptor, TrackedState::PolygonOffset, factor, units))	\
+		X(State, void, DrawBuffer, (GLenum buf), (buf), draw_buffers(interceptor, 1, &buf))	\
+		X(State, void, DrawBuffers, (GLsizei n, const GLenum* bufs), (n, bufs), draw_buffers(interceptor, n, bufs))	\
+		X(State, void, ReadBuffer, (GLenum src), (src), set_state(interceptor, TrackedState::ReadBuffer, get_state(interceptor, TrackedState::ReadFramebuffer), src))	\
+		X(State, void, PixelStorei, (GLenum pname, GLint param), (pname, param), set_state(interceptor, TrackedState::PixelStore, pname, param))	\
+		X(State, void, ClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha), set_state_of(interceptor, TrackedState::ClearColor, red, green, blue, alpha))	\
+		X(Uniform, void, Uniform1i, (GLint location, GLint v0), (location, v0), (void)0)	\
+		X(Uniform, void, Uniform1f, (GLint location, GLfloat v0), (location, v0), (void)0)	\
+		X(Uniform, void, Uniform2fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value), (void)0)	\
+		X(Uniform, void, Uniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2), (void)0)	\
+		X(Uniform, void, Uniform3fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value), (void)0)	\
+		X(Uniform, void, Uniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3), (void)0)	\
+		X(Uniform, void, Uniform4fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value), (void)0)	\
+		X(Uniform, void, UniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value), (void)0)	\
+		X(Uniform, void, UniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value), (void)0)	\
+		X(Upload, void, BufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), (target, size, data, usage), interceptor.on_upload(data ? size : 0))	\
+		X(Upload, void, BufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), (target, offset, size, data), interceptor.on_upload(size))	\
+		X(Upload, void, TexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels),	\
+			(target, level, internalformat, width, height, border, format, type, pixels), interceptor.on_upload(get_image_size(width, height, 1, format, type, pixels)))	\
+		X(Upload, void, TexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels),	\
+			(target, level, xoffset, yoffset, width, height, format, type, pixels), interceptor.on_upload(get_image_size(width, height, 1, format, type, pixels)))	\
+		X(Upload, void, TexImage3D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels),	\
+			(target, level, internalformat, width, height, depth, border, format, type, pixels), interceptor.on_upload(get_image_size(width, height, depth, format, type, pixels)))	\
+		X(Upload, void, TexSubImage3D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels),	\
+			(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels), interceptor.on_upload(get_image_size(width, height, depth, format, type, pixels)))	\
+		X(Query, GLenum, GetError, (void), (), (void)0)	\
+		X(Query, void, GetIntegerv, (GLenum pname, GLint* data), (pname, data), (void)0)	\
+		X(Query, void, GetInteger64v, (GLenum pname, GLint64* data), (pname, data), (void)0)	\
+		X(Query, void, GetProgramiv, (GLuint program, GLenum pname, GLint* params), (program, pname, params), (void)0)	\
+		X(Query, void, GetShaderiv, (GLuint shader, GLenum pname, GLint* params), (shader, pname, params), (void)0)	\
+		X(Query, void, GetQueryObjectuiv, (GLuint id, GLenum pname, GLuint* params), (id, pname, params), (void)0)	\
+		X(Query, void, GetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64* params), (id, pname, params), (void)0)	\
+		X(Query, GLint, GetUniformLocation, (GLuint program, const GLchar* name), (program, name), (void)0)	\
+		X(Query, void, ReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels), (x, y, width, height, format, type, pixels), (void)0)	\
+		X(Query, void, Finish, (void), (), (void)0)	\
+		X(Other, void, Flush, (void), (), (void)0)	\
+		X(Other, void, Clear, (GLbitfield mask), (mask), (void)0)	\
+		X(Other, void, BlitFramebuffer, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter),	\
+			(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter), (void)0)	\
+		X(Other, void, GenerateMipmap, (GLenum target), (target), (void)0)	\
+		X(Other, void, TexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param), (void)0)	\
+		X(Other, void, BeginQuery, (GLenum target, GLuint id), (target, id), (void)0)	\
+		X(Other, void, EndQuery, (GLenum target), (target), (void)0)	\
+		X(Other, void, QueryCounter, (GLuint id, GLenum target), (id, target), (void)0)	\
+		X(Other, void, DeleteTextures, (GLsizei n, const GLuint* textures), (n, textures), interceptor.reset_state())	\
+		X(Other, void, DeleteBuffers, (GLsizei n, const GLuint* buffers), (n, buffers), interceptor.reset_state())	\
+		X(Other, void, DeleteVertexArrays, (GLsizei n, const GLuint* arrays), (n, arrays), interceptor.reset_state())	\
+		X(Other, void, DeleteFramebuffers, (GLsizei n, const GLuint* framebuffers), (n, framebuffers), interceptor.reset_state())	\
+		X(Other, void, DeleteRenderbuffers, (GLsizei n, const GLuint* renderbuffers), (n, renderbuffers), interceptor.reset_state())	\
+		X(Other, void, DeleteProgram, (GLuint program), (program), interceptor.reset_state())
+
+	#define DECLARE_ENTRY_ID(kind, ret, name, params, args, effect) id_##name,
+	enum EntryId : unsigned int
+	{
+		GL_INTERCEPTED_ENTRIES(DECLARE_ENTRY_ID)
+		ENTRY_COUNT
+	};
+	#undef DECLARE_ENTRY_ID
+
+	#define DECLARE_ENTRY_NAME(kind, ret, name, params, args, effect) "gl" #name,
+	const char* const ENTRY_NAMES[] = { GL_INTERCEPTED_ENTRIES(DECLARE_ENTRY_NAME) };
+	#undef DECLARE_ENTRY_NAME
+
+	// the entry point loaded by glad and its wrapper, which does its bookkeeping before the call
+	#define DEFINE_ENTRY_WRAPPER(kind, ret, name, params, args, effect)	\
+		decltype(glad_gl##name) real_##name = nullptr;					\
+		ret APIENTRY intercept_##name params							\
+		{																\
+			GLInterceptor& interceptor = GLInterceptor::get_singleton();	\
+			interceptor.on_call(id_##name, GLInterceptor::CallKind::kind);	\
+			effect;														\
+			if (std::ostream* out = interceptor.get_recording())		\
+				CallWriter(*out, ENTRY_NAMES[id_##name]) args;			\
+			return real_##name args;									\
+		}
+	GL_INTERCEPTED_ENTRIES(DEFINE_ENTRY_WRAPPER)
+	#undef DEFINE_ENTRY_WRAPPER
+}
+
+void GLInterceptor::install()
+{
+	if (_installed)
+		return;
+
+	#define INSTALL_ENTRY(kind, ret, name, params, args, effect)	\
+		if (glad_gl##name)										\
+		{														\
+			real_##name = glad_gl##name;						\
+			glad_gl##name = intercept_##name;					\
+		}
+	GL_INTERCEPTED_ENTRIES(INSTALL_ENTRY)
+	#undef INSTALL_ENTRY
+
+	// the state set before is unknown
+	reset_state();
+	_frame = FrameStats{ };
+	_frame.calls_by_entry.resize(ENTRY_COUNT);
+	_installed = true;
+}
+
+void GLInterceptor::uninstall()
+{
+	if (!_installed)
+		return;
+
+	#define UNINSTALL_ENTRY(kind, ret, name, params, args, effect)	\
+		if (real_##name)										\
+		{														\
+			glad_gl##name = real_##name;						\
+			real_##name = nullptr;								\
+		}
+	GL_INTERCEPTED_ENTRIES(UNINSTALL_ENTRY)
+	#undef UNINSTALL_ENTRY
+
+	if (_recording.is_open())
+		_recording.close();
+	_installed = false;
+}
+
+void GLInterceptor::end_frame()
+{
+	if (_recording.is_open())
+	{
+		_recording.close();
+		std::cout << "Recorded " << _frame.calls << " GL calls to " << _recording_path << std::endl;
+	}
+	_last_frame = _frame;
+	_frame = FrameStats{ };
+	_frame.calls_by_entry.resize(ENTRY_COUNT);
+}
+
+bool GLInterceptor::record_frame(const std::string& path)
+{
+	if (!_installed)
+		return false;
+
+	_recording.close();
+	_recording.open(path);
+	if (!_recording)
+	{
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+	_recording_path = path;
+	return true;
+}
+
+unsigned int GLInterceptor::get_entry_count()
+{
+	return ENTRY_COUNT;
+}
+
+const char* GLInterceptor::get_entry_name(unsigned int entry)
+{
+	return entry < ENTRY_COUNT ? ENTRY_NAMES[entry] : "";
+}
+
+void GLInterceptor::on_call(unsigned int entry, CallKind kind)
+{
+	++_frame.calls;
+	++_frame.calls_by_entry[entry];
+	switch (kind)
+	{
+	case CallKind::Draw: ++_frame.draws; break;
+	case CallKind::State: ++_frame.state_changes; break;
+	case CallKind::Uniform: ++_frame.uniform_updates; break;
+	case CallKind::Query: ++_frame.queries; break;
+	default: break;
+	}
+}
+
+bool GLInterceptor::update_state(unsigned int state, unsigned int sub, uint64_t value)
+{
+	const uint64_t key = ((uint64_t)state << 32) | sub;
+	auto it = _state.find(key);
+	if (it == _state.end())
+	{
+		_state.emplace(key, value);
+		return true;
+	}
+	if (it->second == value)
+		return false;
+	it->second = value;
+	return true;
+}
+
+uint64_t GLInterceptor::get_state(unsigned int state, unsigned int sub) const
+{
+	auto it = _state.find(((uint64_t)state << 32) | sub);
+	return it != _state.end() ? it->second : 0;
+}
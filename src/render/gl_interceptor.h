@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/singleton.h"
+
+// Counts the GL calls of every frame, and writes the calls of a frame to a file on request. Installed,
+// it puts wrappers in place of a subset of the entry points loaded by glad: draws, state changes,
+// uniforms, uploads, queries and object deletion. State changes are compared to the last value set
+// through the wrappers to count the ones that change nothing. GL thread only.
+class GLInterceptor : public Singleton<GLInterceptor>
+{
+public:
+	enum class CallKind : unsigned int
+	{
+		Draw,
+		State,
+		Uniform,
+		Upload,
+		Query,
+		Other,
+	};
+
+	struct FrameStats
+	{
+		uint64_t calls;
+		unsigned int draws;
+		unsigned int state_changes;
+		unsigned int redundant_state_changes;	// set the value already set
+		unsigned int uniform_updates;
+		unsigned int queries;					// read back from the GL, which may wait for the GPU
+		uint64_t uploaded_bytes;
+		std::vector<unsigned int> calls_by_entry;	// indexed like get_entry_name
+	};
+
+	GLInterceptor() = default;
+	~GLInterceptor() { uninstall(); }
+
+	GLInterceptor(const GLInterceptor&) = delete;
+	GLInterceptor(GLInterceptor&&) = delete;
+	GLInterceptor& operator=(const GLInterceptor&) = delete;
+	GLInterceptor& operator=(GLInterceptor&&) = delete;
+
+	// after glad loaded the entry points
+	void install();
+	void uninstall();
+	bool is_installed() const { return _installed; }
+
+	// ends the frame of the stats and of a recording
+	void end_frame();
+	// of the last frame ended
+	const FrameStats& get_frame_stats() const { return _last_frame; }
+	// writes the calls until the next end_frame to a text file, one a line with their arguments
+	bool record_frame(const std::string& path);
+
+	static unsigned int get_entry_count();
+	static const char* get_entry_name(unsigned int entry);
+
+	// called by the wrappers
+	void on_call(unsigned int entry, CallKind kind);
+	// returns false when the state had the value already
+	bool update_state(unsigned int state, unsigned int sub, uint64_t value);
+	uint64_t get_state(unsigned int state, unsigned int sub) const;
+	void on_redundant_state() { ++_frame.redundant_state_changes; }
+	void on_upload(uint64_t bytes) { _frame.uploaded_bytes += bytes; }
+	// after a deletion the bindings of the object are unknown
+	void reset_state() { _state.clear(); }
+	std::ostream* get_recording() { return _recording.is_open() ? &_recording : nullptr; }
+
+private:
+	bool _installed{ false };
+	FrameStats _frame{ };
+	FrameStats _last_frame{ };
+	std::unordered_map<uint64_t, uint64_t> _state{ };	// last value by state and sub
+	std::ofstream _recording{ };
+	std::string _recording_path{ };
+};
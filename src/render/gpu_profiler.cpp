@@ -0,0 +1,106 @@
+﻿#include "gpu_profiler.h"
+#include <glad/glad.h>
+#include "graphic_api.h"
+
+template<> GpuProfiler* Singleton<GpuProfiler>::singleton = nullptr;
+
+void GpuProfiler::begin_frame()
+{
+	Frame& frame = _frames[_frame_index];
+	if (frame.pending)
+		read_frame(frame);
+	frame.zones.clear();
+	_depth = 0;
+
+	const Profiler* profiler = Profiler::get_singletonPtr();
+	_active = _enabled || (profiler && profiler->is_capturing());
+	if (_active)
+		_frame_index = (_frame_index + 1) % FRAME_LATENCY;
+}
+
+int GpuProfiler::begin_zone(const char* name)
+{
+	if (!_active)
+		return -1;
+
+	// _frame_index moved past the frame being recorded
+	Frame& frame = _frames[(_frame_index + FRAME_LATENCY - 1) % FRAME_LATENCY];
+	const size_t zone = frame.zones.size();
+	if (frame.queries.size() < 2 * (zone + 1))
+	{
+		const size_t count = frame.queries.size();
+		frame.queries.resize(2 * (zone + 1));
+		CHECK_GL_ERROR(glGenQueries((GLsizei)(frame.queries.size() - count), &frame.queries[count]));
+	}
+	frame.zones.push_back({ name, _depth++ });
+	frame.pending = true;
+	CHECK_GL_ERROR(glQueryCounter(frame.queries[2 * zone], GL_TIMESTAMP));
+	return (int)zone;
+}
+
+void GpuProfiler::end_zone(int zone)
+{
+	if (zone < 0 || !_active)
+		return;
+
+	Frame& frame = _frames[(_frame_index + FRAME_LATENCY - 1) % FRAME_LATENCY];
+	--_depth;
+	CHECK_GL_ERROR(glQueryCounter(frame.queries[2 * zone + 1], GL_TIMESTAMP));
+}
+
+void GpuProfiler::read_frame(Frame& frame)
+{
+	frame.pending = false;
+	_results.clear();
+	if (frame.zones.empty())
+		return;
+
+	// a frame whose queries are not all done yet is dropped rather than waited for
+	for (size_t i = 0; i < 2 * frame.zones.size(); ++i)
+	{
+		GLuint available = 0;
+		CHECK_GL_ERROR(glGetQueryObjectuiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available));
+		if (!available)
+			return;
+	}
+
+	// maps the GPU clock to the one of the CPU profiler, both count nanoseconds
+	Profiler* profiler = Profiler::get_singletonPtr();
+	int64_t offset = 0;
+	if (profiler && profiler->is_capturing())
+	{
+		GLint64 gpu_now = 0;
+		CHECK_GL_ERROR(glGetInteger64v(GL_TIMESTAMP, &gpu_now));
+		offset = (int64_t)Profiler::now() - gpu_now;
+	}
+	else
+	{
+		profiler = nullptr;
+	}
+
+	++_results_frame;
+	for (size_t i = 0; i < frame.zones.size(); ++i)
+	{
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		CHECK_GL_ERROR(glGetQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &begin));
+		CHECK_GL_ERROR(glGetQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end));
+		_results.push_back({ frame.zones[i].name, (end - begin) * 1e-6f, frame.zones[i].depth });
+		if (profiler)
+			profiler->record_gpu(frame.zones[i].name, begin + offset, end + offset);
+	}
+}
+
+void GpuProfiler::release()
+{
+	for (auto& frame : _frames)
+	{
+		if (!frame.queries.empty())
+			CHECK_GL_ERROR(glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data()));
+		frame.queries.clear();
+		frame.zones.clear();
+		frame.pending = false;
+	}
+	_results.clear();
+	_active = false;
+}
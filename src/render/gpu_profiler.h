@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "common/singleton.h"
+#include "common/profiler.h"
+
+// GPU time of zones of the frame from timestamp queries. The queries of a frame are read
+// FRAME_LATENCY frames later, when the GPU is done with them, so reading never waits. Zones are timed
+// while enabled or while the CPU profiler captures, and go to the trace of the CPU profiler on a GPU
+// track under the same names. One is owned by the renderer, zones are opened on the GL thread only.
+class GpuProfiler : public Singleton<GpuProfiler>
+{
+public:
+	static const unsigned int FRAME_LATENCY = 4;
+
+	struct Result
+	{
+		const char* name;
+		float ms;
+		unsigned int depth;		// of nested zones
+	};
+
+	GpuProfiler() = default;
+	~GpuProfiler() { release(); }
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler(GpuProfiler&&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(GpuProfiler&&) = delete;
+
+	void set_enabled(bool enabled) { _enabled = enabled; }
+	bool is_enabled() const { return _enabled; }
+
+	// reads the results of the oldest frame and starts the queries of a new one
+	void begin_frame();
+	// returns the zone to end, -1 when not timing this frame. name must outlive the profiler.
+	int begin_zone(const char* name);
+	void end_zone(int zone);
+	void release();
+
+	// zones of the last frame read, in the order they began. Empty when the last frame due was dropped,
+	// its queries not done yet.
+	const std::vector<Result>& get_results() const { return _results; }
+	// counts the frames read, the results are those of a new frame when it changed
+	uint64_t get_results_frame() const { return _results_frame; }
+
+private:
+	struct Zone
+	{
+		const char* name;
+		unsigned int depth;
+	};
+
+	struct Frame
+	{
+		std::vector<unsigned int> queries;	// begin and end timestamp of every zone
+		std::vector<Zone> zones;
+		bool pending;
+	};
+
+	void read_frame(Frame& frame);
+
+	bool _enabled{ false };
+	bool _active{ false };
+	Frame _frames[FRAME_LATENCY]{ };
+	unsigned int _frame_index{ 0 };
+	unsigned int _depth{ 0 };
+	std::vector<Result> _results{ };
+	uint64_t _results_frame{ 0 };
+};
+
+class GpuProfileZone
+{
+public:
+	explicit GpuProfileZone(const char* name)
+		: _profiler(GpuProfiler::get_singletonPtr())
+		, _zone(_profiler ? _profiler->begin_zone(name) : -1)
+	{
+	}
+
+	~GpuProfileZone()
+	{
+		if (_profiler)
+			_profiler->end_zone(_zone);
+	}
+
+	GpuProfileZone(const GpuProfileZone&) = delete;
+	GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+
+private:
+	GpuProfiler* _profiler;
+	int _zone;
+};
+
+#ifdef ENABLE_PROFILER
+	// times the rest of the enclosing scope on the CPU and on the GPU
+	#define PROFILE_GPU_ZONE(name) PROFILE_ZONE(name); GpuProfileZone PROFILE_CONCAT(gpu_profile_zone_, __LINE__)(name)
+#else
+	#define PROFILE_GPU_ZONE(name) do { } while (false)
+#endif
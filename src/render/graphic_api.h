@@ -1,11 +1,15 @@
 ﻿#pragma once
 #include <stdio.h>
+#include "gl_extensions.h"
 
 #ifdef _DEBUG
+	// with debug output the driver reports errors itself, glGetError would only add a sync point
 	#define CHECK_GL_ERROR(Condition)		\
 		do									\
 		{									\
 			Condition;						\
+			if (get_gl_extensions().debug_output)	\
+				break;						\
 			GLenum no = glGetError();		\
 			if (no != 0)					\
 			{								\
@@ -0,0 +1,384 @@
+﻿#include "light_grid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "common/job_system.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_GRID_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// far enough that the squared distance overflows, so padding never passes a test
+	const float PADDING_POSITION = 1e30f;
+
+	// bit i is set when the sphere of light first + i overlaps the box
+	template<class LightSet>
+	unsigned int test_spheres(const LightSet& set, size_t first, const Vector3& min, const Vector3& max)
+	{
+#ifdef LIGHT_GRID_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 x = _mm_loadu_ps(&set.x[first]);
+		const __m128 y = _mm_loadu_ps(&set.y[first]);
+		const __m128 z = _mm_loadu_ps(&set.z[first]);
+		const __m128 radius = _mm_loadu_ps(&set.radius[first]);
+		const __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(min.x), x), zero), _mm_max_ps(_mm_sub_ps(x, _mm_set1_ps(max.x)), zero));
+		const __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(min.y), y), zero), _mm_max_ps(_mm_sub_ps(y, _mm_set1_ps(max.y)), zero));
+		const __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(min.z), z), zero), _mm_max_ps(_mm_sub_ps(z, _mm_set1_ps(max.z)), zero));
+		const __m128 distance_sqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return (unsigned int)_mm_movemask_ps(_mm_cmple_ps(distance_sqr, _mm_mul_ps(radius, radius)));
+#else
+		unsigned int mask = 0;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			const float dx = std::max(min.x - set.x[first + i], 0.0f) + std::max(set.x[first + i] - max.x, 0.0f);
+			const float dy = std::max(min.y - set.y[first + i], 0.0f) + std::max(set.y[first + i] - max.y, 0.0f);
+			const float dz = std::max(min.z - set.z[first + i], 0.0f) + std::max(set.z[first + i] - max.z, 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= set.radius[first + i] * set.radius[first + i])
+				mask |= 1u << i;
+		}
+		return mask;
+#endif
+	}
+
+	// bit i is set when the cone of spot light first + i may reach the sphere, see
+	// "Cull that cone!" by Bart Wronski
+	template<class LightSet>
+	unsigned int test_cones(const LightSet& set, size_t first, const Vector3& center, float sphere_radius)
+	{
+#ifdef LIGHT_GRID_SSE
+		const __m128 vx = _mm_sub_ps(_mm_set1_ps(center.x), _mm_loadu_ps(&set.x[first]));
+		const __m128 vy = _mm_sub_ps(_mm_set1_ps(center.y), _mm_loadu_ps(&set.y[first]));
+		const __m128 vz = _mm_sub_ps(_mm_set1_ps(center.z), _mm_loadu_ps(&set.z[first]));
+		const __m128 length_sqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		const __m128 axis = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(vx, _mm_loadu_ps(&set.dir_x[first])),
+			_mm_mul_ps(vy, _mm_loadu_ps(&set.dir_y[first]))),
+			_mm_mul_ps(vz, _mm_loadu_ps(&set.dir_z[first])));
+		const __m128 closest = _mm_sub_ps(
+			_mm_mul_ps(_mm_loadu_ps(&set.cos_angle[first]), _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(length_sqr, _mm_mul_ps(axis, axis)), _mm_setzero_ps()))),
+			_mm_mul_ps(axis, _mm_loadu_ps(&set.sin_angle[first])));
+		const __m128 radius = _mm_set1_ps(sphere_radius);
+		const __m128 culled = _mm_or_ps(_mm_or_ps(
+			_mm_cmpgt_ps(closest, radius),
+			_mm_cmpgt_ps(axis, _mm_add_ps(radius, _mm_loadu_ps(&set.radius[first])))),
+			_mm_cmplt_ps(axis, _mm_sub_ps(_mm_setzero_ps(), radius)));
+		return (unsigned int)_mm_movemask_ps(culled) ^ 0xFu;
+#else
+		unsigned int mask = 0;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			const Vector3 v = center - Vector3(set.x[first + i], set.y[first + i], set.z[first + i]);
+			const float axis = v.x * set.dir_x[first + i] + v.y * set.dir_y[first + i] + v.z * set.dir_z[first + i];
+			const float closest = set.cos_angle[first + i] * std::sqrt(std::max(glm::dot(v, v) - axis * axis, 0.0f)) - axis * set.sin_angle[first + i];
+			if (!(closest > sphere_radius || axis > sphere_radius + set.radius[first + i] || axis < -sphere_radius))
+				mask |= 1u << i;
+		}
+		return mask;
+#endif
+	}
+
+	unsigned int lowest_bit(unsigned int mask)
+	{
+		unsigned int bit = 0;
+		while (!(mask & (1u << bit)))
+			++bit;
+		return bit;
+	}
+
+	// appends the lights of a mask to the cluster light list
+	void append_lights(const std::vector<uint32_t>& index, size_t first, unsigned int mask, std::vector<uint32_t>& indices, unsigned int& count)
+	{
+		for (; mask != 0; mask &= mask - 1)
+		{
+			indices.push_back(index[first + lowest_bit(mask)]);
+			++count;
+		}
+	}
+}
+
+void LightGrid::LightSet::clear()
+{
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+	dir_x.clear();
+	dir_y.clear();
+	dir_z.clear();
+	cos_angle.clear();
+	sin_angle.clear();
+	index.clear();
+}
+
+void LightGrid::LightSet::add(const LightSet& from, size_t i)
+{
+	x.push_back(from.x[i]);
+	y.push_back(from.y[i]);
+	z.push_back(from.z[i]);
+	radius.push_back(from.radius[i]);
+	index.push_back(from.index[i]);
+	if (!from.dir_x.empty())
+	{
+		dir_x.push_back(from.dir_x[i]);
+		dir_y.push_back(from.dir_y[i]);
+		dir_z.push_back(from.dir_z[i]);
+		cos_angle.push_back(from.cos_angle[i]);
+		sin_angle.push_back(from.sin_angle[i]);
+	}
+}
+
+void LightGrid::LightSet::pad()
+{
+	const size_t padded = (x.size() + 3) & ~size_t(3);
+	x.resize(padded, PADDING_POSITION);
+	y.resize(padded, PADDING_POSITION);
+	z.resize(padded, PADDING_POSITION);
+	radius.resize(padded, 0.0f);
+	if (!dir_x.empty())
+	{
+		dir_x.resize(padded, 0.0f);
+		dir_y.resize(padded, 0.0f);
+		dir_z.resize(padded, 1.0f);
+		cos_angle.resize(padded, 1.0f);
+		sin_angle.resize(padded, 0.0f);
+	}
+}
+
+float LightGrid::get_light_range(const Light& light, float max_range)
+{
+	const Vector3 color = glm::max(light.diffuse, light.specular);
+	const float brightness = std::max(color.r, std::max(color.g, color.b));
+	if (brightness <= 0.0f)
+		return 0.0f;
+
+	float constant, linear, quadratic;
+	if (light.type == LightType::Spot)
+	{
+		constant = light.spot.constant;
+		linear = light.spot.linear;
+		quadratic = light.spot.quadratic;
+	}
+	else
+	{
+		constant = light.omni.constant;
+		linear = light.omni.linear;
+		quadratic = light.omni.quadratic;
+	}
+
+	// solve constant + linear * d + quadratic * d^2 = 256 * brightness
+	const float target = 256.0f * brightness - constant;
+	float range = max_range;
+	if (quadratic > 0.0f)
+		range = (-linear + std::sqrt(linear * linear + 4.0f * quadratic * target)) / (2.0f * quadratic);
+	else if (linear > 0.0f)
+		range = target / linear;
+	return glm::clamp(range, 0.0f, max_range);
+}
+
+void LightGrid::update(const Matrix4& view, float fov_y, float aspect, float near, float far,
+	const std::vector<Light>& omni_lights, const std::vector<Light>& spot_lights)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	if (fov_y != _fov_y || aspect != _aspect || near != _near || far != _far)
+		update_bounds(fov_y, aspect, near, far);
+
+	_omni.clear();
+	for (size_t i = 0; i < omni_lights.size(); ++i)
+	{
+		const Light& light = omni_lights[i];
+		const Vector3 position = Vector3(view * Vector4(light.omni.position, 1.0f));
+		const float radius = get_light_range(light, far);
+		if (radius <= 0.0f || -position.z + radius < near || -position.z - radius > far)
+			continue;
+		_omni.x.push_back(position.x);
+		_omni.y.push_back(position.y);
+		_omni.z.push_back(position.z);
+		_omni.radius.push_back(radius);
+		_omni.index.push_back((uint32_t)i);
+	}
+
+	_spot.clear();
+	for (size_t i = 0; i < spot_lights.size(); ++i)
+	{
+		const Light& light = spot_lights[i];
+		const Vector3 position = Vector3(view * Vector4(light.spot.position, 1.0f));
+		const Vector3 direction = glm::normalize(Matrix3(view) * light.spot.direction);
+		const float radius = get_light_range(light, far);
+		if (radius <= 0.0f || -position.z + radius < near || -position.z - radius > far)
+			continue;
+		const float cos_angle = glm::clamp(light.spot.outerCutOff, -1.0f, 1.0f);
+		_spot.x.push_back(position.x);
+		_spot.y.push_back(position.y);
+		_spot.z.push_back(position.z);
+		_spot.radius.push_back(radius);
+		_spot.dir_x.push_back(direction.x);
+		_spot.dir_y.push_back(direction.y);
+		_spot.dir_z.push_back(direction.z);
+		_spot.cos_angle.push_back(cos_angle);
+		_spot.sin_angle.push_back(std::sqrt(1.0f - cos_angle * cos_angle));
+		_spot.index.push_back((uint32_t)i);
+	}
+
+	_clusters.resize(CLUSTER_COUNT);
+	_slices.resize(SLICES);
+	if (JobSystem* job_system = JobSystem::get_singletonPtr())
+	{
+		job_system->parallel_for(SLICES, [this](size_t z) { assign_slice((unsigned int)z); });
+	}
+	else
+	{
+		for (unsigned int z = 0; z < SLICES; ++z)
+			assign_slice(z);
+	}
+
+	// the slices have offsets into their own lists, join them
+	_light_indices.clear();
+	_stats = Stats();
+	for (unsigned int z = 0; z < SLICES; ++z)
+	{
+		const uint32_t base = (uint32_t)_light_indices.size();
+		for (unsigned int i = z * TILES_X * TILES_Y; i < (z + 1) * TILES_X * TILES_Y; ++i)
+		{
+			_clusters[i].offset += base;
+			_stats.max_cluster_lights = std::max(_stats.max_cluster_lights, (unsigned int)_clusters[i].omni_count + _clusters[i].spot_count);
+		}
+		_light_indices.insert(_light_indices.end(), _slices[z].indices.begin(), _slices[z].indices.end());
+	}
+
+	_stats.omni_lights = (unsigned int)_omni.size();
+	_stats.spot_lights = (unsigned int)_spot.size();
+	_stats.light_indices = _light_indices.size();
+	_stats.assign_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightGrid::update_bounds(float fov_y, float aspect, float near, float far)
+{
+	_fov_y = fov_y;
+	_aspect = aspect;
+	_near = near;
+	_far = far;
+	_slice_scale = SLICES / std::log(far / near);
+	_slice_bias = -SLICES * std::log(near) / std::log(far / near);
+
+	const float tan_y = std::tan(fov_y * 0.5f);
+	const float tan_x = tan_y * aspect;
+	const auto get_bounds = [=](float x0, float x1, float y0, float y1, float depth0, float depth1)
+	{
+		// the froxel widens with depth, its box spans the near and the far face
+		Bounds bounds;
+		bounds.min = Vector3(std::min(x0 * depth0, x0 * depth1) * tan_x, std::min(y0 * depth0, y0 * depth1) * tan_y, -depth1);
+		bounds.max = Vector3(std::max(x1 * depth0, x1 * depth1) * tan_x, std::max(y1 * depth0, y1 * depth1) * tan_y, -depth0);
+		return bounds;
+	};
+
+	_cluster_bounds.resize(CLUSTER_COUNT);
+	_row_bounds.resize(TILES_Y * SLICES);
+	_column_bounds.resize(TILES_X * SLICES);
+	for (unsigned int z = 0; z < SLICES; ++z)
+	{
+		const float depth0 = near * std::pow(far / near, (float)z / SLICES);
+		const float depth1 = near * std::pow(far / near, (float)(z + 1) / SLICES);
+		for (unsigned int y = 0; y < TILES_Y; ++y)
+		{
+			const float y0 = -1.0f + 2.0f * y / TILES_Y;
+			const float y1 = -1.0f + 2.0f * (y + 1) / TILES_Y;
+			_row_bounds[z * TILES_Y + y] = get_bounds(-1.0f, 1.0f, y0, y1, depth0, depth1);
+			for (unsigned int x = 0; x < TILES_X; ++x)
+			{
+				const float x0 = -1.0f + 2.0f * x / TILES_X;
+				const float x1 = -1.0f + 2.0f * (x + 1) / TILES_X;
+				if (y == 0)
+					_column_bounds[z * TILES_X + x] = get_bounds(x0, x1, -1.0f, 1.0f, depth0, depth1);
+				_cluster_bounds[x + TILES_X * (y + TILES_Y * z)] = get_bounds(x0, x1, y0, y1, depth0, depth1);
+			}
+		}
+	}
+}
+
+void LightGrid::assign_slice(unsigned int z)
+{
+	Slice& slice = _slices[z];
+	slice.indices.clear();
+
+	// lights reaching the depth range of the slice
+	const Bounds& first_row = _row_bounds[z * TILES_Y];
+	const float depth0 = -first_row.max.z;
+	const float depth1 = -first_row.min.z;
+	slice.omni.clear();
+	for (size_t i = 0; i < _omni.size(); ++i)
+	{
+		if (-_omni.z[i] + _omni.radius[i] >= depth0 && -_omni.z[i] - _omni.radius[i] <= depth1)
+			slice.omni.add(_omni, i);
+	}
+	slice.omni.pad();
+	slice.spot.clear();
+	for (size_t i = 0; i < _spot.size(); ++i)
+	{
+		if (-_spot.z[i] + _spot.radius[i] >= depth0 && -_spot.z[i] - _spot.radius[i] <= depth1)
+			slice.spot.add(_spot, i);
+	}
+	slice.spot.pad();
+
+	// masks of the light groups reaching each column and row, so that a froxel only tests the
+	// groups reaching both
+	const size_t omni_groups = slice.omni.get_group_count();
+	const size_t spot_groups = slice.spot.get_group_count();
+	slice.column_omni.resize(TILES_X * omni_groups);
+	slice.column_spot.resize(TILES_X * spot_groups);
+	for (unsigned int x = 0; x < TILES_X; ++x)
+	{
+		const Bounds& column = _column_bounds[z * TILES_X + x];
+		for (size_t group = 0; group < omni_groups; ++group)
+			slice.column_omni[x * omni_groups + group] = (uint8_t)test_spheres(slice.omni, group * 4, column.min, column.max);
+		for (size_t group = 0; group < spot_groups; ++group)
+			slice.column_spot[x * spot_groups + group] = (uint8_t)test_spheres(slice.spot, group * 4, column.min, column.max);
+	}
+	slice.row_omni.resize(omni_groups);
+	slice.row_spot.resize(spot_groups);
+
+	for (unsigned int y = 0; y < TILES_Y; ++y)
+	{
+		const Bounds& row = _row_bounds[z * TILES_Y + y];
+		for (size_t group = 0; group < omni_groups; ++group)
+			slice.row_omni[group] = (uint8_t)test_spheres(slice.omni, group * 4, row.min, row.max);
+		for (size_t group = 0; group < spot_groups; ++group)
+			slice.row_spot[group] = (uint8_t)test_spheres(slice.spot, group * 4, row.min, row.max);
+
+		for (unsigned int x = 0; x < TILES_X; ++x)
+		{
+			const unsigned int index = x + TILES_X * (y + TILES_Y * z);
+			const Bounds& bounds = _cluster_bounds[index];
+			const Vector3 center = (bounds.min + bounds.max) * 0.5f;
+			const float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+
+			Cluster& cluster = _clusters[index];
+			cluster.offset = (uint32_t)slice.indices.size();
+			unsigned int omni_count = 0;
+			const uint8_t* column_omni = slice.column_omni.data() + x * omni_groups;
+			for (size_t group = 0; group < omni_groups; ++group)
+			{
+				unsigned int mask = slice.row_omni[group] & column_omni[group];
+				if (!mask)
+					continue;
+				mask &= test_spheres(slice.omni, group * 4, bounds.min, bounds.max);
+				append_lights(slice.omni.index, group * 4, mask, slice.indices, omni_count);
+			}
+			unsigned int spot_count = 0;
+			const uint8_t* column_spot = slice.column_spot.data() + x * spot_groups;
+			for (size_t group = 0; group < spot_groups; ++group)
+			{
+				unsigned int mask = slice.row_spot[group] & column_spot[group];
+				if (!mask)
+					continue;
+				mask &= test_spheres(slice.spot, group * 4, bounds.min, bounds.max) & test_cones(slice.spot, group * 4, center, radius);
+				append_lights(slice.spot.index, group * 4, mask, slice.indices, spot_count);
+			}
+			cluster.omni_count = (uint16_t)std::min(omni_count, 0xFFFFu);
+			cluster.spot_count = (uint16_t)std::min(spot_count, 0xFFFFu);
+		}
+	}
+}
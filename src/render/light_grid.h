@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "math/math.h"
+#include "Light.h"
+
+// Assigns omni and spot lights to a grid of view space froxels for clustered forward shading.
+// Tiles split the screen, slices split the view depth exponentially. Every frame each slice is
+// assigned on the job system, testing four lights at a time against the froxel bounds.
+class LightGrid
+{
+public:
+	static const unsigned int TILES_X = 16;
+	static const unsigned int TILES_Y = 9;
+	static const unsigned int SLICES = 24;
+	static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+	// the lights of a froxel are light_indices[offset, offset + omni_count + spot_count), omni lights first
+	struct Cluster
+	{
+		uint32_t offset;
+		uint16_t omni_count;
+		uint16_t spot_count;
+	};
+
+	struct Stats
+	{
+		unsigned int omni_lights;		// in the view depth range
+		unsigned int spot_lights;
+		size_t light_indices;
+		unsigned int max_cluster_lights;
+		float assign_ms;
+	};
+
+	LightGrid() = default;
+	~LightGrid() = default;
+
+	LightGrid(const LightGrid&) = delete;
+	LightGrid(LightGrid&&) = delete;
+	LightGrid& operator=(const LightGrid&) = delete;
+	LightGrid& operator=(LightGrid&&) = delete;
+
+	// fov_y in radians
+	void update(const Matrix4& view, float fov_y, float aspect, float near, float far,
+		const std::vector<Light>& omni_lights, const std::vector<Light>& spot_lights);
+
+	// indexed by x + TILES_X * (y + TILES_Y * slice), y going up from the bottom of the screen
+	const std::vector<Cluster>& get_clusters() const { return _clusters; }
+	const std::vector<uint32_t>& get_light_indices() const { return _light_indices; }
+	// slice = log(view depth) * scale + bias
+	float get_slice_scale() const { return _slice_scale; }
+	float get_slice_bias() const { return _slice_bias; }
+	const Stats& get_stats() const { return _stats; }
+
+	// distance at which the attenuation falls below 1/256 of the brightest channel
+	static float get_light_range(const Light& light, float max_range);
+
+private:
+	// lights in view space as structure of arrays, padded to a multiple of four with lights that never pass
+	struct LightSet
+	{
+		std::vector<float> x, y, z, radius;
+		std::vector<float> dir_x, dir_y, dir_z, cos_angle, sin_angle;	// empty for omni lights
+		std::vector<uint32_t> index;
+
+		size_t size() const { return index.size(); }
+		size_t get_group_count() const { return (index.size() + 3) / 4; }
+		void clear();
+		void add(const LightSet& from, size_t i);
+		void pad();
+	};
+
+	struct Bounds
+	{
+		Vector3 min;
+		Vector3 max;
+	};
+
+	struct Slice
+	{
+		LightSet omni;
+		LightSet spot;
+		std::vector<uint8_t> row_omni;		// per light group, for the current row
+		std::vector<uint8_t> row_spot;
+		std::vector<uint8_t> column_omni;	// per column and light group
+		std::vector<uint8_t> column_spot;
+		std::vector<uint32_t> indices;
+	};
+
+	void update_bounds(float fov_y, float aspect, float near, float far);
+	void assign_slice(unsigned int z);
+
+	std::vector<Cluster> _clusters{ };
+	std::vector<uint32_t> _light_indices{ };
+	std::vector<Bounds> _cluster_bounds{ };
+	std::vector<Bounds> _row_bounds{ };
+	std::vector<Bounds> _column_bounds{ };
+	std::vector<Slice> _slices{ };
+	LightSet _omni{ };
+	LightSet _spot{ };
+	float _fov_y{ 0.0f };
+	float _aspect{ 0.0f };
+	float _near{ 0.0f };
+	float _far{ 0.0f };
+	float _slice_scale{ 0.0f };
+	float _slice_bias{ 0.0f };
+	Stats _stats{ };
+};
@@ -1,10 +1,30 @@
 ﻿#include "material.h"
+#include <cstdio>
 #include "shader.h"
 #include "texture.h"
 #include "renderer.h"
+#include "shader_manager.h"
+#include "material_manager.h"
 #include "glad/glad.h"
 #include "graphic_api.h"
 
+template<> MaterialManager* Singleton<MaterialManager>::singleton = nullptr;
+
+namespace
+{
+	const RenderState DEPTH_TEST_BIT = 1u << 0;
+	const RenderState DEPTH_WRITE_BIT = 1u << 1;
+	const unsigned int DEPTH_FUNC_SHIFT = 2;		// 3 bits
+	const unsigned int CULL_FACE_SHIFT = 5;			// 2 bits
+	const RenderState CLOCKWISE_BIT = 1u << 7;
+	const RenderState BLEND_BIT = 1u << 8;
+	const unsigned int BLEND_SRC_SHIFT = 9;			// 4 bits
+	const unsigned int BLEND_DST_SHIFT = 13;		// 4 bits
+
+	// indexed by DepthTestFunc
+	const GLenum DEPTH_FUNCS[] = { GL_ALWAYS, GL_NEVER, GL_LESS, GL_EQUAL, GL_LEQUAL, GL_GREATER, GL_NOTEQUAL, GL_GEQUAL };
+}
+
 decltype(GL_ONE) convert_blend_factor(AlphaBlendFactor factor)
 {
 	switch (factor)
@@ -27,34 +47,80 @@ decltype(GL_ONE) convert_blend_factor(AlphaBlendFactor factor)
 	}
 }
 
+template<typename Func>
+void Material::for_each_texture(Func func) const
+{
+	int unit = 0;
+	for (size_t i = 0; i < _diffuse_textures.size(); ++i)
+		func("material.diffuse", i, _diffuse_textures[i], unit++);
+	for (size_t i = 0; i < _specular_textures.size(); ++i)
+		func("material.specular", i, _specular_textures[i], unit++);
+	for (size_t i = 0; i < _normal_textures.size(); ++i)
+		func("material.normal", i, _normal_textures[i], unit++);
+	for (size_t i = 0; i < _height_textures.size(); ++i)
+		func("material.height", i, _height_textures[i], unit++);
+}
+
 void Material::active(const Matrix4& model) const
 {
+	apply_render_state();
+
+	ShaderProgram* shader = get_variant_shader();
+	shader->bind();
+	Renderer::get_singleton().bind_shader_data(*shader);
+	for_each_texture([](const char*, size_t, const Texture* texture, int unit) { texture->active((unsigned char)unit); });
+	bind_samplers(*shader);
+
+	shader->set_matrix4("model", model);
+
+}
+
+void Material::apply_render_state() const
+{
+	apply_render_state(get_render_state(Renderer::get_singleton().is_depth_prepassed()));
+}
+
+RenderState Material::get_render_state(bool depth_prepassed) const
+{
+	RenderState state = 0;
 	if (_enable_depth_test)
+	{
+		// the depth pre-pass wrote the final depth already, only the visible fragments pass
+		state |= DEPTH_TEST_BIT;
+		if (_update_depth_value && !depth_prepassed)
+			state |= DEPTH_WRITE_BIT;
+		state |= (RenderState)(depth_prepassed ? DepthTestFunc::LEQUAL : _depth_test_func) << DEPTH_FUNC_SHIFT;
+	}
+	state |= (RenderState)_cull_face_type << CULL_FACE_SHIFT;
+	if (_clockwise_winding_order)
+		state |= CLOCKWISE_BIT;
+	if (_translucence && _enable_alpha_blend)
+	{
+		state |= BLEND_BIT;
+		state |= (RenderState)_blend_src_factor << BLEND_SRC_SHIFT;
+		state |= (RenderState)_blend_dst_factor << BLEND_DST_SHIFT;
+	}
+	return state;
+}
+
+void Material::apply_render_state(RenderState state)
+{
+	if (state & DEPTH_TEST_BIT)
 	{
 		CHECK_GL_ERROR(glEnable(GL_DEPTH_TEST));
-		CHECK_GL_ERROR(glDepthMask(_update_depth_value ? GL_TRUE : GL_FALSE));
-		switch (_depth_test_func)
-		{
-		case DepthTestFunc::ALWAYS:   CHECK_GL_ERROR(glDepthFunc(GL_ALWAYS)); break;
-		case DepthTestFunc::NEVER:    CHECK_GL_ERROR(glDepthFunc(GL_NEVER)); break;
-		case DepthTestFunc::LESS:     CHECK_GL_ERROR(glDepthFunc(GL_LESS)); break;
-		case DepthTestFunc::EQUAL:    CHECK_GL_ERROR(glDepthFunc(GL_EQUAL)); break;
-		case DepthTestFunc::LEQUAL:   CHECK_GL_ERROR(glDepthFunc(GL_LEQUAL)); break;
-		case DepthTestFunc::GREATER:  CHECK_GL_ERROR(glDepthFunc(GL_GREATER)); break;
-		case DepthTestFunc::NOTEQUAL: CHECK_GL_ERROR(glDepthFunc(GL_NOTEQUAL)); break;
-		case DepthTestFunc::GEQUAL:   CHECK_GL_ERROR(glDepthFunc(GL_GEQUAL)); break;
-		default: break;
-		}		
+		CHECK_GL_ERROR(glDepthMask(state & DEPTH_WRITE_BIT ? GL_TRUE : GL_FALSE));
+		CHECK_GL_ERROR(glDepthFunc(DEPTH_FUNCS[(state >> DEPTH_FUNC_SHIFT) & 0x7]));
 	}
 	else
 	{
 		CHECK_GL_ERROR(glDisable(GL_DEPTH_TEST));
 	}
 
-	if (_cull_face_type != CullFaceType::NONE)
+	const CullFaceType cull_face_type = (CullFaceType)((state >> CULL_FACE_SHIFT) & 0x3);
+	if (cull_face_type != CullFaceType::NONE)
 	{
 		CHECK_GL_ERROR(glEnable(GL_CULL_FACE));
-		switch (_cull_face_type)
+		switch (cull_face_type)
 		{
 		default:
 		case CullFaceType::BACK: CHECK_GL_ERROR(glCullFace(GL_BACK)); break;
@@ -67,30 +133,65 @@ void Material::active(const Matrix4& model) const
 		CHECK_GL_ERROR(glDisable(GL_CULL_FACE));
 	}
 
-	CHECK_GL_ERROR(glFrontFace(_clockwise_winding_order ? GL_CW : GL_CCW));
+	CHECK_GL_ERROR(glFrontFace(state & CLOCKWISE_BIT ? GL_CW : GL_CCW));
 
-	if (_translucence && _enable_alpha_blend)
+	if (state & BLEND_BIT)
 	{
 		CHECK_GL_ERROR(glEnable(GL_BLEND));
-		const auto src = convert_blend_factor(_blend_src_factor);
-		const auto dst = convert_blend_factor(_blend_dst_factor);
+		const auto src = convert_blend_factor((AlphaBlendFactor)((state >> BLEND_SRC_SHIFT) & 0xf));
+		const auto dst = convert_blend_factor((AlphaBlendFactor)((state >> BLEND_DST_SHIFT) & 0xf));
 		CHECK_GL_ERROR(glBlendFunc(src, dst));
 	}
 	else
 	{
 		CHECK_GL_ERROR(glDisable(GL_BLEND));
 	}
+}
 
-	_shader->bind();
-	Renderer::get_singleton().bind_shader_data(*_shader);
-	int n = 0;
-	bind_textures(_diffuse_textures, "material.diffuse", n);
-	bind_textures(_specular_textures, "material.specular", n);
-	bind_textures(_normal_textures, "material.normal", n);
-	bind_textures(_height_textures, "material.height", n);
+ShaderVariant Material::get_shader_variant() const
+{
+	const Renderer& renderer = Renderer::get_singleton();
+	ShaderVariant variant;
+	variant.with_textures((unsigned int)_diffuse_textures.size(), (unsigned int)_specular_textures.size());
+	if (renderer.is_gbuffer_pass())
+		variant.with(ShaderFeature::GBuffer);
+	else if (renderer.uses_light_grid())
+		variant.with(ShaderFeature::ClusteredLights);
+	else
+		variant.with_lights((unsigned int)renderer.get_frame_snapshot().omni_lights.size(), (unsigned int)renderer.get_frame_snapshot().spot_lights.size());
+	if (!_normal_textures.empty())
+		variant.with(ShaderFeature::NormalMap);
+	if (_alpha_test)
+		variant.with(ShaderFeature::AlphaTest);
+	return variant;
+}
 
-	_shader->set_matrix4("model", model);
+bool Material::supports_deferred() const
+{
+	return !_translucence && ShaderManager::get_singleton().has_variants(_shader);
+}
 
+bool Material::supports_depth_prepass() const
+{
+	return !_translucence && !_alpha_test && _enable_depth_test && _update_depth_value &&
+		(_depth_test_func == DepthTestFunc::LESS || _depth_test_func == DepthTestFunc::LEQUAL);
+}
+
+ShaderProgram* Material::get_variant_shader() const
+{
+	const ShaderVariant variant = get_shader_variant();
+	ShaderManager& shader_mgr = ShaderManager::get_singleton();
+	// a reload may have fixed the variant this material fell back from
+	if (!_variant_shader || _variant_key != variant.get_key() || _variant_generation != shader_mgr.get_reload_generation())
+	{
+		_variant_shader = shader_mgr.get_variant(_shader, variant);
+		_variant_key = variant.get_key();
+		_variant_generation = shader_mgr.get_reload_generation();
+		// first use of the variant, waits for its link if the driver is still busy with it
+		if (!_variant_shader->valid())
+			_variant_shader = _shader;
+	}
+	return _variant_shader;
 }
 
 void Material::deactive() const
@@ -99,12 +200,26 @@ void Material::deactive() const
 	CHECK_GL_ERROR(glUseProgram(0));
 }
 
-void Material::bind_textures(const std::vector<Texture*>& textures, const std::string& prefix, int& n) const
+uint32_t Material::get_texture_layout() const
+{
+	return (uint32_t)_diffuse_textures.size() | (uint32_t)_specular_textures.size() << 8 |
+		(uint32_t)_normal_textures.size() << 16 | (uint32_t)_height_textures.size() << 24;
+}
+
+void Material::bind_samplers(const ShaderProgram& shader) const
 {
-	for (size_t i = 0; i < textures.size(); ++i)
+	for_each_texture([&shader](const char* prefix, size_t i, const Texture*, int unit)
 	{
-		textures[i]->active(n);
-		_shader->set_int(prefix + "_textures[" + std::to_string(i) + "]", n++);
-	}
-	_shader->set_int(prefix + "_count", textures.size());
+		char name[64];
+		snprintf(name, sizeof(name), "%s_textures[%zu]", prefix, i);
+		shader.set_int(name, unit);
+	});
+}
+
+void Material::record_textures(RenderCommandBuffer& buffer) const
+{
+	for_each_texture([&buffer](const char*, size_t, const Texture* texture, int unit)
+	{
+		buffer.bind_texture((unsigned int)unit, texture->get_id());
+	});
 }
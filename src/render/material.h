@@ -4,6 +4,8 @@
 #include <utility>
 #include <vector>
 #include "math/math.h"
+#include "shader_variant.h"
+#include "render_command_buffer.h"
 
 class Texture;
 class ShaderProgram;
@@ -112,6 +114,20 @@ public:
 	void set_alpha_blend_dst_factor(AlphaBlendFactor factor) { _blend_dst_factor = factor; }
 	AlphaBlendFactor get_alpha_blend_dst_factor() const { return _blend_dst_factor; }
 
+	// discards fragments below half diffuse alpha instead of blending them
+	void set_alpha_test(bool alpha_test) { _alpha_test = alpha_test; }
+	bool is_alpha_test() const { return _alpha_test; }
+	// the variant of the shader matching the textures of the material and the lights of the scene
+	ShaderVariant get_shader_variant() const;
+	// opaque with a shader that has variants, so it can be drawn into the G-buffer
+	bool supports_deferred() const;
+	// opaque and writing its depth with a less test, without alpha test which needs the textures
+	bool supports_depth_prepass() const;
+
+	// translucent materials never cast shadows
+	void set_cast_shadows(bool cast_shadows) { _cast_shadows = cast_shadows; }
+	bool casts_shadows() const { return _cast_shadows && !_translucence; }
+
 	void set_cull_face_type(CullFaceType type) { _cull_face_type = type; }
 	CullFaceType get_cull_face_type() const { return _cull_face_type; }
 	void set_clockwise_winding_order(bool clockwise) { _clockwise_winding_order = clockwise; }
@@ -119,6 +135,20 @@ public:
 
 	void active(const Matrix4& model) const;
 	void deactive() const;
+	// depth, cull and blend state of active without the program, for passes drawing with their own
+	void apply_render_state() const;
+	// the same state as a value, to record it on any thread and compare it between materials
+	RenderState get_render_state(bool depth_prepassed) const;
+	static void apply_render_state(RenderState state);
+
+	// may wait for the link of the variant, GL thread only
+	ShaderProgram* get_variant_shader() const;
+	// the variant found by the last get_variant_shader, for recording on other threads
+	ShaderProgram* get_resolved_shader() const { return _variant_shader; }
+	// texture counts of the material, the samplers of a program stay valid between equal layouts
+	uint32_t get_texture_layout() const;
+	void bind_samplers(const ShaderProgram& shader) const;
+	void record_textures(RenderCommandBuffer& buffer) const;
 
 private:
 	Material(std::string name, ShaderProgram* shader,
@@ -135,7 +165,9 @@ private:
 	{
 	}
 
-	void bind_textures(const std::vector<Texture*>& textures, const std::string& prefix, int& n) const;
+	// calls func(sampler prefix, index in the group, texture, unit) in the unit order
+	template<typename Func>
+	void for_each_texture(Func func) const;
 
 	std::string _name;
 	ShaderProgram* _shader;
@@ -144,8 +176,14 @@ private:
 	std::vector<Texture*> _normal_textures{ };
 	std::vector<Texture*> _height_textures{ };
 	float _specular_shininess{ 64.0f };
+	bool _alpha_test{ false };
+
+	mutable ShaderProgram* _variant_shader{ nullptr };
+	mutable uint64_t _variant_key{ 0 };
+	mutable unsigned int _variant_generation{ 0 };
 
 	bool _translucence{ false };
+	bool _cast_shadows{ true };
 	bool _enable_depth_test{ true };
 	bool _update_depth_value{ true };
 	DepthTestFunc _depth_test_func{ DepthTestFunc::LESS };
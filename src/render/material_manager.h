@@ -6,6 +6,7 @@
 #include "common/singleton.h"
 #include "material.h"
 #include <map>
+#include <mutex>
 #include <iostream>
 
 class MaterialManager : public Singleton<MaterialManager>
@@ -30,18 +31,21 @@ public:
 		assert(!get_material(name));
 
 		Material* material = new Material(name, shader, diffuse_textures, specular_textures, normal_textures, height_textures);
+		std::lock_guard<std::mutex> lock(_mutex);
 		_materials[name] = material;
 		return material;
 	}
 
 	Material* get_material(const std::string& name) const
 	{
+		std::lock_guard<std::mutex> lock(_mutex);
 		const auto iter = _materials.find(name);
 		return iter != _materials.end() ? iter->second : nullptr;
 	}
 	
 	void cleanup()
 	{
+		std::lock_guard<std::mutex> lock(_mutex);
 		for (auto& pair : _materials)
 		{
 			delete pair.second;
@@ -51,4 +55,5 @@ public:
 
 private:
 	std::map<std::string, Material*> _materials{ };
+	mutable std::mutex _mutex{ };
 };
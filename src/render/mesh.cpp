@@ -1,5 +1,8 @@
 ﻿#include "mesh.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 #include <utility>
 #include "renderer.h"
 #include "glad/glad.h"
@@ -8,33 +11,70 @@
 #include "material.h"
 #include "graphic_api.h"
 
-Mesh::Mesh(VertexFormat vertex_format, const void* vertices_data, size_t vertices_count, std::vector<unsigned int> indices, Material* material)
+Mesh::Mesh(VertexFormat vertex_format, const void* vertices_data, size_t vertices_count, std::vector<unsigned int> indices, Material* material,
+	LodChain lods, MeshClusters clusters)
 	: _vertex_format(std::move(vertex_format))
 	, _vertices_count(vertices_count)
 	, _indices(std::move(indices))
+	, _lods(std::move(lods))
+	, _clusters(std::move(clusters))
 	, _material(material)
 {
+	if (_lods.empty())
+	{
+		_lods.push_back({ 0, (unsigned int)_indices.size(), 0.0f });
+	}
+	compute_bounds(_vertex_format, vertices_data, _vertices_count, _bound_center, _bound_radius);
 	setup(vertices_data);
 }
 
+Mesh::Mesh(Data data, Material* material)
+	: _vertex_format(std::move(data.vertex_format))
+	, _vertices_count(data.vertices_count)
+	, _indices(std::move(data.indices))
+	, _lods(std::move(data.lods))
+	, _clusters(std::move(data.clusters))
+	, _bound_center(data.bound_center)
+	, _bound_radius(data.bound_radius)
+	, _material(material)
+{
+	if (_lods.empty())
+	{
+		_lods.push_back({ 0, (unsigned int)_indices.size(), 0.0f });
+	}
+	setup(data.vertices.data());
+}
+
 Mesh::~Mesh()
 {
 	CHECK_GL_ERROR(glDeleteVertexArrays(1, &_vao));
 	CHECK_GL_ERROR(glDeleteBuffers(1, &_vbo));
+	if (_position_vao)
+	{
+		CHECK_GL_ERROR(glDeleteVertexArrays(1, &_position_vao));
+		CHECK_GL_ERROR(glDeleteBuffers(1, &_position_vbo));
+	}
 	if (!_indices.empty())
 	{
 		CHECK_GL_ERROR(glDeleteBuffers(1, &_ebo));
 	}
 }
 
-void Mesh::draw(const Matrix4& model) const
+void Mesh::draw(const Matrix4& model, unsigned int lod) const
 {
-	_material->active(model);
+	draw(*_material, model, lod);
+}
+
+void Mesh::draw(const Material& material, const Matrix4& model, unsigned int lod) const
+{
+	assert(lod < _lods.size());
+	material.active(model);
 	
 	CHECK_GL_ERROR(glBindVertexArray(_vao));
 	if (!_indices.empty())
 	{
-		CHECK_GL_ERROR(glDrawElements(GL_TRIANGLES, _indices.size(), GL_UNSIGNED_INT, 0));
+		const Lod& range = _lods[lod];
+		CHECK_GL_ERROR(glDrawElements(GL_TRIANGLES, range.index_count, GL_UNSIGNED_INT, (void*)(range.index_offset * sizeof(unsigned int))));
 	}
 	else
 	{
@@ -42,24 +82,66 @@ void Mesh::draw(const Matrix4& model) const
 	}
 	CHECK_GL_ERROR(glBindVertexArray(0));
 
+	material.deactive();
+}
+
+void Mesh::draw_ranges(const Matrix4& model, const int* counts, const void* const* offsets, unsigned int range_count) const
+{
+	assert(!_indices.empty());
+	_material->active(model);
+
+	CHECK_GL_ERROR(glBindVertexArray(_vao));
+	CHECK_GL_ERROR(glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, range_count));
+	CHECK_GL_ERROR(glBindVertexArray(0));
+
 	_material->deactive();
 }
 
+void Mesh::record_draw(RenderCommandBuffer& buffer, const Matrix4& model, unsigned int lod) const
+{
+	assert(lod < _lods.size());
+	if (!_indices.empty())
+		buffer.draw(&model, _vao, _lods[lod].index_offset, _lods[lod].index_count, true);
+	else
+		buffer.draw(&model, _vao, 0, _vertices_count, false);
+}
+
+void Mesh::record_draw_ranges(RenderCommandBuffer& buffer, const Matrix4& model, const int* counts, const void* const* offsets, unsigned int range_count) const
+{
+	assert(!_indices.empty());
+	buffer.draw_ranges(&model, _vao, counts, offsets, range_count);
+}
+
+void Mesh::draw_positions(unsigned int lod) const
+{
+	assert(lod < _lods.size() && _position_vao);
+	CHECK_GL_ERROR(glBindVertexArray(_position_vao));
+	if (!_indices.empty())
+	{
+		const Lod& range = _lods[lod];
+		CHECK_GL_ERROR(glDrawElements(GL_TRIANGLES, range.index_count, GL_UNSIGNED_INT, (void*)(range.index_offset * sizeof(unsigned int))));
+	}
+	else
+	{
+		CHECK_GL_ERROR(glDrawArrays(GL_TRIANGLES, 0, _vertices_count));
+	}
+	CHECK_GL_ERROR(glBindVertexArray(0));
+}
+
+void Mesh::draw_position_ranges(const int* counts, const void* const* offsets, unsigned int range_count) const
+{
+	assert(!_indices.empty() && _position_vao);
+	CHECK_GL_ERROR(glBindVertexArray(_position_vao));
+	CHECK_GL_ERROR(glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, range_count));
+	CHECK_GL_ERROR(glBindVertexArray(0));
+}
+
 void Mesh::setup(const void* vertices_data)
 {
 	assert(_vertices_count >= 3);
 	assert(_indices.size() % 3 == 0);
 
-	unsigned int vertex_size = 0;
-	for (const auto& attr : _vertex_format)
-	{
-		switch (attr.element_type)
-		{
-		case VertexAttr::ElementType::Float: vertex_size += sizeof(float) * attr.element_count; break;
-		case VertexAttr::ElementType::Int:   vertex_size += sizeof(int) * attr.element_count; break;
-		default: assert(false);
-		}
-	}
+	const unsigned int vertex_size = get_vertex_size(_vertex_format);
 	CHECK_GL_ERROR(glGenVertexArrays(1, &_vao));
 	CHECK_GL_ERROR(glGenBuffers(1, &_vbo));
 
@@ -94,4 +176,79 @@ void Mesh::setup(const void* vertices_data)
 	}
 
 	CHECK_GL_ERROR(glBindVertexArray(0));
+
+	setup_position_stream(vertices_data);
 }
+
+void Mesh::setup_position_stream(const void* vertices_data)
+{
+	// the first attribute is the position by convention
+	if (_vertex_format.empty() || _vertex_format[0].element_type != VertexAttr::ElementType::Float || _vertex_format[0].element_count < 3)
+		return;
+
+	// depth only passes fetch 12 bytes a vertex instead of the whole interleaved vertex
+	const unsigned int vertex_size = get_vertex_size(_vertex_format);
+	const unsigned char* data = static_cast<const unsigned char*>(vertices_data);
+	std::vector<float> positions(_vertices_count * 3);
+	for (size_t i = 0; i < _vertices_count; ++i)
+	{
+		memcpy(&positions[i * 3], data + i * vertex_size, sizeof(float) * 3);
+	}
+
+	CHECK_GL_ERROR(glGenVertexArrays(1, &_position_vao));
+	CHECK_GL_ERROR(glGenBuffers(1, &_position_vbo));
+	CHECK_GL_ERROR(glBindVertexArray(_position_vao));
+	CHECK_GL_ERROR(glBindBuffer(GL_ARRAY_BUFFER, _position_vbo));
+	CHECK_GL_ERROR(glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW));
+	if (!_indices.empty())
+	{
+		CHECK_GL_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo));
+	}
+	CHECK_GL_ERROR(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0));
+	CHECK_GL_ERROR(glEnableVertexAttribArray(0));
+	CHECK_GL_ERROR(glBindVertexArray(0));
+}
+
+unsigned int Mesh::get_vertex_size(const VertexFormat& vertex_format)
+{
+	unsigned int vertex_size = 0;
+	for (const auto& attr : vertex_format)
+	{
+		switch (attr.element_type)
+		{
+		case VertexAttr::ElementType::Float: vertex_size += sizeof(float) * attr.element_count; break;
+		case VertexAttr::ElementType::Int:   vertex_size += sizeof(int) * attr.element_count; break;
+		default: assert(false);
+		}
+	}
+	return vertex_size;
+}
+
+void Mesh::compute_bounds(const VertexFormat& vertex_format, const void* vertices_data, size_t vertices_count, Vector3& center, float& radius)
+{
+	center = Vector3(0.0f);
+	radius = 0.0f;
+	// the first attribute is the position by convention
+	if (vertices_count == 0 || vertex_format.empty() || vertex_format[0].element_type != VertexAttr::ElementType::Float || vertex_format[0].element_count < 3)
+		return;
+
+	const unsigned int vertex_size = get_vertex_size(vertex_format);
+	const unsigned char* data = static_cast<const unsigned char*>(vertices_data);
+	Vector3 min_bound(FLT_MAX);
+	Vector3 max_bound(-FLT_MAX);
+	for (size_t i = 0; i < vertices_count; ++i)
+	{
+		const float* p = reinterpret_cast<const float*>(data + i * vertex_size);
+		min_bound = glm::min(min_bound, Vector3(p[0], p[1], p[2]));
+		max_bound = glm::max(max_bound, Vector3(p[0], p[1], p[2]));
+	}
+	center = (min_bound + max_bound) * 0.5f;
+
+	float radius_sqr = 0.0f;
+	for (size_t i = 0; i < vertices_count; ++i)
+	{
+		const float* p = reinterpret_cast<const float*>(data + i * vertex_size);
+		radius_sqr = std::max(radius_sqr, distance_sqr(center, Vector3(p[0], p[1], p[2])));
+	}
+	radius = sqrt(radius_sqr);
+}
\ No newline at end of file
@@ -2,10 +2,12 @@
 #include <vector>
 #include "math/math.h"
 #include <functional>
+#include "mesh_cluster.h"
 
 class ShaderProgram;
 class Texture;
 class Material;
+class RenderCommandBuffer;
 
 class Mesh
 {
@@ -22,8 +24,35 @@ public:
 		bool normalization;
 	};
 	typedef std::vector<VertexAttr> VertexFormat;
+
+	// A level of detail is a range of the index buffer, all levels share the same vertices
+	struct Lod
+	{
+		unsigned int index_offset;
+		unsigned int index_count;
+		float error;	// simplification error relative to the mesh extent
+	};
+	typedef std::vector<Lod> LodChain;
 	
-	Mesh(VertexFormat vertex_format, const void* vertices_data, size_t vertices_count, std::vector<unsigned int> indices, Material* material);
+	// Everything a mesh is made of except GL objects, so it can be prepared on worker threads
+	struct Data
+	{
+		VertexFormat vertex_format{ };
+		std::vector<unsigned char> vertices{ };
+		size_t vertices_count{ 0 };
+		std::vector<unsigned int> indices{ };
+		LodChain lods{ };
+		MeshClusters clusters{ };
+		Vector3 bound_center{ 0.0f, 0.0f, 0.0f };
+		float bound_radius{ 0.0f };
+	};
+
+	// indices holds the index ranges of all levels described by lods, an empty chain means a single level.
+	// clusters, when not empty, partition the index range of level 0.
+	Mesh(VertexFormat vertex_format, const void* vertices_data, size_t vertices_count, std::vector<unsigned int> indices, Material* material,
+		LodChain lods = LodChain(), MeshClusters clusters = MeshClusters());
+	// data must have its bounds computed already
+	Mesh(Data data, Material* material);
 
 	Mesh(const Mesh&) = delete;
 	Mesh(Mesh&&) = delete;
@@ -33,7 +62,32 @@ public:
 	
 	~Mesh();
 
-	void draw(const Matrix4& model) const;
+	void draw(const Matrix4& model, unsigned int lod = 0) const;
+	// with another material than its own, which the frame being prepared meanwhile may read
+	void draw(const Material& material, const Matrix4& model, unsigned int lod = 0) const;
+	// draws only the given index ranges, as produced by MeshClusters::cull
+	void draw_ranges(const Matrix4& model, const int* counts, const void* const* offsets, unsigned int range_count) const;
+	// the draw alone, the material is recorded by the renderer. The model and the ranges must outlive the replay.
+	void record_draw(RenderCommandBuffer& buffer, const Matrix4& model, unsigned int lod = 0) const;
+	void record_draw_ranges(RenderCommandBuffer& buffer, const Matrix4& model, const int* counts, const void* const* offsets, unsigned int range_count) const;
+
+	// draws the position stream alone with the bound program, which reads the position at location 0.
+	// Used by the depth pre-pass, neither the material state nor its program is applied.
+	bool has_position_stream() const { return _position_vao != 0; }
+	void draw_positions(unsigned int lod = 0) const;
+	void draw_position_ranges(const int* counts, const void* const* offsets, unsigned int range_count) const;
+
+	size_t get_lod_count() const { return _lods.size(); }
+	const Lod& get_lod(unsigned int lod) const { return _lods[lod]; }
+	size_t get_triangle_count(unsigned int lod = 0) const { return _indices.empty() ? _vertices_count / 3 : _lods[lod].index_count / 3; }
+
+	const MeshClusters& get_clusters() const { return _clusters; }
+
+	// bounding sphere in model space
+	const Vector3& get_bound_center() const { return _bound_center; }
+	float get_bound_radius() const { return _bound_radius; }
+	static void compute_bounds(const VertexFormat& vertex_format, const void* vertices_data, size_t vertices_count, Vector3& center, float& radius);
+	static unsigned int get_vertex_size(const VertexFormat& vertex_format);
 
 	Material* get_material() const { return _material; }
 	void set_material(Material* material) { assert(material); _material = material; }
@@ -46,13 +100,20 @@ public:
 
 private:
 	void setup(const void* vertices_data);
+	void setup_position_stream(const void* vertices_data);
 
 	unsigned int _vao{ 0 };
 	unsigned int _vbo{ 0 };
 	unsigned int _ebo{ 0 };
+	unsigned int _position_vao{ 0 };	// tightly packed positions sharing the index buffer
+	unsigned int _position_vbo{ 0 };
 	VertexFormat _vertex_format{ };
 	unsigned int _vertices_count{ 0 };
 	std::vector<unsigned int> _indices{ };
+	LodChain _lods{ };
+	MeshClusters _clusters{ };
+	Vector3 _bound_center{ 0.0f, 0.0f, 0.0f };
+	float _bound_radius{ 0.0f };
 	Material* _material{ nullptr };
 
 	DrawHandler* _pre_draw_handler{ nullptr };
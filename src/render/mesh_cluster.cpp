@@ -0,0 +1,290 @@
+﻿#include "mesh_cluster.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+	#define MESH_CLUSTER_SSE 1
+	#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	const unsigned int INVALID_INDEX = ~0u;
+
+	inline Vector3 read_position(const float* positions, size_t stride, unsigned int vertex)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex * stride);
+		return Vector3(p[0], p[1], p[2]);
+	}
+
+	inline void append_range(ClusterRanges& ranges, size_t first, unsigned int index_offset, unsigned int index_count)
+	{
+		const char* offset = reinterpret_cast<const char*>(size_t(index_offset) * sizeof(unsigned int));
+		if (ranges.size() > first)
+		{
+			// clusters are stored in index buffer order, so neighbours often merge into one range
+			int& last_count = ranges.counts.back();
+			if (static_cast<const char*>(ranges.offsets.back()) + last_count * sizeof(unsigned int) == offset)
+			{
+				last_count += index_count;
+				return;
+			}
+		}
+		ranges.counts.push_back(index_count);
+		ranges.offsets.push_back(offset);
+	}
+}
+
+void MeshClusters::build(const float* positions, size_t stride, std::vector<unsigned int>& indices, unsigned int index_offset, unsigned int index_count)
+{
+	assert(index_count % 3 == 0 && index_offset + index_count <= indices.size());
+	*this = MeshClusters();
+
+	const unsigned int* triangles = &indices[index_offset];
+	const size_t triangles_count = index_count / 3;
+	if (triangles_count == 0)
+		return;
+
+	// vertex -> triangle adjacency
+	const unsigned int vertices_count = *std::max_element(triangles, triangles + index_count) + 1;
+	std::vector<unsigned int> adjacency_offsets(vertices_count + 1, 0);
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		++adjacency_offsets[triangles[i] + 1];
+	}
+	for (size_t i = 0; i < vertices_count; ++i)
+	{
+		adjacency_offsets[i + 1] += adjacency_offsets[i];
+	}
+	std::vector<unsigned int> adjacency(index_count);
+	{
+		std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			adjacency[fill[triangles[i]]++] = (unsigned int)(i / 3);
+		}
+	}
+
+	std::vector<unsigned char> used(triangles_count, 0);
+	std::vector<unsigned int> vertex_cluster(vertices_count, INVALID_INDEX);
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> reordered;
+	reordered.reserve(index_count);
+
+	size_t seed = 0;
+	for (unsigned int cluster = 0; ; ++cluster)
+	{
+		while (seed < triangles_count && used[seed])
+			++seed;
+		if (seed == triangles_count)
+			break;
+
+		// grow the cluster through shared vertices, preferring triangles adding the fewest new vertices
+		const size_t begin = reordered.size();
+		size_t cluster_vertices = 0;
+		size_t cluster_triangles = 0;
+		candidates.clear();
+		unsigned int triangle = (unsigned int)seed;
+		for (;;)
+		{
+			used[triangle] = 1;
+			++cluster_triangles;
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const unsigned int vertex = triangles[triangle * 3 + k];
+				reordered.push_back(vertex);
+				if (vertex_cluster[vertex] == cluster)
+					continue;
+				vertex_cluster[vertex] = cluster;
+				++cluster_vertices;
+				for (unsigned int a = adjacency_offsets[vertex]; a < adjacency_offsets[vertex + 1]; ++a)
+				{
+					if (!used[adjacency[a]])
+						candidates.push_back(adjacency[a]);
+				}
+			}
+			if (cluster_triangles == MAX_TRIANGLES)
+				break;
+
+			unsigned int best = INVALID_INDEX;
+			size_t best_new_vertices = 4;
+			for (size_t i = 0; i < candidates.size();)
+			{
+				const unsigned int candidate = candidates[i];
+				if (used[candidate])
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				size_t new_vertices = 0;
+				for (size_t k = 0; k < 3; ++k)
+				{
+					new_vertices += vertex_cluster[triangles[candidate * 3 + k]] != cluster ? 1 : 0;
+				}
+				if (new_vertices < best_new_vertices)
+				{
+					best = candidate;
+					best_new_vertices = new_vertices;
+				}
+				++i;
+			}
+			if (best == INVALID_INDEX || cluster_vertices + best_new_vertices > MAX_VERTICES)
+				break;
+			triangle = best;
+		}
+
+		// bounding sphere
+		Vector3 min_bound(FLT_MAX);
+		Vector3 max_bound(-FLT_MAX);
+		for (size_t i = begin; i < reordered.size(); ++i)
+		{
+			const Vector3 p = read_position(positions, stride, reordered[i]);
+			min_bound = glm::min(min_bound, p);
+			max_bound = glm::max(max_bound, p);
+		}
+		const Vector3 center = (min_bound + max_bound) * 0.5f;
+		float radius_sqr = 0.0f;
+		for (size_t i = begin; i < reordered.size(); ++i)
+		{
+			radius_sqr = std::max(radius_sqr, distance_sqr(center, read_position(positions, stride, reordered[i])));
+		}
+
+		// normal cone, counter clockwise triangles face their normal
+		std::vector<Vector3> normals;
+		normals.reserve(cluster_triangles);
+		Vector3 axis(0.0f);
+		for (size_t i = begin; i < reordered.size(); i += 3)
+		{
+			const Vector3 p0 = read_position(positions, stride, reordered[i]);
+			const Vector3 normal = glm::cross(read_position(positions, stride, reordered[i + 1]) - p0, read_position(positions, stride, reordered[i + 2]) - p0);
+			const float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+		float cutoff = 1.0f;	// never culled
+		const float axis_length = glm::length(axis);
+		if (axis_length > 0.0f)
+		{
+			axis /= axis_length;
+			float min_dot = 1.0f;
+			for (const auto& normal : normals)
+			{
+				min_dot = std::min(min_dot, glm::dot(axis, normal));
+			}
+			// cones wider than ~84 degrees are rarely entirely back facing
+			if (min_dot > 0.1f)
+				cutoff = sqrt(1.0f - min_dot * min_dot);
+		}
+
+		_center_x.push_back(center.x);
+		_center_y.push_back(center.y);
+		_center_z.push_back(center.z);
+		_radius.push_back(sqrt(radius_sqr));
+		_axis_x.push_back(axis.x);
+		_axis_y.push_back(axis.y);
+		_axis_z.push_back(axis.z);
+		_cutoff.push_back(cutoff);
+		_index_offsets.push_back(index_offset + (unsigned int)begin);
+		_index_counts.push_back((unsigned int)(reordered.size() - begin));
+	}
+
+	std::copy(reordered.begin(), reordered.end(), indices.begin() + index_offset);
+
+	const size_t padded = (size() + 3) & ~size_t(3);
+	for (auto* values : { &_center_x, &_center_y, &_center_z, &_radius, &_axis_x, &_axis_y, &_axis_z, &_cutoff })
+	{
+		values->resize(padded, 0.0f);
+	}
+}
+
+size_t MeshClusters::cull(const Vector4 frustum_planes[6], const Vector3& view_position, bool cull_back_faces, ClusterRanges& ranges) const
+{
+	const size_t count = size();
+	const size_t first = ranges.size();
+	size_t triangles = 0;
+
+	for (size_t base = 0; base < count; base += 4)
+	{
+		unsigned int mask = 0;
+#ifdef MESH_CLUSTER_SSE
+		const __m128 cx = _mm_loadu_ps(&_center_x[base]);
+		const __m128 cy = _mm_loadu_ps(&_center_y[base]);
+		const __m128 cz = _mm_loadu_ps(&_center_z[base]);
+		const __m128 r = _mm_loadu_ps(&_radius[base]);
+		const __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), r);
+
+		__m128 visible = _mm_cmpeq_ps(r, r);
+		for (size_t p = 0; p < 6; ++p)
+		{
+			const Vector4& plane = frustum_planes[p];
+			__m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy));
+			d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(d, neg_r));
+		}
+		if (cull_back_faces)
+		{
+			const __m128 dx = _mm_sub_ps(cx, _mm_set1_ps(view_position.x));
+			const __m128 dy = _mm_sub_ps(cy, _mm_set1_ps(view_position.y));
+			const __m128 dz = _mm_sub_ps(cz, _mm_set1_ps(view_position.z));
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&_axis_x[base])), _mm_mul_ps(dy, _mm_loadu_ps(&_axis_y[base]))), _mm_mul_ps(dz, _mm_loadu_ps(&_axis_z[base])));
+			const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			const __m128 back = _mm_cmpge_ps(dot, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&_cutoff[base]), length), r));
+			visible = _mm_andnot_ps(back, visible);
+		}
+		mask = (unsigned int)_mm_movemask_ps(visible);
+#else
+		for (size_t i = 0; i < 4; ++i)
+		{
+			const size_t c = base + i;
+			const Vector3 center(_center_x[c], _center_y[c], _center_z[c]);
+			bool visible = true;
+			for (size_t p = 0; p < 6 && visible; ++p)
+			{
+				visible = glm::dot(Vector3(frustum_planes[p]), center) + frustum_planes[p].w >= -_radius[c];
+			}
+			if (visible && cull_back_faces)
+			{
+				const Vector3 d = center - view_position;
+				visible = glm::dot(d, Vector3(_axis_x[c], _axis_y[c], _axis_z[c])) < _cutoff[c] * glm::length(d) + _radius[c];
+			}
+			mask |= visible ? 1u << i : 0u;
+		}
+#endif
+		if (count - base < 4)
+			mask &= (1u << (count - base)) - 1;
+
+		for (size_t i = 0; mask; ++i, mask >>= 1)
+		{
+			if (mask & 1)
+			{
+				append_range(ranges, first, _index_offsets[base + i], _index_counts[base + i]);
+				triangles += _index_counts[base + i] / 3;
+			}
+		}
+	}
+	return triangles;
+}
+
+void MeshClusters::extract_frustum_planes(const Matrix4& clip, Vector4 planes[6])
+{
+	const Vector4 row0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+	const Vector4 row1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+	const Vector4 row2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+	const Vector4 row3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+	planes[0] = row3 + row0;	// left
+	planes[1] = row3 - row0;	// right
+	planes[2] = row3 + row1;	// bottom
+	planes[3] = row3 - row1;	// top
+	planes[4] = row3 + row2;	// near
+	planes[5] = row3 - row2;	// far
+	for (size_t i = 0; i < 6; ++i)
+	{
+		planes[i] = planes[i] / glm::length(Vector3(planes[i]));
+	}
+}
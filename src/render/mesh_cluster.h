@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <vector>
+#include "math/math.h"
+
+// Visible index ranges laid out for glMultiDrawElements
+struct ClusterRanges
+{
+	std::vector<int> counts{ };
+	std::vector<const void*> offsets{ };	// byte offsets into the index buffer
+
+	size_t size() const { return counts.size(); }
+	void clear()
+	{
+		counts.clear();
+		offsets.clear();
+	}
+};
+
+// Splits a triangle list into small clusters with a bounding sphere and a normal cone each,
+// so that off screen and back facing parts of a large mesh can be skipped every frame.
+class MeshClusters
+{
+public:
+	static const size_t MAX_VERTICES = 64;
+	static const size_t MAX_TRIANGLES = 124;
+
+	MeshClusters() = default;
+	~MeshClusters() = default;
+
+	// Reorders the triangles of indices[index_offset, index_offset + index_count) so that each
+	// cluster is a contiguous index range. positions: first float of each vertex position.
+	void build(const float* positions, size_t stride, std::vector<unsigned int>& indices, unsigned int index_offset, unsigned int index_count);
+
+	// Appends the visible index ranges to ranges, merging adjacent ones, and returns the number of
+	// visible triangles. frustum_planes and view_position are in model space.
+	size_t cull(const Vector4 frustum_planes[6], const Vector3& view_position, bool cull_back_faces, ClusterRanges& ranges) const;
+
+	size_t size() const { return _index_offsets.size(); }
+	bool empty() const { return _index_offsets.empty(); }
+
+	// Extracts normalized frustum planes from a clip matrix, in the space the matrix transforms from.
+	static void extract_frustum_planes(const Matrix4& clip, Vector4 planes[6]);
+
+private:
+	// structure of arrays, padded to a multiple of four for the SIMD loop
+	std::vector<float> _center_x{ };
+	std::vector<float> _center_y{ };
+	std::vector<float> _center_z{ };
+	std::vector<float> _radius{ };
+	std::vector<float> _axis_x{ };
+	std::vector<float> _axis_y{ };
+	std::vector<float> _axis_z{ };
+	std::vector<float> _cutoff{ };
+	std::vector<unsigned int> _index_offsets{ };
+	std::vector<unsigned int> _index_counts{ };
+};
@@ -0,0 +1,352 @@
+﻿#include "mesh_simplifier.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	const unsigned int INVALID_INDEX = ~0u;
+
+	struct Collapse
+	{
+		unsigned int from;		// canonical vertex removed by the collapse
+		unsigned int to;		// vertex (wedge) the removed one is replaced with
+		float cost;
+	};
+
+	struct PositionKey
+	{
+		uint32_t bits[3];
+
+		bool operator==(const PositionKey& rhs) const
+		{
+			return bits[0] == rhs.bits[0] && bits[1] == rhs.bits[1] && bits[2] == rhs.bits[2];
+		}
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+		}
+	};
+
+	inline uint64_t edge_key(unsigned int a, unsigned int b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+}
+
+MeshSimplifier::MeshSimplifier(const float* positions, size_t vertices_count, size_t stride)
+{
+	_positions.resize(vertices_count);
+	_position_remap.resize(vertices_count);
+
+	Vector3 min_bound(FLT_MAX);
+	Vector3 max_bound(-FLT_MAX);
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(positions);
+	for (size_t i = 0; i < vertices_count; ++i)
+	{
+		const float* p = reinterpret_cast<const float*>(data + i * stride);
+		_positions[i] = Vector3(p[0], p[1], p[2]);
+		min_bound = glm::min(min_bound, _positions[i]);
+		max_bound = glm::max(max_bound, _positions[i]);
+	}
+
+	std::unordered_map<PositionKey, unsigned int, PositionKeyHash> unique_positions;
+	unique_positions.reserve(vertices_count);
+	for (size_t i = 0; i < vertices_count; ++i)
+	{
+		PositionKey key;
+		memcpy(key.bits, &_positions[i][0], sizeof(key.bits));
+		_position_remap[i] = unique_positions.emplace(key, (unsigned int)i).first->second;
+	}
+
+	// errors are measured relative to the mesh extent so that one threshold fits every asset
+	const Vector3 size = max_bound - min_bound;
+	const float extent = std::max(std::max(size.x, size.y), size.z);
+	const float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+	for (auto& p : _positions)
+	{
+		p = (p - min_bound) * scale;
+	}
+}
+
+std::vector<unsigned int> MeshSimplifier::simplify(const std::vector<unsigned int>& indices, size_t target_index_count, float target_error, float* result_error) const
+{
+	assert(indices.size() % 3 == 0);
+	const size_t vertices_count = _positions.size();
+	const auto& remap = _position_remap;
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const unsigned int c0 = remap[indices[i]], c1 = remap[indices[i + 1]], c2 = remap[indices[i + 2]];
+		if (c0 != c1 && c1 != c2 && c2 != c0)
+		{
+			result.insert(result.end(), indices.begin() + i, indices.begin() + i + 3);
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertices_count, Quadric());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const unsigned int c0 = remap[result[i]], c1 = remap[result[i + 1]], c2 = remap[result[i + 2]];
+		const Vector3& p0 = _positions[c0];
+		Vector3 normal = glm::cross(_positions[c1] - p0, _positions[c2] - p0);
+		const float length = glm::length(normal);
+		if (length <= 0.0f)
+			continue;
+		normal /= length;
+		const float d = -glm::dot(normal, p0);
+		const float area = length * 0.5f;
+		add_plane(quadrics[c0], normal, d, area);
+		add_plane(quadrics[c1], normal, d, area);
+		add_plane(quadrics[c2], normal, d, area);
+	}
+
+	const float error_limit = target_error * target_error;
+	float max_error = 0.0f;
+
+	std::vector<unsigned int> adjacency_offsets;
+	std::vector<unsigned int> adjacency;
+	std::vector<unsigned int> wedges;
+	std::vector<unsigned char> locked;
+	std::vector<unsigned char> touched;
+	std::vector<uint64_t> edges;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> wedge_remap;
+
+	while (result.size() > target_index_count)
+	{
+		const size_t triangles_count = result.size() / 3;
+
+		// vertex -> triangle adjacency on canonical vertices
+		adjacency_offsets.assign(vertices_count + 1, 0);
+		for (auto index : result)
+		{
+			++adjacency_offsets[remap[index] + 1];
+		}
+		for (size_t i = 0; i < vertices_count; ++i)
+		{
+			adjacency_offsets[i + 1] += adjacency_offsets[i];
+		}
+		adjacency.resize(result.size());
+		{
+			std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i)
+			{
+				adjacency[fill[remap[result[i]]]++] = (unsigned int)(i / 3);
+			}
+		}
+
+		// vertices on open borders, non-manifold edges or attribute seams keep their place
+		locked.assign(vertices_count, 0);
+		wedges.assign(vertices_count, INVALID_INDEX);
+		edges.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const unsigned int a = remap[result[i + k]];
+				const unsigned int b = remap[result[i + (k + 1) % 3]];
+				edges.push_back(edge_key(a, b));
+
+				unsigned int& wedge = wedges[a];
+				if (wedge == INVALID_INDEX)
+					wedge = result[i + k];
+				else if (wedge != result[i + k])
+					locked[a] = 1;
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i])
+				++j;
+			if (j - i != 2)
+			{
+				locked[edges[i] >> 32] = 1;
+				locked[edges[i] & 0xffffffffu] = 1;
+			}
+			i = j;
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const unsigned int from = remap[result[i + k]];
+				if (locked[from])
+					continue;
+				for (size_t o = 1; o < 3; ++o)
+				{
+					const unsigned int to = result[i + (k + o) % 3];
+					Quadric q = quadrics[from];
+					add_quadric(q, quadrics[remap[to]]);
+					collapses.push_back({ from, to, evaluate(q, _positions[remap[to]]) });
+				}
+			}
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+		wedge_remap.resize(vertices_count);
+		for (size_t i = 0; i < vertices_count; ++i)
+		{
+			wedge_remap[i] = (unsigned int)i;
+		}
+		touched.assign(vertices_count, 0);	// one collapse per neighbourhood and pass keeps the flip checks valid
+
+		const size_t triangles_to_remove = std::max<size_t>((result.size() - target_index_count) / 3, 1);
+		size_t removed = 0;
+		for (const auto& collapse : collapses)
+		{
+			if (removed >= triangles_to_remove || collapse.cost > error_limit)
+				break;
+
+			const unsigned int u = collapse.from;
+			const unsigned int v = remap[collapse.to];
+			if (touched[u] || u == v)
+				continue;
+
+			// reject collapses flipping any of the remaining triangles around u
+			bool flipped = false;
+			size_t shared = 0;
+			for (unsigned int t = adjacency_offsets[u]; t < adjacency_offsets[u + 1] && !flipped; ++t)
+			{
+				const unsigned int* tri = &result[adjacency[t] * 3];
+				const unsigned int c[3] = { remap[tri[0]], remap[tri[1]], remap[tri[2]] };
+				if (c[0] == v || c[1] == v || c[2] == v)
+				{
+					++shared;
+					continue;
+				}
+				Vector3 p[3] = { _positions[c[0]], _positions[c[1]], _positions[c[2]] };
+				const Vector3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (size_t k = 0; k < 3; ++k)
+				{
+					if (c[k] == u)
+						p[k] = _positions[v];
+				}
+				const Vector3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				flipped = glm::dot(before, after) <= 0.0f;
+			}
+			if (flipped || shared == 0 || touched[v])
+				continue;
+
+			wedge_remap[wedges[u]] = collapse.to;
+			add_quadric(quadrics[v], quadrics[u]);
+			max_error = std::max(max_error, collapse.cost);
+			removed += shared;
+
+			for (unsigned int t = adjacency_offsets[u]; t < adjacency_offsets[u + 1]; ++t)
+			{
+				const unsigned int* tri = &result[adjacency[t] * 3];
+				touched[remap[tri[0]]] = 1;
+				touched[remap[tri[1]]] = 1;
+				touched[remap[tri[2]]] = 1;
+			}
+		}
+		if (removed == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t i = 0; i < triangles_count; ++i)
+		{
+			const unsigned int a = wedge_remap[result[i * 3 + 0]];
+			const unsigned int b = wedge_remap[result[i * 3 + 1]];
+			const unsigned int c = wedge_remap[result[i * 3 + 2]];
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	if (result_error)
+	{
+		*result_error = sqrt(max_error);
+	}
+	return result;
+}
+
+void MeshSimplifier::build_lod_chain(std::vector<unsigned int>& indices, Mesh::LodChain& lods, const Settings& settings) const
+{
+	lods.clear();
+	lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+	if (indices.size() / 3 < settings.min_triangles)
+		return;
+
+	// every level is simplified from the full resolution indices so errors do not accumulate
+	const std::vector<unsigned int> source(indices);
+	size_t previous_count = source.size();
+	for (unsigned int level = 1; level < settings.max_lods; ++level)
+	{
+		const size_t target = size_t(previous_count / 3 * settings.reduction) * 3;
+		if (target < 3)
+			break;
+
+		float error = 0.0f;
+		std::vector<unsigned int> lod = simplify(source, target, settings.max_error, &error);
+		if (lod.empty() || lod.size() * 10 > previous_count * 9)
+			break;
+
+		lods.push_back({ (unsigned int)indices.size(), (unsigned int)lod.size(), std::max(error, lods.back().error) });
+		indices.insert(indices.end(), lod.begin(), lod.end());
+		previous_count = lod.size();
+	}
+}
+
+void MeshSimplifier::add_plane(Quadric& q, const Vector3& n, float d, float weight)
+{
+	q.a2 += weight * n.x * n.x;
+	q.b2 += weight * n.y * n.y;
+	q.c2 += weight * n.z * n.z;
+	q.ab += weight * n.x * n.y;
+	q.ac += weight * n.x * n.z;
+	q.bc += weight * n.y * n.z;
+	q.ad += weight * n.x * d;
+	q.bd += weight * n.y * d;
+	q.cd += weight * n.z * d;
+	q.d2 += weight * d * d;
+	q.weight += weight;
+}
+
+void MeshSimplifier::add_quadric(Quadric& q, const Quadric& other)
+{
+	q.a2 += other.a2;
+	q.b2 += other.b2;
+	q.c2 += other.c2;
+	q.ab += other.ab;
+	q.ac += other.ac;
+	q.bc += other.bc;
+	q.ad += other.ad;
+	q.bd += other.bd;
+	q.cd += other.cd;
+	q.d2 += other.d2;
+	q.weight += other.weight;
+}
+
+float MeshSimplifier::evaluate(const Quadric& q, const Vector3& p)
+{
+	if (q.weight <= 0.0)
+		return 0.0f;
+	const double x = p.x, y = p.y, z = p.z;
+	const double error = x * x * q.a2 + y * y * q.b2 + z * z * q.c2
+		+ 2.0 * (x * y * q.ab + x * z * q.ac + y * z * q.bc)
+		+ 2.0 * (x * q.ad + y * q.bd + z * q.cd)
+		+ q.d2;
+	return (float)(fabs(error) / q.weight);
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <vector>
+#include "mesh.h"
+
+// Quadric error metric edge-collapse simplifier.
+// Collapses only move one existing vertex onto another, so every level of detail shares the
+// vertex buffer of the source mesh and only needs an index range of its own.
+class MeshSimplifier
+{
+public:
+	struct Settings
+	{
+		unsigned int max_lods = 4;			// including the full resolution level
+		float reduction = 0.5f;				// triangle ratio between two consecutive levels
+		float max_error = 0.05f;			// relative to the mesh extent
+		size_t min_triangles = 128;			// meshes smaller than this keep a single level
+	};
+
+	// positions: first float of each vertex position, stride: vertex size in bytes
+	MeshSimplifier(const float* positions, size_t vertices_count, size_t stride);
+
+	MeshSimplifier(const MeshSimplifier&) = delete;
+	MeshSimplifier(MeshSimplifier&&) = delete;
+	MeshSimplifier& operator=(const MeshSimplifier&) = delete;
+	MeshSimplifier& operator=(MeshSimplifier&&) = delete;
+
+	// Returns a simplified copy of indices with at most target_index_count indices, unless the
+	// relative error would exceed target_error first. The error reached is stored in result_error.
+	std::vector<unsigned int> simplify(const std::vector<unsigned int>& indices, size_t target_index_count, float target_error, float* result_error = nullptr) const;
+
+	// Appends every generated level to indices and describes all levels (including level 0) in lods.
+	void build_lod_chain(std::vector<unsigned int>& indices, Mesh::LodChain& lods, const Settings& settings) const;
+	void build_lod_chain(std::vector<unsigned int>& indices, Mesh::LodChain& lods) const { build_lod_chain(indices, lods, Settings()); }
+
+private:
+	struct Quadric
+	{
+		double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2, weight;
+	};
+
+	static void add_plane(Quadric& q, const Vector3& n, float d, float weight);
+	static void add_quadric(Quadric& q, const Quadric& other);
+	static float evaluate(const Quadric& q, const Vector3& p);
+
+	std::vector<Vector3> _positions{ };			// normalized to the unit cube
+	std::vector<unsigned int> _position_remap{ };	// first vertex sharing the same position
+};
@@ -1,133 +1,54 @@
 ﻿#include "model.h"
-#include "assimp/Importer.hpp"
-#include "assimp/postprocess.h"
-#include <iostream>
-#include "texture.h"
 #include <glm/ext/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale
 #include <glm/gtc/quaternion.hpp>
-#include "texture_manager.h"
-#include "shader_manager.h"
-#include "material_manager.h"
+#include "engine/engine.h"
+#include "engine/camera.h"
+#include "common/profiler.h"
 
 void Model::load_model(const std::string& path)
 {
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-	{
-		std::cout << "Assimp load model error: " << importer.GetErrorString() << std::endl;
+	PROFILE_ZONE("Model::load_model");
+	ModelImport import(path);
+	if (!import.import())
 		return;
-	}
-	_path = path;
-	process_node(scene->mRootNode, scene);
-}
-
-void Model::process_node(aiNode* node, const aiScene* scene)
-{
-	for (size_t i = 0; i < node->mNumMeshes; ++i)
+	import.convert();
+	while (!import.upload_step())
 	{
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		_meshes.push_back(process_mesh(mesh, scene));
 	}
-	for (size_t i = 0; i < node->mNumChildren; ++i)
-	{
-		process_node(node->mChildren[i], scene);
-	}
-}
+	_meshes = import.take_meshes();
+}
 
-Mesh* Model::process_mesh(aiMesh* mesh, const aiScene* scene) const
+bool Model::update_request(const Matrix4& model, FrameArray<Renderer::RenderInfo>& render_list)
 {
-	struct Vertex
+	switch (_request->get_stage())
 	{
-		Vector3 position{};
-		Vector3 normal{};
-		Vector2 uv{};
-		Vector3 tangent{};
-		Vector3 bitangent{};
-	};
-
-	static Mesh::VertexFormat vf{
-		{ 3, Mesh::VertexAttr::ElementType::Float, false },
-		{ 3, Mesh::VertexAttr::ElementType::Float, false },
-		{ 2, Mesh::VertexAttr::ElementType::Float, false },
-		{ 3, Mesh::VertexAttr::ElementType::Float, false },
-		{ 3, Mesh::VertexAttr::ElementType::Float, false }
-	};
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture*> textures;
-
-	for (size_t i = 0; i < mesh->mNumVertices; ++i)
+	case ModelLoader::Stage::Ready:
+		_meshes = _request->get_meshes();
+		_request.reset();
+		on_static_changed();
+		return true;
+	case ModelLoader::Stage::Failed:
+		_request.reset();
+		return false;
+	case ModelLoader::Stage::Converting:
+	case ModelLoader::Stage::Uploading:
 	{
-		Vertex vertex;
-		vertex.position = Vector3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-		if (mesh->HasNormals())
+		const Vector3 bound_min = _request->get_bound_min();
+		const Vector3 bound_max = _request->get_bound_max();
+		const Vector3 center = Vector3(model * Vector4((bound_min + bound_max) * 0.5f, 1.0f));
+		_request->request_priority(glm::distance(center, Engine::get_singleton().get_camera()->get_position()));
+		if (Mesh* proxy = ModelLoader::get_singleton().get_proxy_mesh())
 		{
-			vertex.normal = Vector3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+			const Matrix4 proxy_model = glm::scale(glm::translate(model, (bound_min + bound_max) * 0.5f), glm::max(bound_max - bound_min, Vector3(0.001f)));
+			render_list.push_back({ proxy, proxy_model, 0, 0, 0, center, glm::distance(center, Vector3(model * Vector4(bound_max, 1.0f))), false });
 		}
-		else
-		{
-			vertex.normal = Vector3(0.0f, 0.0f, 0.0f);
-		}
-		if (mesh->mTextureCoords[0])
-		{
-			vertex.uv = Vector2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
-			vertex.tangent = Vector3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
-			vertex.bitangent = Vector3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
-		}
-		else
-		{
-			vertex.uv = Vector2(0.0f, 0.0f);
-			vertex.tangent = Vector3(0.0f, 0.0f, 0.0f);
-			vertex.bitangent = Vector3(0.0f, 0.0f, 0.0f);
-		}
-		vertices.push_back(vertex);
+		return false;
 	}
-
-	for (size_t i = 0; i < mesh->mNumFaces; ++i)
-	{
-		const aiFace& face = mesh->mFaces[i];
-		for (size_t j = 0; j < face.mNumIndices; ++j)
-			indices.push_back(face.mIndices[j]);
+	default:
+		// bounds are not known before the import finished
+		_request->request_priority(glm::distance(Vector3(model[3]), Engine::get_singleton().get_camera()->get_position()));
+		return false;
 	}
-
-	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-	Material* mat = MaterialManager::get_singleton().get_material(material->GetName().C_Str());
-	if (!mat)
-	{
-		ShaderProgram* shader = ShaderManager::get_singleton().get_program("mesh");
-		assert(shader && shader->valid());
-
-		const std::vector<Texture*> diffuse_textures = load_material_textures(material, aiTextureType_DIFFUSE);
-		const std::vector<Texture*> specular_textures = load_material_textures(material, aiTextureType_SPECULAR);
-		const std::vector<Texture*> normal_textures = load_material_textures(material, aiTextureType_HEIGHT);
-		const std::vector<Texture*> height_textures = load_material_textures(material, aiTextureType_AMBIENT);
-
-		mat = MaterialManager::get_singleton().create_material(material->GetName().C_Str(), shader, diffuse_textures, specular_textures, normal_textures, height_textures);
-	}
-	return new Mesh(vf, vertices.data(), vertices.size(), indices, mat);
-}
-
-std::vector<Texture*> Model::load_material_textures(aiMaterial* material, aiTextureType type) const
-{
-	std::vector<Texture*> textures;
-	for (size_t i = 0; i < material->GetTextureCount(type); ++i)
-	{
-		aiString str;
-		if (material->GetTexture(type, i, &str) != aiReturn_SUCCESS)
-		{
-			std::cout << "Assimp load material textures type [" << type << "] error: " << material->GetName().C_Str() << std::endl;
-			continue;
-		}
-		const std::string path = _path.substr(0, _path.find_last_of('/')) + "/" + str.C_Str();
-		if (!TextureManager::get_singleton().has_texture(path))
-		{
-			if (auto tex = TextureManager::get_singleton().load_texture(path))
-				textures.push_back(tex);
-		}
-	}
-	return textures;
 }
 
 Matrix4 Model::get_model_matrix() const
@@ -137,4 +58,18 @@ Matrix4 Model::get_model_matrix() const
 	model = glm::scale(model, _scale);
 	model = glm::mat4_cast(q) * model;
 	return glm::translate(model, _position);
+}
+
+void Model::set_static(bool is_static)
+{
+	if (_static == is_static)
+		return;
+	_static = is_static;
+	Renderer::get_singleton().invalidate_static_shadows();
+}
+
+void Model::on_static_changed() const
+{
+	if (_static)
+		Renderer::get_singleton().invalidate_static_shadows();
 }
\ No newline at end of file
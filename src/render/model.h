@@ -1,19 +1,21 @@
 ﻿#pragma once
+#include <algorithm>
 #include "mesh.h"
 
-#include "assimp/scene.h"
 #include "renderer.h"
-
-struct aiMaterial;
-struct aiNode;
+#include "model_loader.h"
 
 class Model
 {
 	friend class Renderer;
 public:
-	Model(const std::string& path)
+	// streaming models return at once and draw a bounding box until the loader has finished them
+	Model(const std::string& path, bool streaming = false)
 	{
-		load_model(path);
+		if (streaming)
+			_request = ModelLoader::get_singleton().load(path);
+		else
+			load_model(path);
 	}
 
 	Model(std::vector<Mesh*> meshes)
@@ -23,34 +25,51 @@ public:
 
 	~Model() = default;
 
-	void draw(std::vector<Renderer::RenderInfo>& render_list)
+	void draw(FrameArray<Renderer::RenderInfo>& render_list)
 	{
 		const auto model = get_model_matrix();
-		for (auto* mesh : _meshes)
+		if (_request && !update_request(model, render_list))
+			return;
+
+		const Renderer& renderer = Renderer::get_singleton();
+		const float scale = std::max(std::max(glm::length(Vector3(model[0])), glm::length(Vector3(model[1]))), glm::length(Vector3(model[2])));
+		_mesh_lods.resize(_meshes.size(), 0);
+		for (size_t i = 0; i < _meshes.size(); ++i)
 		{
-			render_list.emplace_back(std::make_pair(mesh, model));
+			_mesh_lods[i] = renderer.select_lod(*_meshes[i], model, _mesh_lods[i]);
+			const Vector3 bound_center = Vector3(model * Vector4(_meshes[i]->get_bound_center(), 1.0f));
+			render_list.push_back({ _meshes[i], model, _mesh_lods[i], 0, 0, bound_center, _meshes[i]->get_bound_radius() * scale, _static });
 		}
 	}
 
+	const std::vector<Mesh*>& get_meshes() const { return _meshes; }
+	bool is_loading() const { return _request != nullptr; }
+
 	const Vector3& get_position() const { return _position; }
-	void set_position(const Vector3& position) { _position = position; }
+	void set_position(const Vector3& position) { _position = position; on_static_changed(); }
 	const Vector3& get_rotation() const { return _rotation; }
-	void set_rotation(const Vector3& rotation) { _rotation = rotation; }
+	void set_rotation(const Vector3& rotation) { _rotation = rotation; on_static_changed(); }
 	const Vector3& get_scale() const { return _scale; }
-	void set_scale(const Vector3& scale) { _scale = scale; }
+	void set_scale(const Vector3& scale) { _scale = scale; on_static_changed(); }
+
+	// static models rarely move, their shadows are cached until one of them does
+	void set_static(bool is_static);
+	bool is_static() const { return _static; }
 
 protected:
 	void load_model(const std::string& path);
-	void process_node(aiNode* node, const aiScene* scene);
-	Mesh* process_mesh(aiMesh* mesh, const aiScene* scene) const;
-	std::vector<Texture*> load_material_textures(aiMaterial* material, aiTextureType type) const;
+	// takes the meshes of a finished request or draws the proxy, returns true once the meshes can be drawn
+	bool update_request(const Matrix4& model, FrameArray<Renderer::RenderInfo>& render_list);
 	Matrix4 get_model_matrix() const;
+	void on_static_changed() const;
 	
 private:
 	std::vector<Mesh*> _meshes{ };
-	std::string _path{ "" };
+	std::vector<unsigned int> _mesh_lods{ };	// selected level of each mesh, kept for hysteresis
+	std::shared_ptr<ModelLoader::Request> _request{ };
 	
 	Vector3 _position{ 0.0f, 0.0f, 0.0f };
 	Vector3 _rotation{ 0.0f, 0.0f, 0.0f };
 	Vector3 _scale{ 1.0f, 1.0f, 1.0f };
+	bool _static{ false };
 };
@@ -0,0 +1,409 @@
+﻿#include "model_loader.h"
+#include "assimp/Importer.hpp"
+#include "assimp/postprocess.h"
+#include <chrono>
+#include <iostream>
+#include "texture_manager.h"
+#include "shader_manager.h"
+#include "material_manager.h"
+#include "mesh_simplifier.h"
+#include "asset_io_system.h"
+#include "common/job_system.h"
+#include "common/profiler.h"
+
+template<> ModelLoader* Singleton<ModelLoader>::singleton = nullptr;
+
+namespace
+{
+	const aiTextureType MATERIAL_TEXTURE_TYPES[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT };
+}
+
+ModelImport::ModelImport(const std::string& path)
+	: _path(path)
+{
+}
+
+ModelImport::~ModelImport() = default;
+
+bool ModelImport::import()
+{
+	PROFILE_ZONE("ModelImport::import");
+	_importer.reset(new Assimp::Importer());
+	_importer->SetIOHandler(new AssetIOSystem());
+	_scene = _importer->ReadFile(_path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	if (!_scene || _scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !_scene->mRootNode)
+	{
+		std::cout << "Assimp load model error: " << _importer->GetErrorString() << std::endl;
+		_importer.reset();
+		_scene = nullptr;
+		return false;
+	}
+	process_node(_scene->mRootNode);
+
+	Vector3 min_bound(FLT_MAX);
+	Vector3 max_bound(-FLT_MAX);
+	for (const auto* mesh : _scene_meshes)
+	{
+		for (size_t i = 0; i < mesh->mNumVertices; ++i)
+		{
+			const Vector3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+			min_bound = glm::min(min_bound, position);
+			max_bound = glm::max(max_bound, position);
+		}
+	}
+	if (min_bound.x <= max_bound.x)
+	{
+		_bound_min = min_bound;
+		_bound_max = max_bound;
+	}
+
+	// textures of materials which do not exist yet are decoded together with the meshes
+	for (const auto* mesh : _scene_meshes)
+	{
+		const aiMaterial& material = *_scene->mMaterials[mesh->mMaterialIndex];
+		if (MaterialManager::get_singleton().get_material(material.GetName().C_Str()))
+			continue;
+		for (auto type : MATERIAL_TEXTURE_TYPES)
+		{
+			for (const auto& texture_path : get_texture_paths(material, type))
+			{
+				if (!TextureManager::get_singleton().has_texture(texture_path) &&
+					std::find(_texture_paths.begin(), _texture_paths.end(), texture_path) == _texture_paths.end())
+				{
+					_texture_paths.push_back(texture_path);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void ModelImport::convert()
+{
+	PROFILE_ZONE("ModelImport::convert");
+	// textures come first since they are the longest jobs
+	_images.resize(_texture_paths.size());
+	_mesh_data.resize(_scene_meshes.size());
+	JobSystem::get_singleton().parallel_for(_images.size() + _mesh_data.size(), [this](size_t i)
+	{
+		if (i < _images.size())
+			Texture::decode(_texture_paths[i], _images[i]);
+		else
+			process_mesh(*_scene_meshes[i - _images.size()], _mesh_data[i - _images.size()]);
+	});
+}
+
+bool ModelImport::upload_step()
+{
+	PROFILE_ZONE("ModelImport::upload_step");
+	if (_uploaded_textures < _images.size())
+	{
+		TextureImage& image = _images[_uploaded_textures];
+		const std::string& path = _texture_paths[_uploaded_textures];
+		// another model may have loaded the same texture in the meantime
+		if (image.pixels && !TextureManager::get_singleton().has_texture(path))
+			TextureManager::get_singleton().add_texture(path, image);
+		image = TextureImage();
+		++_uploaded_textures;
+		return false;
+	}
+
+	const size_t index = _meshes.size();
+	if (index < _mesh_data.size())
+	{
+		Material* material = get_material(*_scene->mMaterials[_scene_meshes[index]->mMaterialIndex]);
+		_meshes.push_back(new Mesh(std::move(_mesh_data[index]), material));
+	}
+	if (_meshes.size() < _mesh_data.size())
+		return false;
+
+	// the scene is not needed anymore once every mesh exists
+	_mesh_data.clear();
+	_scene_meshes.clear();
+	_scene = nullptr;
+	_importer.reset();
+	return true;
+}
+
+void ModelImport::process_node(const aiNode* node)
+{
+	for (size_t i = 0; i < node->mNumMeshes; ++i)
+	{
+		_scene_meshes.push_back(_scene->mMeshes[node->mMeshes[i]]);
+	}
+	for (size_t i = 0; i < node->mNumChildren; ++i)
+	{
+		process_node(node->mChildren[i]);
+	}
+}
+
+void ModelImport::process_mesh(const aiMesh& mesh, Mesh::Data& data)
+{
+	PROFILE_ZONE("ModelImport::process_mesh");
+	struct Vertex
+	{
+		Vector3 position{};
+		Vector3 normal{};
+		Vector2 uv{};
+		Vector3 tangent{};
+		Vector3 bitangent{};
+	};
+
+	data.vertex_format = {
+		{ 3, Mesh::VertexAttr::ElementType::Float, false },
+		{ 3, Mesh::VertexAttr::ElementType::Float, false },
+		{ 2, Mesh::VertexAttr::ElementType::Float, false },
+		{ 3, Mesh::VertexAttr::ElementType::Float, false },
+		{ 3, Mesh::VertexAttr::ElementType::Float, false }
+	};
+	data.vertices_count = mesh.mNumVertices;
+	data.vertices.resize(mesh.mNumVertices * sizeof(Vertex));
+	Vertex* vertices = reinterpret_cast<Vertex*>(data.vertices.data());
+
+	const bool has_uv = mesh.mTextureCoords[0] != nullptr;
+	const bool has_tangents = has_uv && mesh.HasTangentsAndBitangents();
+	for (size_t i = 0; i < mesh.mNumVertices; ++i)
+	{
+		Vertex& vertex = vertices[i];
+		vertex.position = Vector3(mesh.mVertices[i].x, mesh.mVertices[i].y, mesh.mVertices[i].z);
+		if (mesh.HasNormals())
+		{
+			vertex.normal = Vector3(mesh.mNormals[i].x, mesh.mNormals[i].y, mesh.mNormals[i].z);
+		}
+		else
+		{
+			vertex.normal = Vector3(0.0f, 0.0f, 0.0f);
+		}
+		if (has_uv)
+		{
+			vertex.uv = Vector2(mesh.mTextureCoords[0][i].x, mesh.mTextureCoords[0][i].y);
+		}
+		else
+		{
+			vertex.uv = Vector2(0.0f, 0.0f);
+		}
+		if (has_tangents)
+		{
+			vertex.tangent = Vector3(mesh.mTangents[i].x, mesh.mTangents[i].y, mesh.mTangents[i].z);
+			vertex.bitangent = Vector3(mesh.mBitangents[i].x, mesh.mBitangents[i].y, mesh.mBitangents[i].z);
+		}
+		else
+		{
+			vertex.tangent = Vector3(0.0f, 0.0f, 0.0f);
+			vertex.bitangent = Vector3(0.0f, 0.0f, 0.0f);
+		}
+	}
+
+	auto& indices = data.indices;
+	indices.reserve(mesh.mNumFaces * 3);
+	for (size_t i = 0; i < mesh.mNumFaces; ++i)
+	{
+		const aiFace& face = mesh.mFaces[i];
+		indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+	}
+
+	Mesh::compute_bounds(data.vertex_format, vertices, data.vertices_count, data.bound_center, data.bound_radius);
+
+	const MeshSimplifier simplifier(&vertices[0].position.x, data.vertices_count, sizeof(Vertex));
+	simplifier.build_lod_chain(indices, data.lods);
+
+	// large meshes are split into clusters so the renderer can skip their invisible parts
+	const Mesh::Lod& lod = data.lods[0];
+	if (lod.index_count / 3 >= MeshClusters::MAX_TRIANGLES * 2)
+	{
+		data.clusters.build(&vertices[0].position.x, sizeof(Vertex), indices, lod.index_offset, lod.index_count);
+	}
+}
+
+Material* ModelImport::get_material(const aiMaterial& material) const
+{
+	Material* mat = MaterialManager::get_singleton().get_material(material.GetName().C_Str());
+	if (!mat)
+	{
+		ShaderProgram* shader = ShaderManager::get_singleton().get_program("mesh");
+		assert(shader);
+
+		const std::vector<Texture*> diffuse_textures = load_material_textures(material, aiTextureType_DIFFUSE);
+		const std::vector<Texture*> specular_textures = load_material_textures(material, aiTextureType_SPECULAR);
+		const std::vector<Texture*> normal_textures = load_material_textures(material, aiTextureType_HEIGHT);
+		const std::vector<Texture*> height_textures = load_material_textures(material, aiTextureType_AMBIENT);
+
+		mat = MaterialManager::get_singleton().create_material(material.GetName().C_Str(), shader, diffuse_textures, specular_textures, normal_textures, height_textures);
+	}
+	return mat;
+}
+
+std::vector<std::string> ModelImport::get_texture_paths(const aiMaterial& material, aiTextureType type) const
+{
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < material.GetTextureCount(type); ++i)
+	{
+		aiString str;
+		if (material.GetTexture(type, i, &str) != aiReturn_SUCCESS)
+		{
+			std::cout << "Assimp load material textures type [" << type << "] error: " << material.GetName().C_Str() << std::endl;
+			continue;
+		}
+		paths.push_back(_path.substr(0, _path.find_last_of('/')) + "/" + str.C_Str());
+	}
+	return paths;
+}
+
+std::vector<Texture*> ModelImport::load_material_textures(const aiMaterial& material, aiTextureType type) const
+{
+	std::vector<Texture*> textures;
+	for (const auto& path : get_texture_paths(material, type))
+	{
+		Texture* tex = TextureManager::get_singleton().get_texture(path);
+		if (!tex)
+			tex = TextureManager::get_singleton().load_texture(path);
+		if (tex)
+			textures.push_back(tex);
+	}
+	return textures;
+}
+
+ModelLoader::~ModelLoader()
+{
+	// running imports use the managers, which are destroyed after the loader
+	std::unique_lock<std::mutex> lock(_mutex);
+	_import_finished.wait(lock, [this]() { return _running_imports == 0; });
+	_proxy_mesh.reset();
+}
+
+std::shared_ptr<ModelLoader::Request> ModelLoader::load(const std::string& path)
+{
+	for (const auto& request : _requests)
+	{
+		if (request->_import.get_path() == path)
+			return request;
+	}
+	_requests.push_back(std::make_shared<Request>(path));
+	return _requests.back();
+}
+
+void ModelLoader::update()
+{
+	PROFILE_ZONE("ModelLoader::update");
+	// requests no model waits for anymore are dropped unless a job still works on them
+	_requests.erase(std::remove_if(_requests.begin(), _requests.end(), [](const std::shared_ptr<Request>& request)
+	{
+		const Stage stage = request->_stage;
+		return stage == Stage::Ready || stage == Stage::Failed || (request.use_count() == 1 && stage != Stage::Importing && stage != Stage::Converting);
+	}), _requests.end());
+
+	// nearest first, the distances are renewed by the models every frame
+	std::stable_sort(_requests.begin(), _requests.end(), [](const std::shared_ptr<Request>& lhs, const std::shared_ptr<Request>& rhs)
+	{
+		return lhs->_distance < rhs->_distance;
+	});
+
+	start_imports();
+	upload();
+
+	for (auto& request : _requests)
+	{
+		request->_distance = FLT_MAX;
+	}
+}
+
+void ModelLoader::start_imports()
+{
+	for (auto& request : _requests)
+	{
+		if (request->_stage != Stage::Queued)
+			continue;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_running_imports >= _max_imports)
+				return;
+			++_running_imports;
+		}
+		request->_stage = Stage::Importing;
+		std::shared_ptr<Request> job_request = request;
+		JobSystem::get_singleton().submit([this, job_request]()
+		{
+			if (job_request->_import.import())
+			{
+				job_request->_stage = Stage::Converting;
+				job_request->_import.convert();
+				job_request->_stage = Stage::Uploading;
+			}
+			else
+			{
+				job_request->_stage = Stage::Failed;
+			}
+			std::lock_guard<std::mutex> lock(_mutex);
+			--_running_imports;
+			_import_finished.notify_all();
+		});
+	}
+}
+
+void ModelLoader::upload()
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (auto& request : _requests)
+	{
+		if (request->_stage != Stage::Uploading)
+			continue;
+		// at least one step per frame so that a small budget still makes progress
+		bool done = false;
+		do
+		{
+			done = request->_import.upload_step();
+		} while (!done && std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() < _upload_budget);
+
+		if (!done)
+			return;
+		request->_meshes = request->_import.take_meshes();
+		request->_stage = Stage::Ready;
+		if (std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() >= _upload_budget)
+			return;
+	}
+}
+
+Mesh* ModelLoader::get_proxy_mesh()
+{
+	if (_proxy_mesh)
+		return _proxy_mesh.get();
+
+	ShaderProgram* shader = ShaderManager::get_singleton().get_program("light");
+	if (!shader)
+		return nullptr;
+
+	const Vector3 color(0.5f, 0.5f, 0.5f);
+	float vertices[] =
+	{
+		// x      y      z
+		-0.5f, -0.5f,  0.5f, color.r, color.g, color.b,
+		 0.5f, -0.5f,  0.5f, color.r, color.g, color.b,
+		 0.5f, -0.5f, -0.5f, color.r, color.g, color.b,
+		-0.5f, -0.5f, -0.5f, color.r, color.g, color.b,
+		-0.5f,  0.5f,  0.5f, color.r, color.g, color.b,
+		 0.5f,  0.5f,  0.5f, color.r, color.g, color.b,
+		 0.5f,  0.5f, -0.5f, color.r, color.g, color.b,
+		-0.5f,  0.5f, -0.5f, color.r, color.g, color.b,
+	};
+	std::vector<unsigned int> indices = {
+		0, 1, 5, 5, 4, 0, // front
+		2, 3, 7, 7, 6, 2, // back
+		0, 4, 7, 7, 3, 0, // left
+		1, 2, 6, 6, 5, 1, // right
+		4, 5, 6, 6, 7, 4, // top
+		0, 3, 2, 2, 1, 0  // bottom
+	};
+	Mesh::VertexFormat vf;
+	vf.push_back({ 3, Mesh::VertexAttr::ElementType::Float, false });
+	vf.push_back({ 3, Mesh::VertexAttr::ElementType::Float, false });
+
+	Material* material = MaterialManager::get_singleton().get_material("model_proxy");
+	if (!material)
+	{
+		material = MaterialManager::get_singleton().create_material("model_proxy", shader);
+		// the bounding box would shadow the scene until the model is loaded
+		material->set_cast_shadows(false);
+	}
+	_proxy_mesh.reset(new Mesh(vf, vertices, 8, indices, material));
+	return _proxy_mesh.get();
+}
@@ -0,0 +1,143 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common/singleton.h"
+#include "assimp/scene.h"
+#include "mesh.h"
+#include "texture.h"
+
+namespace Assimp
+{
+	class Importer;
+}
+
+// Loads a model file in three stages. import() and convert() may run on any thread,
+// upload_step() creates the GL objects and must run on the context thread.
+class ModelImport
+{
+public:
+	explicit ModelImport(const std::string& path);
+	~ModelImport();
+
+	ModelImport(const ModelImport&) = delete;
+	ModelImport(ModelImport&&) = delete;
+	ModelImport& operator=(const ModelImport&) = delete;
+	ModelImport& operator=(ModelImport&&) = delete;
+
+	// reads the file and finds the textures which still have to be decoded
+	bool import();
+	// converts the meshes and decodes the textures on the job system
+	void convert();
+	// uploads one texture or mesh, returns true once everything is uploaded
+	bool upload_step();
+
+	const std::string& get_path() const { return _path; }
+	// axis aligned bounds of all meshes, valid after import
+	const Vector3& get_bound_min() const { return _bound_min; }
+	const Vector3& get_bound_max() const { return _bound_max; }
+	std::vector<Mesh*> take_meshes() { return std::move(_meshes); }
+
+private:
+	void process_node(const aiNode* node);
+	static void process_mesh(const aiMesh& mesh, Mesh::Data& data);
+	Material* get_material(const aiMaterial& material) const;
+	std::vector<std::string> get_texture_paths(const aiMaterial& material, aiTextureType type) const;
+	std::vector<Texture*> load_material_textures(const aiMaterial& material, aiTextureType type) const;
+
+	std::string _path{ "" };
+	std::unique_ptr<Assimp::Importer> _importer{ };
+	const aiScene* _scene{ nullptr };
+	std::vector<const aiMesh*> _scene_meshes{ };
+	std::vector<std::string> _texture_paths{ };
+	std::vector<TextureImage> _images{ };
+	std::vector<Mesh::Data> _mesh_data{ };
+	std::vector<Mesh*> _meshes{ };
+	size_t _uploaded_textures{ 0 };
+	Vector3 _bound_min{ 0.0f, 0.0f, 0.0f };
+	Vector3 _bound_max{ 0.0f, 0.0f, 0.0f };
+};
+
+// Streams models in the background. Import and convert run on the job system, nearest models first,
+// and uploads are spread over frames within a time budget.
+class ModelLoader : public Singleton<ModelLoader>
+{
+public:
+	enum class Stage : int
+	{
+		Queued = 0,
+		Importing,
+		Converting,
+		Uploading,
+		Ready,
+		Failed
+	};
+
+	// shared by a streaming model, its copies and the loader
+	class Request
+	{
+		friend class ModelLoader;
+	public:
+		explicit Request(const std::string& path) : _import(path) { }
+
+		Stage get_stage() const { return _stage; }
+		// valid once the stage is past importing
+		const Vector3& get_bound_min() const { return _import.get_bound_min(); }
+		const Vector3& get_bound_max() const { return _import.get_bound_max(); }
+		// valid once ready
+		const std::vector<Mesh*>& get_meshes() const { return _meshes; }
+
+		// called every frame a model waits for this request, the nearest one wins
+		void request_priority(float distance) { _distance = std::min(_distance, distance); }
+
+	private:
+		ModelImport _import;
+		std::atomic<Stage> _stage{ Stage::Queued };
+		std::vector<Mesh*> _meshes{ };
+		float _distance{ FLT_MAX };
+	};
+
+	ModelLoader() = default;
+	~ModelLoader();
+
+	ModelLoader(const ModelLoader&) = delete;
+	ModelLoader(ModelLoader&&) = delete;
+	ModelLoader& operator=(const ModelLoader&) = delete;
+	ModelLoader& operator=(ModelLoader&&) = delete;
+
+	// returns immediately, the request is shared by the models of the same path still loading
+	std::shared_ptr<Request> load(const std::string& path);
+
+	// starts queued imports and uploads finished ones, called once per frame on the context thread
+	void update();
+
+	void set_upload_budget(float ms) { _upload_budget = ms; }
+	float get_upload_budget() const { return _upload_budget; }
+	void set_max_imports(unsigned int count) { _max_imports = count; }
+	unsigned int get_max_imports() const { return _max_imports; }
+	size_t get_pending_count() const { return _requests.size(); }
+
+	// unit cube drawn in place of models which are still loading, null without the light shader. Owned
+	// by the loader, which is destroyed while the context is current.
+	Mesh* get_proxy_mesh();
+
+private:
+	void start_imports();
+	void upload();
+
+	std::vector<std::shared_ptr<Request>> _requests{ };
+	float _upload_budget{ 4.0f };
+	unsigned int _max_imports{ 2 };
+	std::unique_ptr<Mesh> _proxy_mesh{ };
+
+	// imports running on the job system, waited for on destruction
+	unsigned int _running_imports{ 0 };
+	std::mutex _mutex{ };
+	std::condition_variable _import_finished{ };
+};
@@ -0,0 +1,523 @@
+﻿#include "null_device.h"
+#include <cstring>
+#include <iostream>
+#include <glad/glad.h>
+#include "gl_extensions.h"
+
+template<> NullDevice* Singleton<NullDevice>::singleton = nullptr;
+
+namespace
+{
+	typedef NullDevice::ObjectType ObjectType;
+	typedef NullDevice::Binding Binding;
+
+	NullDevice& begin_command()
+	{
+		NullDevice& device = NullDevice::get_singleton();
+		device.on_command();
+		return device;
+	}
+
+	bool check_name(NullDevice& device, ObjectType type, GLuint name, const char* entry)
+	{
+		return device.check(name == 0 || device.is_object(type, name), GL_INVALID_OPERATION, entry, "not a name of the object type");
+	}
+
+	bool check_count(NullDevice& device, GLsizei count, const char* entry)
+	{
+		return device.check(count >= 0, GL_INVALID_VALUE, entry, "negative count");
+	}
+
+	bool check_draw(NullDevice& device, GLsizei count, const char* entry)
+	{
+		device.on_draw();
+		return check_count(device, count, entry)
+			&& device.check(device.get_binding(Binding::Program) != 0, GL_INVALID_OPERATION, entry, "no program in use")
+			&& device.check(device.get_binding(Binding::VertexArray) != 0, GL_INVALID_OPERATION, entry, "no vertex array bound");
+	}
+
+	bool check_uniform(NullDevice& device, GLint location, const char* entry)
+	{
+		return location == -1 || device.check(device.get_binding(Binding::Program) != 0, GL_INVALID_OPERATION, entry, "no program in use");
+	}
+
+	void gen_objects(ObjectType type, GLsizei n, GLuint* names, const char* entry)
+	{
+		NullDevice& device = begin_command();
+		if (!check_count(device, n, entry))
+			return;
+		for (GLsizei i = 0; i < n; ++i)
+		{
+			names[i] = device.create_object(type);
+		}
+	}
+
+	void delete_objects(ObjectType type, GLsizei n, const GLuint* names, const char* entry)
+	{
+		NullDevice& device = begin_command();
+		if (!check_count(device, n, entry))
+			return;
+		for (GLsizei i = 0; i < n; ++i)
+		{
+			device.delete_object(type, names[i]);
+		}
+	}
+
+	void write_log(GLsizei buf_size, GLsizei* length, GLchar* info_log)
+	{
+		if (length)
+			*length = 0;
+		if (buf_size > 0)
+			info_log[0] = '\0';
+	}
+
+	// objects
+	void APIENTRY null_glGenBuffers(GLsizei n, GLuint* buffers) { gen_objects(ObjectType::Buffer, n, buffers, "glGenBuffers"); }
+	void APIENTRY null_glGenTextures(GLsizei n, GLuint* textures) { gen_objects(ObjectType::Texture, n, textures, "glGenTextures"); }
+	void APIENTRY null_glGenVertexArrays(GLsizei n, GLuint* arrays) { gen_objects(ObjectType::VertexArray, n, arrays, "glGenVertexArrays"); }
+	void APIENTRY null_glGenFramebuffers(GLsizei n, GLuint* framebuffers) { gen_objects(ObjectType::Framebuffer, n, framebuffers, "glGenFramebuffers"); }
+	void APIENTRY null_glGenRenderbuffers(GLsizei n, GLuint* renderbuffers) { gen_objects(ObjectType::Renderbuffer, n, renderbuffers, "glGenRenderbuffers"); }
+	void APIENTRY null_glGenQueries(GLsizei n, GLuint* ids) { gen_objects(ObjectType::Query, n, ids, "glGenQueries"); }
+	void APIENTRY null_glDeleteBuffers(GLsizei n, const GLuint* buffers) { delete_objects(ObjectType::Buffer, n, buffers, "glDeleteBuffers"); }
+	void APIENTRY null_glDeleteTextures(GLsizei n, const GLuint* textures) { delete_objects(ObjectType::Texture, n, textures, "glDeleteTextures"); }
+	void APIENTRY null_glDeleteVertexArrays(GLsizei n, const GLuint* arrays) { delete_objects(ObjectType::VertexArray, n, arrays, "glDeleteVertexArrays"); }
+	void APIENTRY null_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) { delete_objects(ObjectType::Framebuffer, n, framebuffers, "glDeleteFramebuffers"); }
+	void APIENTRY null_glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) { delete_objects(ObjectType::Renderbuffer, n, renderbuffers, "glDeleteRenderbuffers"); }
+	void APIENTRY null_glDeleteQueries(GLsizei n, const GLuint* ids) { delete_objects(ObjectType::Query, n, ids, "glDeleteQueries"); }
+
+	GLuint APIENTRY null_glCreateShader(GLenum)
+	{
+		return begin_command().create_object(ObjectType::Shader);
+	}
+
+	GLuint APIENTRY null_glCreateProgram()
+	{
+		return begin_command().create_object(ObjectType::Program);
+	}
+
+	void APIENTRY null_glDeleteShader(GLuint shader)
+	{
+		begin_command().delete_object(ObjectType::Shader, shader);
+	}
+
+	void APIENTRY null_glDeleteProgram(GLuint program)
+	{
+		begin_command().delete_object(ObjectType::Program, program);
+	}
+
+	// bindings
+	void APIENTRY null_glBindBuffer(GLenum, GLuint buffer)
+	{
+		check_name(begin_command(), ObjectType::Buffer, buffer, "glBindBuffer");
+	}
+
+	void APIENTRY null_glBindTexture(GLenum, GLuint texture)
+	{
+		check_name(begin_command(), ObjectType::Texture, texture, "glBindTexture");
+	}
+
+	void APIENTRY null_glBindRenderbuffer(GLenum, GLuint renderbuffer)
+	{
+		check_name(begin_command(), ObjectType::Renderbuffer, renderbuffer, "glBindRenderbuffer");
+	}
+
+	void APIENTRY null_glBindVertexArray(GLuint array)
+	{
+		NullDevice& device = begin_command();
+		if (check_name(device, ObjectType::VertexArray, array, "glBindVertexArray"))
+			device.bind(Binding::VertexArray, array);
+	}
+
+	void APIENTRY null_glBindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		NullDevice& device = begin_command();
+		if (!check_name(device, ObjectType::Framebuffer, framebuffer, "glBindFramebuffer"))
+			return;
+		if (target != GL_READ_FRAMEBUFFER)
+			device.bind(Binding::DrawFramebuffer, framebuffer);
+		if (target != GL_DRAW_FRAMEBUFFER)
+			device.bind(Binding::ReadFramebuffer, framebuffer);
+	}
+
+	void APIENTRY null_glUseProgram(GLuint program)
+	{
+		NullDevice& device = begin_command();
+		if (check_name(device, ObjectType::Program, program, "glUseProgram"))
+			device.bind(Binding::Program, program);
+	}
+
+	void APIENTRY null_glActiveTexture(GLenum texture)
+	{
+		NullDevice& device = begin_command();
+		device.check(texture >= GL_TEXTURE0 && texture <= GL_TEXTURE31, GL_INVALID_ENUM, "glActiveTexture", "not a texture unit");
+	}
+
+	// fixed function state
+	void APIENTRY null_glEnable(GLenum) { begin_command(); }
+	void APIENTRY null_glDisable(GLenum) { begin_command(); }
+	void APIENTRY null_glDepthFunc(GLenum) { begin_command(); }
+	void APIENTRY null_glDepthMask(GLboolean) { begin_command(); }
+	void APIENTRY null_glStencilMask(GLuint) { begin_command(); }
+	void APIENTRY null_glStencilFunc(GLenum, GLint, GLuint) { begin_command(); }
+	void APIENTRY null_glStencilOp(GLenum, GLenum, GLenum) { begin_command(); }
+	void APIENTRY null_glCullFace(GLenum) { begin_command(); }
+	void APIENTRY null_glFrontFace(GLenum) { begin_command(); }
+	void APIENTRY null_glBlendFunc(GLenum, GLenum) { begin_command(); }
+	void APIENTRY null_glColorMask(GLboolean, GLboolean, GLboolean, GLboolean) { begin_command(); }
+	void APIENTRY null_glClearColor(GLfloat, GLfloat, GLfloat, GLfloat) { begin_command(); }
+	void APIENTRY null_glScissor(GLint, GLint, GLsizei, GLsizei) { begin_command(); }
+	void APIENTRY null_glPolygonOffset(GLfloat, GLfloat) { begin_command(); }
+	void APIENTRY null_glPixelStorei(GLenum, GLint) { begin_command(); }
+	void APIENTRY null_glDrawBuffer(GLenum) { begin_command(); }
+	void APIENTRY null_glDrawBuffers(GLsizei n, const GLenum*) { check_count(begin_command(), n, "glDrawBuffers"); }
+	void APIENTRY null_glReadBuffer(GLenum) { begin_command(); }
+
+	void APIENTRY null_glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		NullDevice& device = begin_command();
+		if (device.check(width >= 0 && height >= 0, GL_INVALID_VALUE, "glViewport", "negative size"))
+			device.set_viewport(x, y, width, height);
+	}
+
+	// data
+	void APIENTRY null_glBufferData(GLenum, GLsizeiptr size, const void*, GLenum)
+	{
+		begin_command().check(size >= 0, GL_INVALID_VALUE, "glBufferData", "negative size");
+	}
+
+	void APIENTRY null_glBufferSubData(GLenum, GLintptr offset, GLsizeiptr size, const void*)
+	{
+		begin_command().check(offset >= 0 && size >= 0, GL_INVALID_VALUE, "glBufferSubData", "negative range");
+	}
+
+	void APIENTRY null_glTexImage2D(GLenum, GLint level, GLint, GLsizei width, GLsizei height, GLint, GLenum, GLenum, const void*)
+	{
+		begin_command().check(width >= 0 && height >= 0 && level >= 0, GL_INVALID_VALUE, "glTexImage2D", "negative size or level");
+	}
+
+	void APIENTRY null_glTexSubImage2D(GLenum, GLint level, GLint, GLint, GLsizei width, GLsizei height, GLenum, GLenum, const void*)
+	{
+		begin_command().check(width >= 0 && height >= 0 && level >= 0, GL_INVALID_VALUE, "glTexSubImage2D", "negative size or level");
+	}
+
+	void APIENTRY null_glTexImage3D(GLenum, GLint level, GLint, GLsizei width, GLsizei height, GLsizei depth, GLint, GLenum, GLenum, const void*)
+	{
+		begin_command().check(width >= 0 && height >= 0 && depth >= 0 && level >= 0, GL_INVALID_VALUE, "glTexImage3D", "negative size or level");
+	}
+
+	void APIENTRY null_glTexParameteri(GLenum, GLenum, GLint) { begin_command(); }
+	void APIENTRY null_glTexBuffer(GLenum, GLenum, GLuint buffer) { check_name(begin_command(), ObjectType::Buffer, buffer, "glTexBuffer"); }
+	void APIENTRY null_glGenerateMipmap(GLenum) { begin_command(); }
+	void APIENTRY null_glRenderbufferStorage(GLenum, GLenum, GLsizei, GLsizei) { begin_command(); }
+	void APIENTRY null_glEnableVertexAttribArray(GLuint) { begin_command(); }
+
+	void APIENTRY null_glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*)
+	{
+		NullDevice& device = begin_command();
+		device.check(device.get_binding(Binding::VertexArray) != 0, GL_INVALID_OPERATION, "glVertexAttribPointer", "no vertex array bound");
+	}
+
+	void APIENTRY null_glFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint texture, GLint)
+	{
+		check_name(begin_command(), ObjectType::Texture, texture, "glFramebufferTexture2D");
+	}
+
+	void APIENTRY null_glFramebufferTextureLayer(GLenum, GLenum, GLuint texture, GLint, GLint)
+	{
+		check_name(begin_command(), ObjectType::Texture, texture, "glFramebufferTextureLayer");
+	}
+
+	void APIENTRY null_glFramebufferRenderbuffer(GLenum, GLenum, GLenum, GLuint renderbuffer)
+	{
+		check_name(begin_command(), ObjectType::Renderbuffer, renderbuffer, "glFramebufferRenderbuffer");
+	}
+
+	GLenum APIENTRY null_glCheckFramebufferStatus(GLenum)
+	{
+		begin_command();
+		return GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	// programs, they compile and link without looking at the source
+	void APIENTRY null_glShaderSource(GLuint shader, GLsizei, const GLchar* const*, const GLint*)
+	{
+		check_name(begin_command(), ObjectType::Shader, shader, "glShaderSource");
+	}
+
+	void APIENTRY null_glCompileShader(GLuint shader)
+	{
+		check_name(begin_command(), ObjectType::Shader, shader, "glCompileShader");
+	}
+
+	void APIENTRY null_glAttachShader(GLuint program, GLuint shader)
+	{
+		NullDevice& device = begin_command();
+		check_name(device, ObjectType::Program, program, "glAttachShader") && check_name(device, ObjectType::Shader, shader, "glAttachShader");
+	}
+
+	void APIENTRY null_glDetachShader(GLuint, GLuint) { begin_command(); }
+
+	void APIENTRY null_glLinkProgram(GLuint program)
+	{
+		check_name(begin_command(), ObjectType::Program, program, "glLinkProgram");
+	}
+
+	void APIENTRY null_glProgramParameteri(GLuint, GLenum, GLint) { begin_command(); }
+	void APIENTRY null_glProgramBinary(GLuint, GLenum, const void*, GLsizei) { begin_command(); }
+
+	void APIENTRY null_glGetProgramBinary(GLuint, GLsizei, GLsizei* length, GLenum*, void*)
+	{
+		begin_command();
+		if (length)
+			*length = 0;
+	}
+
+	void APIENTRY null_glGetShaderiv(GLuint, GLenum pname, GLint* params)
+	{
+		begin_command();
+		*params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+	}
+
+	void APIENTRY null_glGetProgramiv(GLuint, GLenum pname, GLint* params)
+	{
+		begin_command();
+		*params = pname == GL_LINK_STATUS || pname == GL_COMPLETION_STATUS_KHR ? GL_TRUE : 0;
+	}
+
+	void APIENTRY null_glGetShaderInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog) { begin_command(); write_log(bufSize, length, infoLog); }
+	void APIENTRY null_glGetProgramInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog) { begin_command(); write_log(bufSize, length, infoLog); }
+
+	GLint APIENTRY null_glGetUniformLocation(GLuint, const GLchar*)
+	{
+		begin_command();
+		return 0;
+	}
+
+	void APIENTRY null_glUniform1i(GLint location, GLint) { check_uniform(begin_command(), location, "glUniform1i"); }
+	void APIENTRY null_glUniform1f(GLint location, GLfloat) { check_uniform(begin_command(), location, "glUniform1f"); }
+	void APIENTRY null_glUniform2fv(GLint location, GLsizei, const GLfloat*) { check_uniform(begin_command(), location, "glUniform2fv"); }
+	void APIENTRY null_glUniform3f(GLint location, GLfloat, GLfloat, GLfloat) { check_uniform(begin_command(), location, "glUniform3f"); }
+	void APIENTRY null_glUniform3fv(GLint location, GLsizei, const GLfloat*) { check_uniform(begin_command(), location, "glUniform3fv"); }
+	void APIENTRY null_glUniform4f(GLint location, GLfloat, GLfloat, GLfloat, GLfloat) { check_uniform(begin_command(), location, "glUniform4f"); }
+	void APIENTRY null_glUniform4fv(GLint location, GLsizei, const GLfloat*) { check_uniform(begin_command(), location, "glUniform4fv"); }
+	void APIENTRY null_glUniformMatrix3fv(GLint location, GLsizei, GLboolean, const GLfloat*) { check_uniform(begin_command(), location, "glUniformMatrix3fv"); }
+	void APIENTRY null_glUniformMatrix4fv(GLint location, GLsizei, GLboolean, const GLfloat*) { check_uniform(begin_command(), location, "glUniformMatrix4fv"); }
+
+	// draws
+	void APIENTRY null_glDrawArrays(GLenum, GLint, GLsizei count)
+	{
+		check_draw(begin_command(), count, "glDrawArrays");
+	}
+
+	void APIENTRY null_glDrawElements(GLenum, GLsizei count, GLenum, const void*)
+	{
+		check_draw(begin_command(), count, "glDrawElements");
+	}
+
+	void APIENTRY null_glDrawArraysInstanced(GLenum, GLint, GLsizei count, GLsizei)
+	{
+		check_draw(begin_command(), count, "glDrawArraysInstanced");
+	}
+
+	void APIENTRY null_glDrawElementsInstanced(GLenum, GLsizei count, GLenum, const void*, GLsizei)
+	{
+		check_draw(begin_command(), count, "glDrawElementsInstanced");
+	}
+
+	void APIENTRY null_glMultiDrawElements(GLenum, const GLsizei*, GLenum, const void* const*, GLsizei drawcount)
+	{
+		check_draw(begin_command(), drawcount, "glMultiDrawElements");
+	}
+
+	void APIENTRY null_glClear(GLbitfield) { begin_command(); }
+	void APIENTRY null_glBlitFramebuffer(GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum) { begin_command(); }
+
+	// queries, timer queries are always done and read zero
+	void APIENTRY null_glBeginQuery(GLenum, GLuint id) { check_name(begin_command(), ObjectType::Query, id, "glBeginQuery"); }
+	void APIENTRY null_glEndQuery(GLenum) { begin_command(); }
+	void APIENTRY null_glQueryCounter(GLuint id, GLenum) { check_name(begin_command(), ObjectType::Query, id, "glQueryCounter"); }
+
+	void APIENTRY null_glGetQueryObjectuiv(GLuint, GLenum pname, GLuint* params)
+	{
+		begin_command();
+		*params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+	}
+
+	void APIENTRY null_glGetQueryObjectui64v(GLuint, GLenum, GLuint64* params)
+	{
+		begin_command();
+		*params = 0;
+	}
+
+	void APIENTRY null_glGetIntegerv(GLenum pname, GLint* data)
+	{
+		NullDevice& device = begin_command();
+		switch (pname)
+		{
+		case GL_VIEWPORT: memcpy(data, device.get_viewport(), sizeof(GLint) * 4); break;
+		case GL_FRAMEBUFFER_BINDING: *data = device.get_binding(Binding::DrawFramebuffer); break;
+		case GL_READ_FRAMEBUFFER_BINDING: *data = device.get_binding(Binding::ReadFramebuffer); break;
+		case GL_CURRENT_PROGRAM: *data = device.get_binding(Binding::Program); break;
+		case GL_VERTEX_ARRAY_BINDING: *data = device.get_binding(Binding::VertexArray); break;
+		case GL_NUM_EXTENSIONS: *data = 1; break;
+		case GL_MAX_TEXTURE_SIZE: *data = 16384; break;
+		case GL_MAX_TEXTURE_IMAGE_UNITS: *data = 32; break;
+		default: *data = 0; break;
+		}
+	}
+
+	void APIENTRY null_glGetInteger64v(GLenum, GLint64* data)
+	{
+		begin_command();
+		*data = 0;
+	}
+
+	const GLubyte* APIENTRY null_glGetString(GLenum name)
+	{
+		begin_command();
+		switch (name)
+		{
+		case GL_VENDOR: return (const GLubyte*)"none";
+		case GL_RENDERER: return (const GLubyte*)"null device";
+		case GL_VERSION: return (const GLubyte*)"3.3 null device";
+		case GL_SHADING_LANGUAGE_VERSION: return (const GLubyte*)"3.30";
+		case GL_EXTENSIONS: return (const GLubyte*)"GL_EXT_null_device";
+		default: return nullptr;
+		}
+	}
+
+	// glad fails to load without any extension, the device names one of its own
+	const GLubyte* APIENTRY null_glGetStringi(GLenum name, GLuint index)
+	{
+		NullDevice& device = begin_command();
+		if (!device.check(name == GL_EXTENSIONS && index == 0, GL_INVALID_VALUE, "glGetStringi", "no such string"))
+			return nullptr;
+		return (const GLubyte*)"GL_EXT_null_device";
+	}
+
+	GLenum APIENTRY null_glGetError()
+	{
+		return begin_command().pop_error();
+	}
+
+	void APIENTRY null_glReadPixels(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*) { begin_command(); }
+	void APIENTRY null_glFinish() { begin_command(); }
+	void APIENTRY null_glFlush() { begin_command(); }
+
+	struct EntryPoint
+	{
+		const char* name;
+		void* function;
+	};
+
+	#define NULL_ENTRY(name) { #name, (void*)null_##name }
+	const EntryPoint ENTRY_POINTS[] =
+	{
+		NULL_ENTRY(glGenBuffers), NULL_ENTRY(glGenTextures), NULL_ENTRY(glGenVertexArrays), NULL_ENTRY(glGenFramebuffers),
+		NULL_ENTRY(glGenRenderbuffers), NULL_ENTRY(glGenQueries), NULL_ENTRY(glDeleteBuffers), NULL_ENTRY(glDeleteTextures),
+		NULL_ENTRY(glDeleteVertexArrays), NULL_ENTRY(glDeleteFramebuffers), NULL_ENTRY(glDeleteRenderbuffers), NULL_ENTRY(glDeleteQueries),
+		NULL_ENTRY(glCreateShader), NULL_ENTRY(glCreateProgram), NULL_ENTRY(glDeleteShader), NULL_ENTRY(glDeleteProgram),
+		NULL_ENTRY(glBindBuffer), NULL_ENTRY(glBindTexture), NULL_ENTRY(glBindRenderbuffer), NULL_ENTRY(glBindVertexArray),
+		NULL_ENTRY(glBindFramebuffer), NULL_ENTRY(glUseProgram), NULL_ENTRY(glActiveTexture),
+		NULL_ENTRY(glEnable), NULL_ENTRY(glDisable), NULL_ENTRY(glDepthFunc), NULL_ENTRY(glDepthMask), NULL_ENTRY(glStencilMask),
+		NULL_ENTRY(glStencilFunc), NULL_ENTRY(glStencilOp), NULL_ENTRY(glCullFace), NULL_ENTRY(glFrontFace), NULL_ENTRY(glBlendFunc),
+		NULL_ENTRY(glColorMask), NULL_ENTRY(glClearColor), NULL_ENTRY(glScissor), NULL_ENTRY(glPolygonOffset), NULL_ENTRY(glPixelStorei),
+		NULL_ENTRY(glDrawBuffer), NULL_ENTRY(glDrawBuffers), NULL_ENTRY(glReadBuffer), NULL_ENTRY(glViewport),
+		NULL_ENTRY(glBufferData), NULL_ENTRY(glBufferSubData), NULL_ENTRY(glTexImage2D), NULL_ENTRY(glTexSubImage2D), NULL_ENTRY(glTexImage3D),
+		NULL_ENTRY(glTexParameteri), NULL_ENTRY(glTexBuffer), NULL_ENTRY(glGenerateMipmap), NULL_ENTRY(glRenderbufferStorage),
+		NULL_ENTRY(glEnableVertexAttribArray), NULL_ENTRY(glVertexAttribPointer), NULL_ENTRY(glFramebufferTexture2D),
+		NULL_ENTRY(glFramebufferTextureLayer), NULL_ENTRY(glFramebufferRenderbuffer), NULL_ENTRY(glCheckFramebufferStatus),
+		NULL_ENTRY(glShaderSource), NULL_ENTRY(glCompileShader), NULL_ENTRY(glAttachShader), NULL_ENTRY(glDetachShader),
+		NULL_ENTRY(glLinkProgram), NULL_ENTRY(glProgramParameteri), NULL_ENTRY(glProgramBinary), NULL_ENTRY(glGetProgramBinary),
+		NULL_ENTRY(glGetShaderiv), NULL_ENTRY(glGetProgramiv), NULL_ENTRY(glGetShaderInfoLog), NULL_ENTRY(glGetProgramInfoLog),
+		NULL_ENTRY(glGetUniformLocation), NULL_ENTRY(glUniform1i), NULL_ENTRY(glUniform1f), NULL_ENTRY(glUniform2fv), NULL_ENTRY(glUniform3f),
+		NULL_ENTRY(glUniform3fv), NULL_ENTRY(glUniform4f), NULL_ENTRY(glUniform4fv), NULL_ENTRY(glUniformMatrix3fv), NULL_ENTRY(glUniformMatrix4fv),
+		NULL_ENTRY(glDrawArrays), NULL_ENTRY(glDrawElements), NULL_ENTRY(glDrawArraysInstanced), NULL_ENTRY(glDrawElementsInstanced),
+		NULL_ENTRY(glMultiDrawElements), NULL_ENTRY(glClear), NULL_ENTRY(glBlitFramebuffer),
+		NULL_ENTRY(glBeginQuery), NULL_ENTRY(glEndQuery), NULL_ENTRY(glQueryCounter), NULL_ENTRY(glGetQueryObjectuiv),
+		NULL_ENTRY(glGetQueryObjectui64v), NULL_ENTRY(glGetIntegerv), NULL_ENTRY(glGetInteger64v), NULL_ENTRY(glGetString),
+		NULL_ENTRY(glGetStringi), NULL_ENTRY(glGetError), NULL_ENTRY(glReadPixels), NULL_ENTRY(glFinish), NULL_ENTRY(glFlush),
+	};
+	#undef NULL_ENTRY
+}
+
+void* NullDevice::get_proc_address(const char* name)
+{
+	for (const auto& entry : ENTRY_POINTS)
+	{
+		if (strcmp(entry.name, name) == 0)
+			return entry.function;
+	}
+	return nullptr;
+}
+
+void NullDevice::end_frame()
+{
+	_last_frame = _frame;
+	_frame = FrameStats{ };
+}
+
+bool NullDevice::check(bool condition, unsigned int error, const char* entry, const char* message)
+{
+	if (condition)
+		return true;
+
+	++_frame.errors;
+	if (_error == GL_NO_ERROR)
+		_error = error;
+	if (_reported_errors < MAX_REPORTED_ERRORS)
+	{
+		std::cout << "Null device: " << entry << ": " << message << std::endl;
+		if (++_reported_errors == MAX_REPORTED_ERRORS)
+			std::cout << "Null device: no more errors reported" << std::endl;
+	}
+	return false;
+}
+
+unsigned int NullDevice::pop_error()
+{
+	const unsigned int error = _error;
+	_error = GL_NO_ERROR;
+	return error;
+}
+
+unsigned int NullDevice::create_object(ObjectType type)
+{
+	const unsigned int name = ++_next_names[(unsigned int)type];
+	_objects[(unsigned int)type].insert(name);
+	return name;
+}
+
+void NullDevice::delete_object(ObjectType type, unsigned int name)
+{
+	// unknown names are ignored like in GL. A program in use stays in use until another one replaces it.
+	if (_objects[(unsigned int)type].erase(name) == 0)
+		return;
+	auto unbind = [&](Binding binding)
+	{
+		if (get_binding(binding) == name)
+			bind(binding, 0);
+	};
+	if (type == ObjectType::VertexArray)
+	{
+		unbind(Binding::VertexArray);
+	}
+	else if (type == ObjectType::Framebuffer)
+	{
+		unbind(Binding::DrawFramebuffer);
+		unbind(Binding::ReadFramebuffer);
+	}
+}
+
+bool NullDevice::is_object(ObjectType type, unsigned int name) const
+{
+	return _objects[(unsigned int)type].count(name) != 0;
+}
+
+void NullDevice::set_viewport(int x, int y, int width, int height)
+{
+	_viewport[0] = x;
+	_viewport[1] = y;
+	_viewport[2] = width;
+	_viewport[3] = height;
+}
@@ -0,0 +1,86 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include "common/singleton.h"
+
+// Stands in for the GL driver with the null render backend. Glad loads its entry points in place of
+// those of a context: they check their arguments against the objects made so far and count the
+// commands, but do no work, so the CPU side of the engine runs on machines without a GPU and without
+// the cost of a driver. Covers the part of GL 3.3 the engine calls, the other entry points stay null.
+// The first errors are printed, and the error is kept for glGetError like a driver would.
+class NullDevice : public Singleton<NullDevice>
+{
+public:
+	enum class ObjectType : unsigned int
+	{
+		Buffer,
+		Texture,
+		VertexArray,
+		Framebuffer,
+		Renderbuffer,
+		Query,
+		Shader,
+		Program,
+		Count,
+	};
+
+	// bound objects the checks depend on
+	enum class Binding : unsigned int
+	{
+		Program,
+		VertexArray,
+		DrawFramebuffer,
+		ReadFramebuffer,
+		Count,
+	};
+
+	struct FrameStats
+	{
+		uint64_t commands;
+		unsigned int draws;
+		unsigned int errors;
+	};
+
+	NullDevice() = default;
+	~NullDevice() = default;
+
+	NullDevice(const NullDevice&) = delete;
+	NullDevice(NullDevice&&) = delete;
+	NullDevice& operator=(const NullDevice&) = delete;
+	NullDevice& operator=(NullDevice&&) = delete;
+
+	// the loader to give glad, for the entry points of the device
+	static void* get_proc_address(const char* name);
+
+	void end_frame();
+	// of the last frame ended
+	const FrameStats& get_frame_stats() const { return _last_frame; }
+
+	// called by the entry points
+	void on_command() { ++_frame.commands; }
+	void on_draw() { ++_frame.draws; }
+	// records error when condition fails, returns condition
+	bool check(bool condition, unsigned int error, const char* entry, const char* message);
+	// returns the first error since the last call, like glGetError
+	unsigned int pop_error();
+	unsigned int create_object(ObjectType type);
+	void delete_object(ObjectType type, unsigned int name);
+	bool is_object(ObjectType type, unsigned int name) const;
+	void bind(Binding binding, unsigned int name) { _bindings[(unsigned int)binding] = name; }
+	unsigned int get_binding(Binding binding) const { return _bindings[(unsigned int)binding]; }
+	void set_viewport(int x, int y, int width, int height);
+	const int* get_viewport() const { return _viewport; }
+
+private:
+	static const unsigned int MAX_REPORTED_ERRORS = 16;
+
+	FrameStats _frame{ };
+	FrameStats _last_frame{ };
+	unsigned int _error{ 0 };
+	unsigned int _reported_errors{ 0 };
+	std::unordered_set<unsigned int> _objects[(unsigned int)ObjectType::Count]{ };
+	unsigned int _next_names[(unsigned int)ObjectType::Count]{ };
+	unsigned int _bindings[(unsigned int)Binding::Count]{ };
+	int _viewport[4]{ };
+};
@@ -0,0 +1,47 @@
+﻿#include "offscreen_target.h"
+#include <iostream>
+#include "glad/glad.h"
+#include "graphic_api.h"
+
+bool OffscreenTarget::resize(int width, int height)
+{
+	if (_framebuffer && width == _width && height == _height)
+		return true;
+	release();
+	if (width <= 0 || height <= 0)
+		return false;
+
+	CHECK_GL_ERROR(glGenFramebuffers(1, &_framebuffer));
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+	CHECK_GL_ERROR(glGenRenderbuffers(2, _renderbuffers));
+	CHECK_GL_ERROR(glBindRenderbuffer(GL_RENDERBUFFER, _renderbuffers[0]));
+	CHECK_GL_ERROR(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height));
+	CHECK_GL_ERROR(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _renderbuffers[0]));
+	CHECK_GL_ERROR(glBindRenderbuffer(GL_RENDERBUFFER, _renderbuffers[1]));
+	CHECK_GL_ERROR(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height));
+	CHECK_GL_ERROR(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, _renderbuffers[1]));
+	CHECK_GL_ERROR(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "OffscreenTarget incomplete framebuffer: " << std::hex << status << std::dec << std::endl;
+		release();
+		return false;
+	}
+	_width = width;
+	_height = height;
+	return true;
+}
+
+void OffscreenTarget::release()
+{
+	if (!_framebuffer)
+		return;
+	CHECK_GL_ERROR(glDeleteFramebuffers(1, &_framebuffer));
+	CHECK_GL_ERROR(glDeleteRenderbuffers(2, _renderbuffers));
+	_framebuffer = 0;
+	_width = 0;
+	_height = 0;
+}
@@ -0,0 +1,29 @@
+﻿#pragma once
+
+// A color and depth stencil framebuffer standing in for the default one of a window, for headless
+// rendering. The depth stencil format is that of the G-buffer, so that its depth can be blitted in.
+class OffscreenTarget
+{
+public:
+	OffscreenTarget() = default;
+	~OffscreenTarget() { release(); }
+
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget(OffscreenTarget&&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(OffscreenTarget&&) = delete;
+
+	// recreates the buffers when the size changes
+	bool resize(int width, int height);
+	void release();
+
+	unsigned int get_framebuffer() const { return _framebuffer; }
+	int get_width() const { return _width; }
+	int get_height() const { return _height; }
+
+private:
+	unsigned int _framebuffer{ 0 };
+	unsigned int _renderbuffers[2]{ };	// RGBA8 color, DEPTH24_STENCIL8
+	int _width{ 0 };
+	int _height{ 0 };
+};
@@ -0,0 +1,138 @@
+﻿#include "program_binary_cache.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "gl_extensions.h"
+#include "graphic_api.h"
+#include "common/hash.h"
+#ifdef _WIN32
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x43425047;	// "GPBC"
+	const uint32_t CACHE_VERSION = 1;
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	void make_directory(const std::string& path)
+	{
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+}
+
+bool ProgramBinaryCache::enabled() const
+{
+	return !_directory.empty() && get_gl_extensions().program_binary;
+}
+
+uint64_t ProgramBinaryCache::make_key(const std::string& vertex_source, const std::string& fragment_source)
+{
+	if (_driver_hash == 0)
+	{
+		const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		_driver_hash = hash_fnv1a(&CACHE_VERSION, sizeof(CACHE_VERSION));
+		for (auto name : names)
+		{
+			const char* str = reinterpret_cast<const char*>(glGetString(name));
+			_driver_hash = hash_fnv1a(str ? str : "", _driver_hash);
+		}
+	}
+	// the length separates the sources so that moving text from one to the other changes the key
+	const uint64_t vertex_length = vertex_source.size();
+	uint64_t key = hash_fnv1a(&vertex_length, sizeof(vertex_length), _driver_hash);
+	key = hash_fnv1a(vertex_source, key);
+	return hash_fnv1a(fragment_source, key);
+}
+
+bool ProgramBinaryCache::load(uint64_t key, unsigned int program) const
+{
+	if (!enabled())
+		return false;
+
+	const std::string path = get_file_path(key);
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+		return false;
+
+	CacheHeader header;
+	std::vector<char> binary;
+	if (stream.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+		header.magic == CACHE_MAGIC && header.version == CACHE_VERSION && header.key == key)
+	{
+		binary.resize(header.length);
+		if (!stream.read(binary.data(), binary.size()))
+			binary.clear();
+	}
+	stream.close();
+
+	if (!binary.empty())
+	{
+		CHECK_GL_ERROR(get_gl_extensions().glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size()));
+		int success = 0;
+		CHECK_GL_ERROR(glGetProgramiv(program, GL_LINK_STATUS, &success));
+		if (success)
+			return true;
+	}
+	std::cout << "ProgramBinaryCache dropping rejected binary " << path << std::endl;
+	remove(path.c_str());
+	return false;
+}
+
+void ProgramBinaryCache::prepare(unsigned int program) const
+{
+	if (enabled())
+		CHECK_GL_ERROR(get_gl_extensions().glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+}
+
+void ProgramBinaryCache::store(uint64_t key, unsigned int program) const
+{
+	if (!enabled())
+		return;
+
+	GLint length = 0;
+	CHECK_GL_ERROR(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	CHECK_GL_ERROR(get_gl_extensions().glGetProgramBinary(program, length, &length, &format, binary.data()));
+
+	CacheHeader header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	make_directory(_directory);
+	const std::string path = get_file_path(key);
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(binary.data(), length);
+	if (!stream)
+		std::cout << "ProgramBinaryCache failed writing " << path << std::endl;
+}
+
+std::string ProgramBinaryCache::get_file_path(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return _directory + "/" + name;
+}
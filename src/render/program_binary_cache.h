@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+// On disk cache of linked program binaries. Binaries are keyed by the shader sources and the
+// GL vendor, renderer and version, so a driver update simply misses the cache.
+class ProgramBinaryCache
+{
+public:
+	explicit ProgramBinaryCache(const std::string& directory) : _directory(directory) { }
+	~ProgramBinaryCache() = default;
+
+	ProgramBinaryCache(const ProgramBinaryCache&) = delete;
+	ProgramBinaryCache(ProgramBinaryCache&&) = delete;
+	ProgramBinaryCache& operator=(const ProgramBinaryCache&) = delete;
+	ProgramBinaryCache& operator=(ProgramBinaryCache&&) = delete;
+
+	// false without driver support, the cache is then never used
+	bool enabled() const;
+
+	uint64_t make_key(const std::string& vertex_source, const std::string& fragment_source);
+
+	// links program from a cached binary, a rejected binary is removed from the cache
+	bool load(uint64_t key, unsigned int program) const;
+	// call before linking a program which is going to be stored
+	void prepare(unsigned int program) const;
+	void store(uint64_t key, unsigned int program) const;
+
+	const std::string& get_directory() const { return _directory; }
+
+private:
+	std::string get_file_path(uint64_t key) const;
+
+	std::string _directory{ "" };
+	uint64_t _driver_hash{ 0 };
+};
@@ -0,0 +1,124 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "math/math.h"
+#include "mesh.h"
+
+class ShaderProgram;
+class Material;
+
+// depth, cull and blend state of a material packed in 32 bits, see Material::get_render_state
+typedef uint32_t RenderState;
+
+// A GL command of a draw list as plain data. It refers to the programs, materials, matrices and cluster
+// ranges of the frame, which must outlive its replay.
+struct RenderCommand
+{
+	enum class Type : unsigned int
+	{
+		BindProgram,		// with the frame data of the renderer and the samplers of the material
+		SetRenderState,
+		BindTexture,
+		Draw,
+		DrawRanges,
+		CallHandler,		// a pre or post draw handler of a mesh, the GL state after it is unknown
+	};
+
+	struct BindProgram
+	{
+		ShaderProgram* program;
+		const Material* material;
+	};
+
+	struct BindTexture
+	{
+		unsigned int unit;
+		unsigned int texture;
+	};
+
+	struct Draw
+	{
+		const Matrix4* model;
+		unsigned int vao;
+		unsigned int first;		// index or vertex
+		unsigned int count;
+		bool indexed;
+	};
+
+	struct DrawRanges
+	{
+		const Matrix4* model;
+		unsigned int vao;
+		const int* counts;
+		const void* const* offsets;
+		unsigned int range_count;
+	};
+
+	struct CallHandler
+	{
+		Mesh::DrawHandler* handler;
+		Mesh* mesh;
+		const Matrix4* model;
+	};
+
+	Type type;
+	union
+	{
+		BindProgram bind_program;
+		RenderState render_state;
+		BindTexture bind_texture;
+		Draw draw;
+		DrawRanges draw_ranges;
+		CallHandler call_handler;
+	};
+};
+
+// Commands recorded on any thread and replayed on the GL thread by the renderer. A buffer keeps its
+// storage when cleared, recording allocates only while it grows past its largest frame.
+class RenderCommandBuffer
+{
+public:
+	void clear() { _commands.clear(); }
+	const std::vector<RenderCommand>& get_commands() const { return _commands; }
+
+	void bind_program(ShaderProgram* program, const Material* material)
+	{
+		push(RenderCommand::Type::BindProgram).bind_program = { program, material };
+	}
+
+	void set_render_state(RenderState state)
+	{
+		push(RenderCommand::Type::SetRenderState).render_state = state;
+	}
+
+	void bind_texture(unsigned int unit, unsigned int texture)
+	{
+		push(RenderCommand::Type::BindTexture).bind_texture = { unit, texture };
+	}
+
+	void draw(const Matrix4* model, unsigned int vao, unsigned int first, unsigned int count, bool indexed)
+	{
+		push(RenderCommand::Type::Draw).draw = { model, vao, first, count, indexed };
+	}
+
+	void draw_ranges(const Matrix4* model, unsigned int vao, const int* counts, const void* const* offsets, unsigned int range_count)
+	{
+		push(RenderCommand::Type::DrawRanges).draw_ranges = { model, vao, counts, offsets, range_count };
+	}
+
+	void call_handler(Mesh::DrawHandler* handler, Mesh* mesh, const Matrix4* model)
+	{
+		push(RenderCommand::Type::CallHandler).call_handler = { handler, mesh, model };
+	}
+
+private:
+	RenderCommand& push(RenderCommand::Type type)
+	{
+		_commands.emplace_back();
+		_commands.back().type = type;
+		return _commands.back();
+	}
+
+	std::vector<RenderCommand> _commands{ };
+};
@@ -1,104 +1,837 @@
 ﻿#include "renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <glad/glad.h>
 #include "engine/engine.h"
 #include "engine/camera.h"
 #include "model.h"
 #include "material.h"
+#include "shader_manager.h"
 #include "graphic_api.h"
+#include "gpu_profiler.h"
+#include "common/radix_sort.h"
+#include "common/job_system.h"
+#include "common/profiler.h"
 
-Renderer* Singleton<Renderer>::singleton = nullptr;
+template<> Renderer* Singleton<Renderer>::singleton = nullptr;
 
-void Renderer::begin_frame(float delta)
+namespace
 {
-	CHECK_GL_ERROR(glClearColor(_clear_color.r, _clear_color.g, _clear_color.b, _clear_color.a));
+	// above the material textures
+	const int SHADOW_TEXTURE_UNIT = 11;
+	const int LIGHT_TEXTURE_UNIT = 13;
+	// draws recorded by one job, a chunk starts without any bound state so it sets it up again
+	const size_t COMMAND_CHUNK_SIZE = 256;
+	const unsigned int LIGHT_TEXTURE_FORMATS[] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	const char* const LIGHT_TEXTURE_NAMES[] = { "light_data", "light_clusters", "light_indices" };
+
+	// looked up every frame, a literal would make a string for each lookup
+	const std::string DEPTH_PROGRAM = "depth";
+	const std::string OVERDRAW_PROGRAM = "overdraw";
+	const std::string DEFERRED_LIGHTING_PROGRAM = "deferred_lighting";
+
+	static_assert(sizeof(LightGrid::Cluster) == 8, "a cluster is one RG32UI texel");
+
+	// numbers pointers in the order they first appear, in an open addressing table of frame memory
+	class BucketTable
+	{
+	public:
+		BucketTable(FrameArena& arena, size_t max_count)
+		{
+			while (_mask + 1 < max_count * 2)
+				_mask = _mask * 2 + 1;
+			_keys = arena.allocate<const void*>(_mask + 1);
+			_buckets = arena.allocate<uint32_t>(_mask + 1);
+			std::fill(_keys, _keys + _mask + 1, nullptr);
+		}
+
+		uint64_t get(const void* key)
+		{
+			if (!key)
+				return 0xFFFF;
+			// the low bits of pointers are mostly alignment, the multiply spreads the others over them
+			size_t slot = (size_t)(((uint64_t)(uintptr_t)key * 0x9E3779B97F4A7C15ull) >> 32) & _mask;
+			for (;; slot = (slot + 1) & _mask)
+			{
+				if (_keys[slot] == key)
+					return _buckets[slot];
+				if (!_keys[slot])
+				{
+					_keys[slot] = key;
+					_buckets[slot] = _count;
+					return _count++;
+				}
+			}
+		}
+
+	private:
+		const void** _keys{ nullptr };
+		uint32_t* _buckets{ nullptr };
+		size_t _mask{ 15 };
+		uint32_t _count{ 0 };
+	};
+}
+
+void Renderer::begin_frame()
+{
+	const Color clear_color = _overdraw_view_enabled ? Color(0.0f, 0.0f, 0.0f, 1.0f) : _clear_color;
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, _target_framebuffer));
+	CHECK_GL_ERROR(glViewport(0, 0, _frame->viewport_width, _frame->viewport_height));
+	CHECK_GL_ERROR(glClearColor(clear_color.r, clear_color.g, clear_color.b, clear_color.a));
 	CHECK_GL_ERROR(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
 
-	_render_list.clear();
+	_frame_stats = _frame->stats;
 }
 
-void Renderer::end_frame(bool swap_buffer)
+void Renderer::end_frame()
 {
-	std::vector<RenderInfo> opaque_list{ };
-	std::vector<RenderInfo> translucent_list{ };
+	FrameArray<RenderInfo>& opaque_list = _frame->opaque_list;
+	FrameArray<RenderInfo>& translucent_list = _frame->translucent_list;
 
-	for (const auto& info : _render_list)
+	PROFILE_ZONE("Renderer::submit");
+	const auto start = std::chrono::steady_clock::now();
+	// deferred shading has no overdraw to show
+	if (_shading_mode == ShadingMode::Deferred && !_overdraw_view_enabled)
+		draw_deferred(opaque_list);
+	FrameArray<RenderInfo> prepass_list(_frame->arena);
+	if (_depth_prepass_enabled)
+		draw_depth_prepass(opaque_list, prepass_list);
+
+	begin_fragment_query();
 	{
-		if (info.first->get_material()->is_translucence())
-			translucent_list.emplace_back(info);
-		else
-			opaque_list.emplace_back(info);
+		PROFILE_GPU_ZONE("Renderer::opaque_pass");
+		_depth_prepassed = true;
+		draw_render_list(prepass_list);
+		_depth_prepassed = false;
+		draw_render_list(opaque_list);
 	}
-	const auto camera_pos = Engine::get_singleton().get_camera()->get_position();
-	std::sort(translucent_list.begin(), translucent_list.end(), [=](RenderInfo& lhs, RenderInfo& rhs)
 	{
-		const auto lpos = Vector3(lhs.second[3]);
-		const auto rpos = Vector3(rhs.second[3]);
-		const auto llen = distance_sqr(camera_pos, lpos);
-		const auto rlen = distance_sqr(camera_pos, rpos);
-		return llen > rlen;
-	});
-	draw_render_list(opaque_list);
-	draw_render_list(translucent_list);
+		PROFILE_GPU_ZONE("Renderer::translucent_pass");
+		draw_render_list(translucent_list);
+	}
+	end_fragment_query();
+	_frame_stats.submit_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	_frame_stats.arena_bytes = _frame->arena.get_stats().used;
 
 	// TODO swap buffer
 }
 
-void Renderer::draw_render_list(const std::vector<RenderInfo>& render_list)
+// Opaque draws are grouped by program and material to save state changes, and go front to back within
+// a group so the depth test rejects more of the later fragments. Translucent draws go back to front.
+// Distances are those of the world bounds, quantized to 16 bits over the camera range.
+void Renderer::sort_render_list(FrameSnapshot& frame)
+{
+	PROFILE_ZONE("Renderer::sort_render_list");
+	const auto start = std::chrono::steady_clock::now();
+	const Vector3 camera_position = frame.camera.get_position();
+	const float depth_scale = 65535.0f / frame.camera.get_far();
+	const FrameArray<RenderInfo>& render_list = frame.render_list;
+
+	// sort keys and render list indices, with the scratch arrays of the radix sort
+	FrameArena& arena = frame.arena;
+	const size_t count = render_list.size();
+	uint64_t* opaque_keys = arena.allocate<uint64_t>(count);
+	uint32_t* opaque_order = arena.allocate<uint32_t>(count);
+	uint64_t* translucent_keys = arena.allocate<uint64_t>(count);
+	uint32_t* translucent_order = arena.allocate<uint32_t>(count);
+	uint64_t* key_scratch = arena.allocate<uint64_t>(count);
+	uint32_t* order_scratch = arena.allocate<uint32_t>(count);
+	size_t opaque_count = 0;
+	size_t translucent_count = 0;
+	BucketTable shader_buckets(arena, count);
+	BucketTable material_buckets(arena, count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const RenderInfo& info = render_list[i];
+		const Material* material = info.mesh->get_material();
+		const uint64_t depth = (uint64_t)glm::clamp(glm::distance(camera_position, info.bound_center) * depth_scale, 0.0f, 65535.0f);
+		if (material->is_translucence())
+		{
+			translucent_keys[translucent_count] = 0xFFFF - depth;
+			translucent_order[translucent_count++] = (uint32_t)i;
+		}
+		else
+		{
+			// numbered in order of appearance, the key has 16 bits for each
+			const uint64_t shader = shader_buckets.get(material->get_shader());
+			const uint64_t bucket = material_buckets.get(material);
+			opaque_keys[opaque_count] = std::min<uint64_t>(shader, 0xFFFF) << 32 | std::min<uint64_t>(bucket, 0xFFFF) << 16 | depth;
+			opaque_order[opaque_count++] = (uint32_t)i;
+		}
+	}
+	radix_sort(opaque_keys, opaque_order, opaque_count, key_scratch, order_scratch);
+	radix_sort(translucent_keys, translucent_order, translucent_count, key_scratch, order_scratch);
+
+	frame.opaque_list.clear();
+	frame.opaque_list.reserve(opaque_count);
+	for (size_t i = 0; i < opaque_count; ++i)
+	{
+		frame.opaque_list.push_back(render_list[opaque_order[i]]);
+	}
+	frame.translucent_list.clear();
+	frame.translucent_list.reserve(translucent_count);
+	for (size_t i = 0; i < translucent_count; ++i)
+	{
+		frame.translucent_list.push_back(render_list[translucent_order[i]]);
+	}
+
+	frame.stats.sort_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// draws the opaque meshes that support it into the G-buffer and shades them, leaving the others in
+// opaque_list for the forward pass
+bool Renderer::draw_deferred(FrameArray<RenderInfo>& opaque_list)
+{
+	PROFILE_GPU_ZONE("Renderer::draw_deferred");
+	ShaderProgram* lighting = ShaderManager::get_singleton().get_program(DEFERRED_LIGHTING_PROGRAM);
+	if (!lighting || !lighting->valid() || !_gbuffer.resize(_frame->viewport_width, _frame->viewport_height))
+		return false;
+
+	// draw handlers rely on the stencil of the default framebuffer
+	FrameArray<RenderInfo> gbuffer_list(_frame->arena);
+	gbuffer_list.reserve(opaque_list.size());
+	size_t count = 0;
+	for (const auto& info : opaque_list)
+	{
+		if (info.mesh->get_material()->supports_deferred() && !info.mesh->get_pre_draw_handler() && !info.mesh->get_post_draw_handler())
+			gbuffer_list.push_back(info);
+		else
+			opaque_list[count++] = info;
+	}
+	opaque_list.resize(count);
+
+	_gbuffer.bind();
+	CHECK_GL_ERROR(glDepthMask(GL_TRUE));
+	CHECK_GL_ERROR(glStencilMask(0xFF));
+	CHECK_GL_ERROR(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+	CHECK_GL_ERROR(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
+	const unsigned int draw_calls = _frame_stats.draw_calls;
+	_gbuffer_pass = true;
+	draw_render_list(gbuffer_list);
+	_gbuffer_pass = false;
+	_frame_stats.gbuffer_draw_calls = _frame_stats.draw_calls - draw_calls;
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, _target_framebuffer));
+
+	// every covered pixel is shaded once, whatever the overdraw of the geometry pass
+	const Camera& camera = _frame->camera;
+	CHECK_GL_ERROR(glDisable(GL_DEPTH_TEST));
+	CHECK_GL_ERROR(glDisable(GL_BLEND));
+	CHECK_GL_ERROR(glDisable(GL_CULL_FACE));
+	lighting->bind();
+	bind_shader_data(*lighting);
+	_gbuffer.bind_textures(*lighting, 0);
+	lighting->set_vector2("viewport_size", Vector2((float)_frame->viewport_width, (float)_frame->viewport_height));
+	lighting->set_matrix4("inverse_view_projection", glm::inverse(camera.get_projection_matrix() * camera.get_view_matrix()));
+	if (!_fullscreen_vao)
+		CHECK_GL_ERROR(glGenVertexArrays(1, &_fullscreen_vao));
+	CHECK_GL_ERROR(glBindVertexArray(_fullscreen_vao));
+	CHECK_GL_ERROR(glDrawArrays(GL_TRIANGLES, 0, 3));
+	CHECK_GL_ERROR(glBindVertexArray(0));
+	++_frame_stats.draw_calls;
+
+	// forward meshes test against the depth of the deferred ones
+	_gbuffer.blit_depth(_target_framebuffer);
+	return true;
+}
+
+// moves the opaque meshes that support it to prepass_list and draws their depth
+void Renderer::draw_depth_prepass(FrameArray<RenderInfo>& opaque_list, FrameArray<RenderInfo>& prepass_list)
+{
+	PROFILE_GPU_ZONE("Renderer::draw_depth_prepass");
+	ShaderProgram* depth = ShaderManager::get_singleton().get_program(DEPTH_PROGRAM);
+	if (!depth || !depth->valid())
+		return;
+
+	prepass_list.reserve(opaque_list.size());
+	size_t count = 0;
+	for (const auto& info : opaque_list)
+	{
+		const Mesh* mesh = info.mesh;
+		if (mesh->get_material()->supports_depth_prepass() && mesh->has_position_stream() && !mesh->get_pre_draw_handler() && !mesh->get_post_draw_handler())
+			prepass_list.push_back(info);
+		else
+			opaque_list[count++] = info;
+	}
+	opaque_list.resize(count);
+
+	const Camera& camera = _frame->camera;
+	depth->bind();
+	depth->set_matrix4("projection", camera.get_projection_matrix());
+	depth->set_matrix4("view", camera.get_view_matrix());
+	CHECK_GL_ERROR(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+	for (const auto& info : prepass_list)
+	{
+		info.mesh->get_material()->apply_render_state();
+		draw_positions(*depth, info);
+	}
+	CHECK_GL_ERROR(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+	depth->unbind();
+	_frame_stats.depth_prepass_draw_calls = (unsigned int)prepass_list.size();
+}
+
+void Renderer::draw_overdraw(const FrameArray<RenderInfo>& render_list)
+{
+	ShaderProgram* overdraw = ShaderManager::get_singleton().get_program(OVERDRAW_PROGRAM);
+	if (!overdraw || !overdraw->valid())
+		return;
+
+	const Camera& camera = _frame->camera;
+	overdraw->bind();
+	overdraw->set_matrix4("projection", camera.get_projection_matrix());
+	overdraw->set_matrix4("view", camera.get_view_matrix());
+	for (const auto& info : render_list)
+	{
+		if (!info.mesh->has_position_stream())
+			continue;
+		// the depth state of the material decides which fragments are shaded, blending counts them
+		info.mesh->get_material()->apply_render_state();
+		CHECK_GL_ERROR(glEnable(GL_BLEND));
+		CHECK_GL_ERROR(glBlendFunc(GL_ONE, GL_ONE));
+		draw_positions(*overdraw, info);
+		++_frame_stats.draw_calls;
+	}
+	overdraw->unbind();
+}
+
+void Renderer::draw_positions(const ShaderProgram& shader, const RenderInfo& info)
+{
+	shader.set_matrix4("model", info.model);
+	if (info.range_count > 0)
+		info.mesh->draw_position_ranges(&_frame->cluster_ranges.counts[info.first_range], &_frame->cluster_ranges.offsets[info.first_range], info.range_count);
+	else
+		info.mesh->draw_positions(info.lod);
+}
+
+void Renderer::begin_fragment_query()
+{
+	if (!_fragment_queries[0])
+		CHECK_GL_ERROR(glGenQueries(2, _fragment_queries));
+
+	// the query of the frame before last is done unless the GPU runs more than a frame behind, reading
+	// it does not stall and an unfinished one is skipped
+	const unsigned int query = _fragment_queries[_fragment_query_index];
+	if (_fragment_query_pending[_fragment_query_index])
+	{
+		GLuint available = 0;
+		CHECK_GL_ERROR(glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available));
+		if (available)
+		{
+			GLuint samples = 0;
+			CHECK_GL_ERROR(glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples));
+			_shaded_fragments = samples;
+		}
+	}
+	CHECK_GL_ERROR(glBeginQuery(GL_SAMPLES_PASSED, query));
+}
+
+void Renderer::end_fragment_query()
+{
+	CHECK_GL_ERROR(glEndQuery(GL_SAMPLES_PASSED));
+	_fragment_query_pending[_fragment_query_index] = true;
+	_fragment_query_index ^= 1;
+
+	_frame_stats.shaded_fragments = _shaded_fragments;
+	_frame_stats.shaded_fragments_per_pixel = (float)_shaded_fragments / std::max(_frame->viewport_width * _frame->viewport_height, 1);
+}
+
+void Renderer::draw_render_list(const FrameArray<RenderInfo>& render_list)
 {
+	if (_overdraw_view_enabled)
+	{
+		draw_overdraw(render_list);
+		return;
+	}
+	if (render_list.empty())
+	{
+		return;
+	}
+
+	// the variants are looked up here since they may wait for a link, recording only reads them
+	const Material* last_material = nullptr;
+	const Mesh* last_mesh = nullptr;
 	for (const auto& info : render_list)
 	{
-		auto* mesh = info.first;
-		auto model = info.second;
+		auto* mesh = info.mesh;
+		if (mesh->get_material() != last_material)
+		{
+			last_material = mesh->get_material();
+			last_material->get_variant_shader();
+			++_frame_stats.material_changes;
+		}
+		if (mesh != last_mesh)
+		{
+			last_mesh = mesh;
+			++_frame_stats.mesh_changes;
+		}
+		if (info.range_count > 0)
+		{
+			for (unsigned int i = 0; i < info.range_count; ++i)
+			{
+				_frame_stats.triangles += _frame->cluster_ranges.counts[info.first_range + i] / 3;
+			}
+		}
+		else
+		{
+			_frame_stats.triangles += mesh->get_triangle_count(info.lod);
+		}
+		++_frame_stats.draw_calls;
+	}
+
+	// the chunks are recorded in parallel and replayed in order on this thread
+	const size_t chunk_count = (render_list.size() + COMMAND_CHUNK_SIZE - 1) / COMMAND_CHUNK_SIZE;
+	if (_command_buffers.size() < chunk_count)
+	{
+		_command_buffers.resize(chunk_count);
+	}
+	const auto record_chunk = [this, &render_list](size_t chunk)
+	{
+		const size_t begin = chunk * COMMAND_CHUNK_SIZE;
+		const size_t end = std::min(begin + COMMAND_CHUNK_SIZE, render_list.size());
+		record_commands(render_list.data() + begin, render_list.data() + end, _command_buffers[chunk]);
+	};
+	{
+		PROFILE_ZONE("Renderer::record_commands");
+		JobSystem* job_system = JobSystem::get_singletonPtr();
+		if (job_system && chunk_count > 1)
+		{
+			job_system->parallel_for(chunk_count, record_chunk);
+		}
+		else
+		{
+			for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+				record_chunk(chunk);
+		}
+	}
+	replay_commands(chunk_count);
+}
+
+void Renderer::record_commands(const RenderInfo* begin, const RenderInfo* end, RenderCommandBuffer& buffer) const
+{
+	buffer.clear();
+	// what the commands so far leave bound, only commands changing it are recorded
+	const Material* material = nullptr;
+	const ShaderProgram* program = nullptr;
+	uint32_t texture_layout = 0;
+	RenderState render_state = 0;
+	bool has_render_state = false;
+	for (const RenderInfo* info = begin; info != end; ++info)
+	{
+		Mesh* mesh = info->mesh;
 		if (const auto handler = mesh->get_pre_draw_handler())
 		{
-			(*handler)(*mesh, model);
+			buffer.call_handler(handler, mesh, &info->model);
+			material = nullptr;
+			program = nullptr;
+			has_render_state = false;
+		}
+		if (mesh->get_material() != material)
+		{
+			material = mesh->get_material();
+			const RenderState state = material->get_render_state(_depth_prepassed);
+			if (!has_render_state || state != render_state)
+			{
+				buffer.set_render_state(state);
+				render_state = state;
+				has_render_state = true;
+			}
+			// the samplers set for the last material hold for one with the same texture counts
+			ShaderProgram* shader = material->get_resolved_shader();
+			const uint32_t layout = material->get_texture_layout();
+			if (shader != program || layout != texture_layout)
+			{
+				buffer.bind_program(shader, material);
+				program = shader;
+				texture_layout = layout;
+			}
+			material->record_textures(buffer);
+		}
+		if (info->range_count > 0)
+		{
+			mesh->record_draw_ranges(buffer, info->model, &_frame->cluster_ranges.counts[info->first_range], &_frame->cluster_ranges.offsets[info->first_range], info->range_count);
+		}
+		else
+		{
+			mesh->record_draw(buffer, info->model, info->lod);
 		}
-		mesh->draw(model);
 		if (const auto handler = mesh->get_post_draw_handler())
 		{
-			(*handler)(*mesh, model);
+			buffer.call_handler(handler, mesh, &info->model);
+			material = nullptr;
+			program = nullptr;
+			has_render_state = false;
 		}
 	}
 }
 
-void Renderer::draw(float delta)
+void Renderer::replay_commands(size_t buffer_count)
 {
-	begin_frame(delta);
+	PROFILE_ZONE("Renderer::replay_commands");
+	const ShaderProgram* program = nullptr;
+	int model_location = -1;
+	unsigned int vao = 0;
+	for (size_t i = 0; i < buffer_count; ++i)
+	{
+		for (const RenderCommand& command : _command_buffers[i].get_commands())
+		{
+			switch (command.type)
+			{
+			case RenderCommand::Type::BindProgram:
+			{
+				ShaderProgram& shader = *command.bind_program.program;
+				shader.bind();
+				bind_shader_data(shader);
+				command.bind_program.material->bind_samplers(shader);
+				program = &shader;
+				model_location = shader.get_uniform_location("model");
+				break;
+			}
+			case RenderCommand::Type::SetRenderState:
+				Material::apply_render_state(command.render_state);
+				break;
+			case RenderCommand::Type::BindTexture:
+				CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + command.bind_texture.unit));
+				CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, command.bind_texture.texture));
+				break;
+			case RenderCommand::Type::Draw:
+			{
+				const auto& draw = command.draw;
+				program->set_matrix4(model_location, *draw.model);
+				if (draw.vao != vao)
+				{
+					vao = draw.vao;
+					CHECK_GL_ERROR(glBindVertexArray(vao));
+				}
+				if (draw.indexed)
+				{
+					CHECK_GL_ERROR(glDrawElements(GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, (void*)(draw.first * sizeof(unsigned int))));
+				}
+				else
+				{
+					CHECK_GL_ERROR(glDrawArrays(GL_TRIANGLES, draw.first, draw.count));
+				}
+				break;
+			}
+			case RenderCommand::Type::DrawRanges:
+			{
+				const auto& draw = command.draw_ranges;
+				program->set_matrix4(model_location, *draw.model);
+				if (draw.vao != vao)
+				{
+					vao = draw.vao;
+					CHECK_GL_ERROR(glBindVertexArray(vao));
+				}
+				CHECK_GL_ERROR(glMultiDrawElements(GL_TRIANGLES, draw.counts, GL_UNSIGNED_INT, draw.offsets, draw.range_count));
+				break;
+			}
+			case RenderCommand::Type::CallHandler:
+			{
+				// handlers ran between the draws of meshes, which left nothing bound
+				CHECK_GL_ERROR(glBindVertexArray(0));
+				CHECK_GL_ERROR(glUseProgram(0));
+				program = nullptr;
+				const auto& call = command.call_handler;
+				(*call.handler)(*call.mesh, *call.model);
+				// the recording binds a program again, but the vertex array is unknown
+				vao = ~0u;
+				break;
+			}
+			default:
+				assert(false);
+				break;
+			}
+		}
+	}
+	CHECK_GL_ERROR(glBindVertexArray(0));
+	CHECK_GL_ERROR(glUseProgram(0));
+}
+
+void Renderer::prepare_frame(unsigned int snapshot)
+{
+	PROFILE_ZONE("Renderer::prepare_frame");
+	FrameSnapshot& frame = _snapshots[snapshot];
+	frame.stats = FrameStats();
+	// the render thread is done with the frame submitted from this snapshot before
+	frame.arena.reset();
 
 	const auto* camera = Engine::get_singleton().get_camera();
-	_spot_lights[0].spot.position = camera->get_position();
-	_spot_lights[0].spot.direction = camera->get_forward();
+	if (_camera_spot_light >= 0 && (size_t)_camera_spot_light < _spot_lights.size())
+	{
+		_spot_lights[_camera_spot_light].spot.position = camera->get_position();
+		_spot_lights[_camera_spot_light].spot.direction = camera->get_forward();
+	}
+	frame.camera = *camera;
+	frame.viewport_width = _viewport_width;
+	frame.viewport_height = _viewport_height;
+	frame.directional_light = _directional_light;
+	frame.omni_lights = _omni_lights;
+	frame.spot_lights = _spot_lights;
+	frame.invalidate_static_shadows = _static_shadows_invalid;
+	_static_shadows_invalid = false;
 
-	for (auto model : _models)
+	// pixels covered by one unit at distance one
+	_lod_projection_scale = _viewport_height * 0.5f / tan(glm::radians(camera->get_fov()) * 0.5f);
+	_lod_view_position = camera->get_position();
+
+	{
+		PROFILE_ZONE("Renderer::build_render_list");
+		frame.render_list.clear();
+		for (auto model : _models)
+		{
+			model->draw(frame.render_list);
+		}
+	}
+	// casters out of the view still cast shadows into it
+	frame.shadow_casters.clear();
+	if (_shadows_enabled)
 	{
-		model->draw(_render_list);
+		for (const auto& info : frame.render_list)
+		{
+			const Mesh* mesh = info.mesh;
+			if (mesh->get_material()->casts_shadows() && mesh->has_position_stream())
+				frame.shadow_casters.push_back({ mesh, info.model, info.lod, info.bound_center, info.bound_radius, info.is_static });
+		}
 	}
+	cull_clusters(frame);
+	if (uses_light_grid())
+		assign_lights(frame);
+	sort_render_list(frame);
+}
+
+void Renderer::submit_frame(unsigned int snapshot)
+{
+	_frame = &_snapshots[snapshot];
+	// every GPU zone of the frame comes after
+	_gpu_profiler.begin_frame();
+	PROFILE_GPU_ZONE("Renderer::submit_frame");
+	begin_frame();
+
+	if (_frame->invalidate_static_shadows)
+		_shadow_renderer.invalidate_static();
+	if (_shadows_enabled)
+		render_shadows();
+	if (uses_light_grid())
+		upload_light_grid();
+
+	end_frame();
+}
+
+void Renderer::cull_clusters(FrameSnapshot& frame)
+{
+	PROFILE_ZONE("Renderer::cull_clusters");
+	frame.cluster_ranges.clear();
+	if (!_cluster_culling_enabled)
+		return;
+
+	const auto start = std::chrono::steady_clock::now();
+	const Matrix4 view_projection = frame.camera.get_projection_matrix() * frame.camera.get_view_matrix();
+	const Vector4 camera_position(frame.camera.get_position(), 1.0f);
+
+	FrameArray<RenderInfo>& render_list = frame.render_list;
+	size_t count = 0;
+	for (const auto& render_info : render_list)
+	{
+		RenderInfo info = render_info;
+		const MeshClusters& clusters = info.mesh->get_clusters();
+		if (info.lod == 0 && !clusters.empty())
+		{
+			// cull in model space, which assumes a uniform scale
+			Vector4 planes[6];
+			MeshClusters::extract_frustum_planes(view_projection * info.model, planes);
+			const Vector3 view_position = Vector3(glm::inverse(info.model) * camera_position);
+			const Material* material = info.mesh->get_material();
+			const bool cull_back_faces = material->get_cull_face_type() == CullFaceType::BACK && !material->get_clockwise_winding_order();
+
+			info.first_range = (unsigned int)frame.cluster_ranges.size();
+			const size_t visible_triangles = clusters.cull(planes, view_position, cull_back_faces, frame.cluster_ranges);
+			info.range_count = (unsigned int)(frame.cluster_ranges.size() - info.first_range);
+
+			frame.stats.clusters_tested += clusters.size();
+			frame.stats.cluster_culled_triangles += info.mesh->get_triangle_count(0) - visible_triangles;
+			if (info.range_count == 0)
+				continue;
+		}
+		render_list[count++] = info;
+	}
+	render_list.resize(count);
+
+	frame.stats.cluster_cull_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Renderer::render_shadows()
+{
+	PROFILE_GPU_ZONE("Renderer::render_shadows");
+	ShaderProgram* depth = ShaderManager::get_singleton().get_program(DEPTH_PROGRAM);
+	if (!depth || !depth->valid())
+		return;
 
-	end_frame(true);
+	const auto start = std::chrono::steady_clock::now();
+	_shadow_renderer.render(*depth, _frame->shadow_casters, _frame->camera, _frame->directional_light, _frame->omni_lights, _frame->spot_lights);
+
+	const auto& stats = _shadow_renderer.get_stats();
+	_frame_stats.shadow_draw_calls = stats.local_draw_calls;
+	for (unsigned int i = 0; i < ShadowRenderer::CASCADE_COUNT; ++i)
+	{
+		_frame_stats.shadow_draw_calls += stats.cascade_draw_calls[i];
+	}
+	_frame_stats.shadow_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Renderer::assign_lights(FrameSnapshot& frame)
+{
+	PROFILE_ZONE("Renderer::assign_lights");
+	const Camera& camera = frame.camera;
+	frame.light_grid.update(camera.get_view_matrix(), glm::radians(camera.get_fov()), camera.get_aspect(), camera.get_near(), camera.get_far(),
+		frame.omni_lights, frame.spot_lights);
+	frame.stats.light_indices = frame.light_grid.get_stats().light_indices;
+	frame.stats.light_assign_ms = frame.light_grid.get_stats().assign_ms;
+}
+
+void Renderer::upload_light_grid()
+{
+	PROFILE_ZONE("Renderer::upload_light_grid");
+	const LightGrid& light_grid = _frame->light_grid;
+	const std::vector<Light>& omni_lights = _frame->omni_lights;
+	const std::vector<Light>& spot_lights = _frame->spot_lights;
+
+	// the first shadow view of each light, -1 without shadow
+	const auto& omni_views = _shadow_renderer.get_omni_views();
+	const auto& spot_views = _shadow_renderer.get_spot_views();
+	// buffer textures can not be empty
+	const size_t light_data_size = std::max<size_t>(omni_lights.size() * 4 + spot_lights.size() * 6, 1);
+	Vector4* light_data = _frame->arena.allocate<Vector4>(light_data_size);
+	light_data[0] = Vector4(0.0f);
+	size_t light_data_count = 0;
+	for (size_t i = 0; i < omni_lights.size(); ++i)
+	{
+		const Light& light = omni_lights[i];
+		light_data[light_data_count++] = Vector4(light.omni.position, light.omni.constant);
+		light_data[light_data_count++] = Vector4(light.ambient, light.omni.linear);
+		light_data[light_data_count++] = Vector4(light.diffuse, light.omni.quadratic);
+		light_data[light_data_count++] = Vector4(light.specular, i < omni_views.size() ? (float)omni_views[i] : -1.0f);
+	}
+	for (size_t i = 0; i < spot_lights.size(); ++i)
+	{
+		const Light& light = spot_lights[i];
+		light_data[light_data_count++] = Vector4(light.spot.position, light.spot.constant);
+		light_data[light_data_count++] = Vector4(light.ambient, light.spot.linear);
+		light_data[light_data_count++] = Vector4(light.diffuse, light.spot.quadratic);
+		light_data[light_data_count++] = Vector4(light.specular, light.spot.outerCutOff);
+		light_data[light_data_count++] = Vector4(light.spot.direction, light.spot.innerCutOff);
+		light_data[light_data_count++] = Vector4(i < spot_views.size() ? (float)spot_views[i] : -1.0f, 0.0f, 0.0f, 0.0f);
+	}
+	const std::vector<uint32_t>& indices = light_grid.get_light_indices();
+	const uint32_t no_index = 0;
+	const void* data[] = { light_data, light_grid.get_clusters().data(), indices.empty() ? &no_index : indices.data() };
+	const size_t sizes[] = { light_data_size * sizeof(Vector4), light_grid.get_clusters().size() * sizeof(LightGrid::Cluster),
+		std::max<size_t>(indices.size(), 1) * sizeof(uint32_t) };
+
+	if (!_light_buffers[0])
+	{
+		CHECK_GL_ERROR(glGenBuffers(3, _light_buffers));
+		CHECK_GL_ERROR(glGenTextures(3, _light_textures));
+	}
+	for (int i = 0; i < 3; ++i)
+	{
+		CHECK_GL_ERROR(glBindBuffer(GL_TEXTURE_BUFFER, _light_buffers[i]));
+		CHECK_GL_ERROR(glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW));
+		CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT + i));
+		CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_BUFFER, _light_textures[i]));
+		CHECK_GL_ERROR(glTexBuffer(GL_TEXTURE_BUFFER, LIGHT_TEXTURE_FORMATS[i], _light_buffers[i]));
+	}
+	CHECK_GL_ERROR(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0));
+}
+
+void Renderer::bind_light_grid(ShaderProgram& shader) const
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		shader.set_int(LIGHT_TEXTURE_NAMES[i], LIGHT_TEXTURE_UNIT + i);
+	}
+	shader.set_int("spot_light_base", (int)_frame->omni_lights.size() * 4);
+	shader.set_vector3("light_grid_size", (float)LightGrid::TILES_X, (float)LightGrid::TILES_Y, (float)LightGrid::SLICES);
+	shader.set_vector2("light_grid_scale", Vector2((float)LightGrid::TILES_X / _frame->viewport_width, (float)LightGrid::TILES_Y / _frame->viewport_height));
+	shader.set_vector2("light_grid_slice", Vector2(_frame->light_grid.get_slice_scale(), _frame->light_grid.get_slice_bias()));
+}
+
+FrameArena::Stats Renderer::get_arena_stats() const
+{
+	FrameArena::Stats stats{ };
+	for (const auto& snapshot : _snapshots)
+	{
+		const FrameArena::Stats& arena = snapshot.arena.get_stats();
+		stats.used = std::max(stats.used, arena.used);
+		stats.peak = std::max(stats.peak, arena.peak);
+		stats.capacity += arena.capacity;
+		stats.heap_allocations += arena.heap_allocations;
+	}
+	return stats;
+}
+
+unsigned int Renderer::select_lod(const Mesh& mesh, const Matrix4& model, unsigned int current_lod) const
+{
+	const size_t lod_count = mesh.get_lod_count();
+	if (!_lod_enabled || lod_count <= 1)
+		return 0;
+
+	const Vector3 center = Vector3(model * Vector4(mesh.get_bound_center(), 1.0f));
+	const float scale = std::max(std::max(glm::length(Vector3(model[0])), glm::length(Vector3(model[1]))), glm::length(Vector3(model[2])));
+	const float radius = mesh.get_bound_radius() * scale;
+	const float dist = std::max(glm::distance(center, _lod_view_position) - radius, 1e-4f);
+
+	// lod errors are relative to the mesh extent, which the bounding diameter approximates
+	const float screen_size = radius * 2.0f * _lod_projection_scale / dist;
+	const auto projected_error = [&](unsigned int lod) { return mesh.get_lod(lod).error * screen_size; };
+
+	unsigned int lod = 0;
+	while (lod + 1 < lod_count && projected_error(lod + 1) <= _lod_error_threshold)
+		++lod;
+
+	// switching needs a margin around the threshold so objects near it do not pop back and forth
+	current_lod = std::min<unsigned int>(current_lod, lod_count - 1);
+	if (lod > current_lod)
+	{
+		while (lod > current_lod && projected_error(lod) > _lod_error_threshold * (1.0f - _lod_hysteresis))
+			--lod;
+	}
+	else if (lod < current_lod && projected_error(current_lod) <= _lod_error_threshold * (1.0f + _lod_hysteresis))
+	{
+		lod = current_lod;
+	}
+	return lod;
 }
 
 void Renderer::bind_shader_data(ShaderProgram& shader) const
 {
-	const auto camera = Engine::get_singleton().get_camera();
-	shader.set_vector3("viewPos", camera->get_position());
-	shader.set_matrix4("projection", camera->get_projection_matrix());
-	shader.set_matrix4("view", camera->get_view_matrix());
-	shader.set_float("camera_near", camera->get_near());
-	shader.set_float("camera_far", camera->get_far());
+	const Camera& camera = _frame->camera;
+	shader.set_vector3("viewPos", camera.get_position());
+	shader.set_matrix4("projection", camera.get_projection_matrix());
+	shader.set_matrix4("view", camera.get_view_matrix());
+	shader.set_float("camera_near", camera.get_near());
+	shader.set_float("camera_far", camera.get_far());
 
-	_directional_light.bind(shader, "directional_light");
+	_frame->directional_light.bind(shader, "directional_light");
+	// the samplers get their units even without shadows, see ShadowRenderer::bind
+	_shadow_renderer.bind(shader, SHADOW_TEXTURE_UNIT);
 
-	for (size_t i = 0; i < _omni_lights.size(); ++i)
+	if (uses_light_grid())
 	{
-		_omni_lights[i].bind(shader, "omni_lights[" + std::to_string(i) + "]");
+		bind_light_grid(shader);
+		return;
+	}
+	char name[32];
+	for (size_t i = 0; i < _frame->omni_lights.size(); ++i)
+	{
+		snprintf(name, sizeof(name), "omni_lights[%zu]", i);
+		_frame->omni_lights[i].bind(shader, name);
 	}
-	shader.set_int("omni_light_count", (int)_omni_lights.size());
 
-	for (size_t i = 0; i < _spot_lights.size(); ++i)
+	for (size_t i = 0; i < _frame->spot_lights.size(); ++i)
 	{
-		_spot_lights[i].bind(shader, "spot_lights[" + std::to_string(i) + "]");
+		snprintf(name, sizeof(name), "spot_lights[%zu]", i);
+		_frame->spot_lights[i].bind(shader, name);
 	}
-	shader.set_int("spot_light_count", (int)_spot_lights.size());
 }
 
 void Renderer::cleanup()
@@ -108,4 +841,25 @@ void Renderer::cleanup()
 		delete model;
 	}
 	_models.clear();
+
+	if (_light_buffers[0])
+	{
+		CHECK_GL_ERROR(glDeleteTextures(3, _light_textures));
+		CHECK_GL_ERROR(glDeleteBuffers(3, _light_buffers));
+		_light_buffers[0] = 0;
+	}
+	if (_fullscreen_vao)
+	{
+		CHECK_GL_ERROR(glDeleteVertexArrays(1, &_fullscreen_vao));
+		_fullscreen_vao = 0;
+	}
+	_gbuffer.release();
+	_shadow_renderer.release();
+	_gpu_profiler.release();
+	if (_fragment_queries[0])
+	{
+		CHECK_GL_ERROR(glDeleteQueries(2, _fragment_queries));
+		_fragment_queries[0] = 0;
+		_fragment_query_pending[0] = _fragment_query_pending[1] = false;
+	}
 }
@@ -3,12 +3,25 @@
 #include "common/singleton.h"
 #include <vector>
 #include "shader.h"
-#include "light.h"
+#include "Light.h"
 #include <set>
 #include "mesh.h"
+#include "light_grid.h"
+#include "gbuffer.h"
+#include "shadow_renderer.h"
+#include "gpu_profiler.h"
+#include "render_command_buffer.h"
+#include "engine/camera.h"
+#include "common/frame_arena.h"
 
 class Model;
 
+enum class ShadingMode : unsigned int
+{
+	Forward,
+	Deferred	// opaque meshes go through the G-buffer, translucent and custom drawn meshes stay forward
+};
+
 class Renderer : public Singleton<Renderer>
 {
 public:
@@ -20,31 +33,168 @@ public:
 	Renderer& operator=(const Renderer&) = delete;
 	Renderer& operator=(Renderer&&) = delete;
 
-	void draw(float delta);
 	void set_clear_color(Color color) { _clear_color = color; }
 	Color get_clear_color() const { return _clear_color; }
 
 	void add_model(Model* model) { _models.emplace(model); }
 
+	void set_viewport_size(int width, int height) { _viewport_width = width; _viewport_height = height; }
+	int get_viewport_width() const { return _viewport_width; }
+	int get_viewport_height() const { return _viewport_height; }
+	// the framebuffer frames are drawn into, 0 for the default one of the window
+	void set_target_framebuffer(unsigned int framebuffer) { _target_framebuffer = framebuffer; }
+	unsigned int get_target_framebuffer() const { return _target_framebuffer; }
+
+	// level of detail is chosen by the projected simplification error, in pixels
+	void set_lod_enabled(bool enabled) { _lod_enabled = enabled; }
+	bool is_lod_enabled() const { return _lod_enabled; }
+	void set_lod_error_threshold(float pixels) { _lod_error_threshold = pixels; }
+	float get_lod_error_threshold() const { return _lod_error_threshold; }
+	void set_lod_hysteresis(float ratio) { _lod_hysteresis = ratio; }
+	float get_lod_hysteresis() const { return _lod_hysteresis; }
+	unsigned int select_lod(const Mesh& mesh, const Matrix4& model, unsigned int current_lod) const;
+
+	void set_cluster_culling_enabled(bool enabled) { _cluster_culling_enabled = enabled; }
+	bool is_cluster_culling_enabled() const { return _cluster_culling_enabled; }
+
 	Light& get_directional_light() { return _directional_light; }
 	//void set_directional_light(const Light& light) { assert(light.type == LightType::Directional); _directional_light = light; }
 	void add_omni_light(Light light) { assert(light.type == LightType::Omni); _omni_lights.push_back(light); }
 	const std::vector<Light>& get_omni_lights() const { return _omni_lights; }
 	void add_spot_light(Light light) { assert(light.type == LightType::Spot); _spot_lights.push_back(light); }
 	const std::vector<Light>& get_spot_lights() const { return _spot_lights; }
+	// the spot light that follows the camera like a flashlight, -1 for none
+	void set_camera_spot_light(int index) { _camera_spot_light = index; }
+
+	// omni and spot lights are assigned to view froxels every frame, fragments only shade the lights of their froxel
+	void set_clustered_lighting_enabled(bool enabled) { _clustered_lighting_enabled = enabled; }
+	bool is_clustered_lighting_enabled() const { return _clustered_lighting_enabled; }
+	const LightGrid& get_light_grid() const { return _frame->light_grid; }
+	// deferred shading always reads the lights from the grid
+	bool uses_light_grid() const { return _clustered_lighting_enabled || _shading_mode == ShadingMode::Deferred; }
+
+	// chosen at startup, deferred needs the deferred_lighting program
+	void set_shading_mode(ShadingMode mode) { _shading_mode = mode; }
+	ShadingMode get_shading_mode() const { return _shading_mode; }
+	// materials draw their G-buffer variant while set
+	bool is_gbuffer_pass() const { return _gbuffer_pass; }
+
+	// opaque meshes write their depth with a position only program first, then shade only the visible
+	// fragments with an LEQUAL test and no depth writes. Needs the depth program.
+	void set_depth_prepass_enabled(bool enabled) { _depth_prepass_enabled = enabled; }
+	bool is_depth_prepass_enabled() const { return _depth_prepass_enabled; }
+	// materials draw with the pre-pass depth state while set
+	bool is_depth_prepassed() const { return _depth_prepassed; }
+	// draws the number of fragments shaded in each pixel instead of the scene, needs the overdraw program
+	void set_overdraw_view_enabled(bool enabled) { _overdraw_view_enabled = enabled; }
+	bool is_overdraw_view_enabled() const { return _overdraw_view_enabled; }
+
+	// lights with cast_shadows get shadow maps, opaque meshes cast shadows unless their material does
+	// not. Needs the depth program.
+	void set_shadows_enabled(bool enabled) { _shadows_enabled = enabled; if (!enabled) _shadow_renderer.release(); }
+	bool is_shadows_enabled() const { return _shadows_enabled; }
+	const ShadowRenderer& get_shadow_renderer() const { return _shadow_renderer; }
+	// static models moved, were added or finished loading, their cached shadows are drawn again
+	void invalidate_static_shadows() { _static_shadows_invalid = true; }
 
 	void bind_shader_data(ShaderProgram& shader) const;
 
 	void cleanup();
 
-	typedef std::pair<Mesh*, Matrix4> RenderInfo;
+	struct RenderInfo
+	{
+		Mesh* mesh;
+		Matrix4 model;
+		unsigned int lod;
+		unsigned int first_range;	// visible cluster ranges, none means the whole lod
+		unsigned int range_count;
+		Vector3 bound_center;		// world space, the draws are sorted by its distance
+		float bound_radius;
+		bool is_static;				// its shadows are cached
+	};
+
+	struct FrameStats
+	{
+		unsigned int draw_calls;
+		size_t triangles;
+		size_t clusters_tested;
+		size_t cluster_culled_triangles;
+		float cluster_cull_ms;
+		size_t light_indices;
+		float light_assign_ms;
+		float sort_ms;
+		float submit_ms;		// the draws of every pass but the shadows
+		// between consecutive draws of a pass, what the sort keeps low
+		unsigned int material_changes;
+		unsigned int mesh_changes;
+		unsigned int gbuffer_draw_calls;
+		unsigned int depth_prepass_draw_calls;
+		// fragments passing the depth test in the forward color passes, from a query a frame behind
+		size_t shaded_fragments;
+		float shaded_fragments_per_pixel;
+		unsigned int shadow_draw_calls;
+		float shadow_ms;
+		size_t arena_bytes;		// of the frame arena, by the preparation and the submission
+	};
+	const FrameStats& get_frame_stats() const { return _frame_stats; }
+
+	// What the GL side of a frame reads, copied or built from the camera, the lights and the models by
+	// prepare_frame. Pipelined, the main thread prepares one snapshot while the render thread submits
+	// the other, each thread touching only its own. The draw lists and the other data living for the
+	// frame alone come from the arena of the snapshot, reset when the next frame is prepared in it.
+	struct FrameSnapshot
+	{
+		FrameSnapshot() : camera(45.0f, 1.0f, 0.1f, 100.0f, Vector3(0.0f), Vector3(0.0f, 0.0f, -1.0f)) { }
+
+		Camera camera;
+		int viewport_width{ 0 };
+		int viewport_height{ 0 };
+		Light directional_light{ };
+		std::vector<Light> omni_lights{ };
+		std::vector<Light> spot_lights{ };
+		FrameArena arena{ };
+		FrameArray<RenderInfo> render_list{ arena };		// after cluster culling, in model order
+		FrameArray<RenderInfo> opaque_list{ arena };		// sorted, the passes take their draws out
+		FrameArray<RenderInfo> translucent_list{ arena };
+		std::vector<ShadowCaster> shadow_casters{ };		// before culling, casters out of the view still cast shadows into it
+		ClusterRanges cluster_ranges{ };
+		LightGrid light_grid{ };
+		bool invalidate_static_shadows{ false };
+		FrameStats stats{ };							// of the preparation, submit_frame adds its own
+	};
+	static const unsigned int SNAPSHOT_COUNT = 2;
+	// builds the snapshot without any GL call, on the thread that owns the scene
+	void prepare_frame(unsigned int snapshot);
+	// draws a prepared snapshot, on the thread that owns the GL context
+	void submit_frame(unsigned int snapshot);
+	// the snapshot being submitted or submitted last
+	const FrameSnapshot& get_frame_snapshot() const { return *_frame; }
+	// over the arenas of every snapshot, the peak of the one used most and the capacity and blocks of all
+	FrameArena::Stats get_arena_stats() const;
+	// the GPU zones are timed while it is enabled or the CPU profiler captures
+	GpuProfiler& get_gpu_profiler() { return _gpu_profiler; }
 
 protected:
-	void begin_frame(float delta);
-	void end_frame(bool swap_buffer);
+	void begin_frame();
+	void end_frame();
 
 private:
-	void draw_render_list(const std::vector<RenderInfo>& render_list);
+	void cull_clusters(FrameSnapshot& frame);
+	void sort_render_list(FrameSnapshot& frame);
+	void draw_render_list(const FrameArray<RenderInfo>& render_list);
+	// thread safe once the variants of the materials are resolved
+	void record_commands(const RenderInfo* begin, const RenderInfo* end, RenderCommandBuffer& buffer) const;
+	void replay_commands(size_t buffer_count);
+	bool draw_deferred(FrameArray<RenderInfo>& opaque_list);
+	void draw_depth_prepass(FrameArray<RenderInfo>& opaque_list, FrameArray<RenderInfo>& prepass_list);
+	void draw_overdraw(const FrameArray<RenderInfo>& render_list);
+	void draw_positions(const ShaderProgram& shader, const RenderInfo& info);
+	void begin_fragment_query();
+	void end_fragment_query();
+	void render_shadows();
+	void assign_lights(FrameSnapshot& frame);
+	void upload_light_grid();
+	void bind_light_grid(ShaderProgram& shader) const;
 
 	Color _clear_color{ 0.2f, 0.3f, 0.3f, 1.0f };
 	std::set<Model*> _models{ };
@@ -52,5 +202,46 @@ private:
 	Light _directional_light{ };
 	std::vector<Light> _omni_lights{ };
 	std::vector<Light> _spot_lights{ };
-	std::vector<RenderInfo> _render_list{ };
+	int _camera_spot_light{ 0 };
+	FrameSnapshot _snapshots[SNAPSHOT_COUNT]{ };
+	FrameSnapshot* _frame{ &_snapshots[0] };
+	bool _static_shadows_invalid{ false };
+
+	int _viewport_width{ 800 };
+	int _viewport_height{ 600 };
+	unsigned int _target_framebuffer{ 0 };
+	bool _lod_enabled{ true };
+	float _lod_error_threshold{ 1.0f };
+	float _lod_hysteresis{ 0.25f };
+	float _lod_projection_scale{ 0.0f };
+	Vector3 _lod_view_position{ 0.0f, 0.0f, 0.0f };
+
+	bool _cluster_culling_enabled{ true };
+
+	// one a chunk of the render list being drawn, kept for their storage. Not in the frame arena, the
+	// chunks are recorded on several threads at once.
+	std::vector<RenderCommandBuffer> _command_buffers{ };
+
+	bool _clustered_lighting_enabled{ true };
+	unsigned int _light_buffers[3]{ };		// light data, clusters, light indices
+	unsigned int _light_textures[3]{ };
+
+	ShadingMode _shading_mode{ ShadingMode::Forward };
+	GBuffer _gbuffer{ };
+	bool _gbuffer_pass{ false };
+	unsigned int _fullscreen_vao{ 0 };
+
+	bool _depth_prepass_enabled{ false };
+	bool _depth_prepassed{ false };
+	bool _overdraw_view_enabled{ false };
+	unsigned int _fragment_queries[2]{ };	// alternate so that the one read is a frame old
+	bool _fragment_query_pending[2]{ };
+	unsigned int _fragment_query_index{ 0 };
+	size_t _shaded_fragments{ 0 };
+
+	bool _shadows_enabled{ false };
+	ShadowRenderer _shadow_renderer{ };
+
+	FrameStats _frame_stats{ };
+	GpuProfiler _gpu_profiler{ };
 };
@@ -1,9 +1,13 @@
 ﻿#include "shader.h"
 #include "glad/glad.h"
+#include <algorithm>
 #include <cassert>
-#include <fstream>
-#include <sstream>
+#include <cstring>
+#include <utility>
 #include "graphic_api.h"
+#include "program_binary_cache.h"
+#include "gl_extensions.h"
+#include "common/profiler.h"
 
 ShaderObject::ShaderObject(Type type, std::string source)
 {
@@ -46,6 +50,12 @@ ShaderObject::~ShaderObject()
 	CHECK_GL_ERROR(glDeleteShader(_id));
 }
 
+
+ShaderProgram::ShaderProgram()
+{
+	_id = glCreateProgram();
+	_valid = false;
+}
 
 ShaderProgram::ShaderProgram(const std::vector<const ShaderObject*>& shaders)
 {
@@ -74,98 +84,172 @@ ShaderProgram::ShaderProgram(const std::vector<const ShaderObject*>& shaders)
 	}
 }
 
-ShaderProgram::ShaderProgram(const std::string& vertex_path, const std::string& fragment_path)
+ShaderProgram::ShaderProgram(const std::string& vertex_path, const std::string& fragment_path, ProgramBinaryCache* cache)
 {
 	_id = glCreateProgram();
+	_valid = false;
 
-	const unsigned int vs = load_shader_file(ShaderObject::Type::Vertex, vertex_path, _error_log);
-	if (vs == 0)
-	{
-		_valid = false;
+	ShaderSource vertex_source;
+	ShaderSource fragment_source;
+	if (!load_shader_file(vertex_path, vertex_source, _error_log) || !load_shader_file(fragment_path, fragment_source, _error_log))
 		return;
-	}
-	const unsigned int fs = load_shader_file(ShaderObject::Type::Fragment, fragment_path, _error_log);
-	if (fs == 0)
+	link(vertex_source, fragment_source, cache);
+}
+
+void ShaderProgram::link(const ShaderSource& vertex_source, const ShaderSource& fragment_source, ProgramBinaryCache* cache)
+{
+	PROFILE_ZONE("ShaderProgram::link");
+	uint64_t key = 0;
+	if (cache && cache->enabled())
 	{
-		_valid = false;
-		return;
+		key = cache->make_key(vertex_source.code, fragment_source.code);
+		if (cache->load(key, _id))
+		{
+			_error_log = "";
+			_valid = true;
+			_from_binary_cache = true;
+			return;
+		}
 	}
-	CHECK_GL_ERROR(glAttachShader(_id, vs));
-	CHECK_GL_ERROR(glAttachShader(_id, fs));
+
+	_vertex_shader = compile_shader(ShaderObject::Type::Vertex, vertex_source.code);
+	_fragment_shader = compile_shader(ShaderObject::Type::Fragment, fragment_source.code);
+	_vertex_files = vertex_source.files;
+	_fragment_files = fragment_source.files;
+	CHECK_GL_ERROR(glAttachShader(_id, _vertex_shader));
+	CHECK_GL_ERROR(glAttachShader(_id, _fragment_shader));
+	if (key != 0)
+		cache->prepare(_id);
 	CHECK_GL_ERROR(glLinkProgram(_id));
+	_cache = key != 0 ? cache : nullptr;
+	_cache_key = key;
+	_pending = true;
+}
+
+bool ShaderProgram::is_link_complete() const
+{
+	if (!_pending)
+		return true;
+	if (!get_gl_extensions().parallel_shader_compile)
+		return false;
+	int complete = 0;
+	CHECK_GL_ERROR(glGetProgramiv(_id, GL_COMPLETION_STATUS_KHR, &complete));
+	return complete != 0;
+}
+
+void ShaderProgram::finish_link() const
+{
+	PROFILE_ZONE("ShaderProgram::finish_link");
+	_pending = false;
 
 	int success = 0;
 	CHECK_GL_ERROR(glGetProgramiv(_id, GL_LINK_STATUS, &success));
 	if (!success)
 	{
-		_error_log.resize(512);
-		CHECK_GL_ERROR(glGetProgramInfoLog(_id, _error_log.capacity(), NULL, &_error_log[0]));
+		// a failed compile fails the link as well, its log tells more
+		if (read_compile_log(_vertex_shader, _vertex_files, _error_log) && read_compile_log(_fragment_shader, _fragment_files, _error_log))
+		{
+			_error_log.resize(512);
+			CHECK_GL_ERROR(glGetProgramInfoLog(_id, _error_log.capacity(), NULL, &_error_log[0]));
+		}
 		_valid = false;
 	}
 	else
 	{
 		_error_log = "";
 		_valid = true;
+		if (_cache)
+			_cache->store(_cache_key, _id);
 	}
+
+	CHECK_GL_ERROR(glDetachShader(_id, _vertex_shader));
+	CHECK_GL_ERROR(glDetachShader(_id, _fragment_shader));
+	CHECK_GL_ERROR(glDeleteShader(_vertex_shader));
+	CHECK_GL_ERROR(glDeleteShader(_fragment_shader));
+	_vertex_shader = 0;
+	_fragment_shader = 0;
+	_vertex_files.clear();
+	_fragment_files.clear();
 }
 
 ShaderProgram::~ShaderProgram()
 {
+	if (_pending)
+	{
+		CHECK_GL_ERROR(glDeleteShader(_vertex_shader));
+		CHECK_GL_ERROR(glDeleteShader(_fragment_shader));
+	}
 	CHECK_GL_ERROR(glDeleteProgram(_id));
 }
 
-void ShaderProgram::set_bool(const std::string& name, bool value) const
+void ShaderProgram::set_bool(const char* name, bool value) const
 {
-	CHECK_GL_ERROR(glUniform1i(glGetUniformLocation(_id, name.c_str()), (int)value));
+	CHECK_GL_ERROR(glUniform1i(glGetUniformLocation(_id, name), (int)value));
 }
 
-void ShaderProgram::set_int(const std::string& name, int value) const
+void ShaderProgram::set_int(const char* name, int value) const
 {
-	CHECK_GL_ERROR(glUniform1i(glGetUniformLocation(_id, name.c_str()), value));
+	CHECK_GL_ERROR(glUniform1i(glGetUniformLocation(_id, name), value));
 }
 
-void ShaderProgram::set_float(const std::string& name, float value) const
+void ShaderProgram::set_float(const char* name, float value) const
 {
-	CHECK_GL_ERROR(glUniform1f(glGetUniformLocation(_id, name.c_str()), value));
+	CHECK_GL_ERROR(glUniform1f(glGetUniformLocation(_id, name), value));
 }
 
-void ShaderProgram::set_vector2(const std::string& name, const Vector2& value) const
+void ShaderProgram::set_vector2(const char* name, const Vector2& value) const
 {
-	CHECK_GL_ERROR(glUniform2fv(glGetUniformLocation(_id, name.c_str()), 1, &value[0]));
+	CHECK_GL_ERROR(glUniform2fv(glGetUniformLocation(_id, name), 1, &value[0]));
 }
 
-void ShaderProgram::set_vector3(const std::string& name, const Vector3& value) const
+void ShaderProgram::set_vector3(const char* name, const Vector3& value) const
 {
-	CHECK_GL_ERROR(glUniform3fv(glGetUniformLocation(_id, name.c_str()), 1, &value[0]));
+	CHECK_GL_ERROR(glUniform3fv(glGetUniformLocation(_id, name), 1, &value[0]));
 }
 
-void ShaderProgram::set_vector4(const std::string& name, const Vector4& value) const
+void ShaderProgram::set_vector4(const char* name, const Vector4& value) const
 {
-	CHECK_GL_ERROR(glUniform4fv(glGetUniformLocation(_id, name.c_str()), 1, &value[0]));
+	CHECK_GL_ERROR(glUniform4fv(glGetUniformLocation(_id, name), 1, &value[0]));
 }
 
-void ShaderProgram::set_vector3(const std::string& name, float x, float y, float z) const
+void ShaderProgram::set_vector3(const char* name, float x, float y, float z) const
 {
-	CHECK_GL_ERROR(glUniform3f(glGetUniformLocation(_id, name.c_str()), x, y, z));
+	CHECK_GL_ERROR(glUniform3f(glGetUniformLocation(_id, name), x, y, z));
 }
 
-void ShaderProgram::set_vector4(const std::string& name, float x, float y, float z, float w) const
+void ShaderProgram::set_vector4(const char* name, float x, float y, float z, float w) const
 {
-	CHECK_GL_ERROR(glUniform4f(glGetUniformLocation(_id, name.c_str()), x, y, z, w));
+	CHECK_GL_ERROR(glUniform4f(glGetUniformLocation(_id, name), x, y, z, w));
 }
 
-void ShaderProgram::set_matrix3(const std::string& name, const Matrix3& value) const
+void ShaderProgram::set_matrix3(const char* name, const Matrix3& value) const
 {
-	CHECK_GL_ERROR(glUniformMatrix3fv(glGetUniformLocation(_id, name.c_str()), 1, GL_FALSE, &value[0][0]));
+	CHECK_GL_ERROR(glUniformMatrix3fv(glGetUniformLocation(_id, name), 1, GL_FALSE, &value[0][0]));
 }
 
-void ShaderProgram::set_matrix4(const std::string& name, const Matrix4& value) const
+void ShaderProgram::set_matrix4(const char* name, const Matrix4& value) const
 {
-	CHECK_GL_ERROR(glUniformMatrix4fv(glGetUniformLocation(_id, name.c_str()), 1, GL_FALSE, &value[0][0]));
+	CHECK_GL_ERROR(glUniformMatrix4fv(glGetUniformLocation(_id, name), 1, GL_FALSE, &value[0][0]));
 }
 
+int ShaderProgram::get_uniform_location(const char* name) const
+{
+	return glGetUniformLocation(_id, name);
+}
+
+void ShaderProgram::set_matrix4(int location, const Matrix4& value) const
+{
+	CHECK_GL_ERROR(glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]));
+}
+
+void ShaderProgram::set_matrix4_array(const char* name, const Matrix4* values, unsigned int count) const
+{
+	CHECK_GL_ERROR(glUniformMatrix4fv(glGetUniformLocation(_id, name), count, GL_FALSE, &values[0][0][0]));
+}
+
 void ShaderProgram::bind() const
 {
+	wait();
 	CHECK_GL_ERROR(glUseProgram(_id));
 }
 
@@ -174,8 +258,30 @@ void ShaderProgram::unbind() const
 	CHECK_GL_ERROR(glUseProgram(0));
 }
 
-unsigned int ShaderProgram::load_shader_file(ShaderObject::Type type, const std::string& path, std::string& error_log) const
+void ShaderProgram::swap(ShaderProgram& other)
+{
+	std::swap(_id, other._id);
+	std::swap(_error_log, other._error_log);
+	std::swap(_valid, other._valid);
+	std::swap(_from_binary_cache, other._from_binary_cache);
+	std::swap(_pending, other._pending);
+	std::swap(_vertex_shader, other._vertex_shader);
+	std::swap(_fragment_shader, other._fragment_shader);
+	std::swap(_vertex_files, other._vertex_files);
+	std::swap(_fragment_files, other._fragment_files);
+	std::swap(_cache, other._cache);
+	std::swap(_cache_key, other._cache_key);
+}
+
+bool ShaderProgram::load_shader_file(const std::string& path, ShaderSource& source, std::string& error_log, bool loose)
+{
+	ShaderPreprocessor preprocessor(loose);
+	return preprocessor.process(path, source, error_log);
+}
+
+unsigned int ShaderProgram::compile_shader(ShaderObject::Type type, const std::string& source)
 {
+	PROFILE_ZONE("ShaderProgram::compile_shader");
 	unsigned int id = 0;
 	switch (type)
 	{
@@ -190,35 +296,23 @@ unsigned int ShaderProgram::load_shader_file(ShaderObject::Type type, const std:
 		return 0;
 	}
 
-	std::string source;
-	std::ifstream stream;
-	stream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-	try
-	{
-		stream.open(path);
-		std::stringstream ss;
-		ss << stream.rdbuf();
-		stream.close();
-		source = ss.str();
-	}
-	catch (std::ifstream::failure& e)
-	{
-		error_log = "read file '" + path + "' failed: " + e.what();
-		return 0;
-	}
-
 	const char* src = source.c_str();
 	CHECK_GL_ERROR(glShaderSource(id, 1, &src, NULL));
 	CHECK_GL_ERROR(glCompileShader(id));
-
-	int success = 0;
-	CHECK_GL_ERROR(glGetShaderiv(id, GL_COMPILE_STATUS, &success));
-	if (!success)
-	{
-		error_log.resize(512);
-		CHECK_GL_ERROR(glGetShaderInfoLog(id, error_log.capacity(), NULL, &error_log[0]));
-		return 0;
-	}
 	return id;
 }
+
+bool ShaderProgram::read_compile_log(unsigned int shader, const std::vector<std::string>& files, std::string& error_log)
+{
+	int success = 0;
+	CHECK_GL_ERROR(glGetShaderiv(shader, GL_COMPILE_STATUS, &success));
+	if (success)
+		return true;
+	int length = 0;
+	CHECK_GL_ERROR(glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length));
+	std::string log(std::max(length, 1), '\0');
+	CHECK_GL_ERROR(glGetShaderInfoLog(shader, (GLsizei)log.size(), NULL, &log[0]));
+	log.resize(strlen(log.c_str()));
+	error_log = remap_shader_log(log, files);
+	return false;
+}
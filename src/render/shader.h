@@ -1,8 +1,12 @@
 ﻿#pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include "math/math.h"
+#include "shader_preprocessor.h"
+
+class ProgramBinaryCache;
 
 class ShaderObject final
 {
@@ -47,32 +51,66 @@ public:
 	ShaderProgram& operator=(const ShaderProgram&) = delete;
 	ShaderProgram& operator=(ShaderProgram&&) = delete;
 
-	const std::string& get_error_log() const { return _error_log; }
-	bool valid() const { return _valid; }
-
-	void set_bool(const std::string& name, bool value) const;
-	void set_int(const std::string& name, int value) const;
-	void set_float(const std::string& name, float value) const;
-
-	void set_vector2(const std::string& name, const Vector2& value) const;
-	void set_vector3(const std::string& name, const Vector3& value) const;
-	void set_vector4(const std::string& name, const Vector4& value) const;
-	void set_vector3(const std::string& name, float x, float y, float z) const;
-	void set_vector4(const std::string& name, float x, float y, float z, float w) const;
-
-	void set_matrix3(const std::string& name, const Matrix3& value) const;
-	void set_matrix4(const std::string& name, const Matrix4& value) const;
+	// the link result, waits for a link still running in the driver
+	const std::string& get_error_log() const { wait(); return _error_log; }
+	bool valid() const { wait(); return _valid; }
+	// linked from a cached binary instead of being compiled
+	bool is_from_binary_cache() const { return _from_binary_cache; }
+
+	// true once reading the link result would not block
+	bool is_link_complete() const;
+	// reads the link result of a pending link, called on first use of the program
+	void wait() const { if (_pending) finish_link(); }
+
+	void set_bool(const char* name, bool value) const;
+	void set_int(const char* name, int value) const;
+	void set_float(const char* name, float value) const;
+
+	void set_vector2(const char* name, const Vector2& value) const;
+	void set_vector3(const char* name, const Vector3& value) const;
+	void set_vector4(const char* name, const Vector4& value) const;
+	void set_vector3(const char* name, float x, float y, float z) const;
+	void set_vector4(const char* name, float x, float y, float z, float w) const;
+
+	void set_matrix3(const char* name, const Matrix3& value) const;
+	void set_matrix4(const char* name, const Matrix4& value) const;
+	void set_matrix4_array(const char* name, const Matrix4* values, unsigned int count) const;
+	// for uniforms set on every draw, -1 when the program has none of the name
+	int get_uniform_location(const char* name) const;
+	void set_matrix4(int location, const Matrix4& value) const;
 
 	void bind() const;
 	void unbind() const;
 
 protected:
+	// an empty program, filled by link
+	ShaderProgram();
 	ShaderProgram(const std::vector<const ShaderObject*>& shaders);
-	ShaderProgram(const std::string& vertex_path, const std::string& fragment_path);
-	unsigned int load_shader_file(ShaderObject::Type type, const std::string& path, std::string& error_log) const;
+	ShaderProgram(const std::string& vertex_path, const std::string& fragment_path, ProgramBinaryCache* cache = nullptr);
+	// starts compiling and linking without querying any status, so that the driver can work on
+	// several programs at once. The result is read by wait().
+	void link(const ShaderSource& vertex_source, const ShaderSource& fragment_source, ProgramBinaryCache* cache);
+	// reads the file and expands its includes
+	static bool load_shader_file(const std::string& path, ShaderSource& source, std::string& error_log, bool loose = false);
+	// exchanges the GL programs, so that a reloaded program replaces this one behind the same pointer
+	void swap(ShaderProgram& other);
+	static unsigned int compile_shader(ShaderObject::Type type, const std::string& source);
 
 private:
+	void finish_link() const;
+	static bool read_compile_log(unsigned int shader, const std::vector<std::string>& files, std::string& error_log);
+
 	unsigned int _id;
-	std::string _error_log;
-	bool _valid;
+	mutable std::string _error_log;
+	mutable bool _valid;
+	bool _from_binary_cache{ false };
+
+	// state of a link started by link() and not read yet
+	mutable bool _pending{ false };
+	mutable unsigned int _vertex_shader{ 0 };
+	mutable unsigned int _fragment_shader{ 0 };
+	mutable std::vector<std::string> _vertex_files{ };
+	mutable std::vector<std::string> _fragment_files{ };
+	ProgramBinaryCache* _cache{ nullptr };
+	uint64_t _cache_key{ 0 };
 };
\ No newline at end of file
@@ -0,0 +1,360 @@
+﻿#include "shader_manager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "common/hash.h"
+#include "common/profiler.h"
+#include "gl_extensions.h"
+
+template<> ShaderManager* Singleton<ShaderManager>::singleton = nullptr;
+
+namespace
+{
+	std::string get_variant_name(const std::string& name, const ShaderVariant& variant)
+	{
+		char key[32];
+		snprintf(key, sizeof(key), "%016llx", (unsigned long long)variant.get_key());
+		return name + "#" + key;
+	}
+
+	ShaderSource apply_variant(const ShaderVariant& variant, const ShaderSource& source)
+	{
+		ShaderSource result;
+		result.code = variant.apply(source.code);
+		result.files = source.files;
+		result.hash = hash_fnv1a(result.code);
+		return result;
+	}
+}
+
+ShaderProgram* ShaderManager::get_program(const std::string& name) const
+{
+	const auto iter = _programs.find(name);
+	if (iter != _programs.end())
+		return iter->second;
+	const auto set = _variant_sets.find(name);
+	return set != _variant_sets.end() ? set->second.default_program : nullptr;
+}
+
+ShaderProgram* ShaderManager::get_program(const std::string& name, const ShaderVariant& variant)
+{
+	const auto set = _variant_sets.find(name);
+	if (set == _variant_sets.end())
+		return nullptr;
+	const auto iter = set->second.programs.find(variant.get_key());
+	if (iter != set->second.programs.end())
+		return iter->second;
+	return create_variant(name, set->second, variant);
+}
+
+ShaderProgram* ShaderManager::get_variant(ShaderProgram* program, const ShaderVariant& variant)
+{
+	const auto iter = _variant_set_names.find(program);
+	if (iter == _variant_set_names.end())
+		return program;
+	ShaderProgram* result = get_program(iter->second, variant);
+	return result ? result : program;
+}
+
+ShaderProgram* ShaderManager::load(const std::string& name, const std::string& vertex_path, const std::string& fragment_path)
+{
+	ShaderProgram* program = request(name, vertex_path, fragment_path);
+	if (!program)
+		return nullptr;
+	if (!program->is_link_complete())
+		finish_link(name, *program);
+	if (!program->valid())
+	{
+		std::cout << "ShaderManager load failed, " << vertex_path << ", " << fragment_path << " : " << program->get_error_log() << std::endl;
+		_programs.erase(name);
+		_program_sources.erase(name);
+		_pending_links.erase(std::remove_if(_pending_links.begin(), _pending_links.end(),
+			[program](const std::pair<std::string, const ShaderProgram*>& link) { return link.second == program; }), _pending_links.end());
+		delete program;
+		return nullptr;
+	}
+	return program;
+}
+
+ShaderProgram* ShaderManager::request(const std::string& name, const std::string& vertex_path, const std::string& fragment_path)
+{
+	assert(!get_program(name));
+
+	ProgramSources sources;
+	sources.vertex_path = vertex_path;
+	sources.fragment_path = fragment_path;
+	std::string error_log;
+	if (!sources.load(error_log))
+	{
+		std::cout << "ShaderManager load failed, " << vertex_path << ", " << fragment_path << " : " << error_log << std::endl;
+		return nullptr;
+	}
+
+	ShaderProgram* program = create_program(name, sources.vertex_source, sources.fragment_source);
+	_programs[name] = program;
+	watch(sources);
+	_program_sources[name] = std::move(sources);
+	return program;
+}
+
+ShaderProgram* ShaderManager::load_variants(const std::string& name, const std::string& vertex_path, const std::string& fragment_path, const ShaderVariant& default_variant)
+{
+	assert(!get_program(name));
+
+	VariantSet set;
+	set.sources.vertex_path = vertex_path;
+	set.sources.fragment_path = fragment_path;
+	set.default_program = nullptr;
+	std::string error_log;
+	if (!set.sources.load(error_log))
+	{
+		std::cout << "ShaderManager load failed, " << vertex_path << ", " << fragment_path << " : " << error_log << std::endl;
+		return nullptr;
+	}
+
+	watch(set.sources);
+	VariantSet& stored = _variant_sets[name] = std::move(set);
+	stored.default_program = create_variant(name, stored, default_variant);
+	return stored.default_program;
+}
+
+void ShaderManager::update()
+{
+	PROFILE_ZONE("ShaderManager::update");
+	size_t count = 0;
+	for (size_t i = 0; i < _pending_links.size(); ++i)
+	{
+		if (_pending_links[i].second->is_link_complete())
+			finish_link(_pending_links[i].first, *_pending_links[i].second);
+		else
+			_pending_links[count++] = _pending_links[i];
+	}
+	_pending_links.resize(count);
+
+	if (_watcher)
+	{
+		finish_reloads();
+		reload_changed_files();
+	}
+}
+
+void ShaderManager::wait_all()
+{
+	for (const auto& link : _pending_links)
+	{
+		finish_link(link.first, *link.second);
+	}
+	_pending_links.clear();
+}
+
+void ShaderManager::cleanup()
+{
+	for (auto& pair : _programs)
+	{
+		delete pair.second;
+	}
+	_programs.clear();
+	_program_sources.clear();
+	for (auto& set : _variant_sets)
+	{
+		for (auto& pair : set.second.programs)
+		{
+			delete pair.second;
+		}
+	}
+	_variant_sets.clear();
+	_variant_set_names.clear();
+	_pending_links.clear();
+	for (auto& reload : _pending_reloads)
+	{
+		delete reload.replacement;
+	}
+	_pending_reloads.clear();
+}
+
+void ShaderManager::enable_hot_reload()
+{
+	if (_watcher)
+		return;
+	_watcher.reset(new FileWatcher());
+	for (const auto& pair : _program_sources)
+	{
+		watch(pair.second);
+	}
+	for (const auto& pair : _variant_sets)
+	{
+		watch(pair.second.sources);
+	}
+}
+
+ShaderProgram* ShaderManager::create_program(const std::string& name, const ShaderSource& vertex_source, const ShaderSource& fragment_source)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const auto program = new ShaderProgram();
+	program->link(vertex_source, fragment_source, &_binary_cache);
+	const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (program->is_from_binary_cache())
+	{
+		++_load_stats.cached_programs;
+		_load_stats.cache_ms += ms;
+		std::cout << "ShaderManager loaded cached " << name << " in " << ms << " ms" << std::endl;
+	}
+	else
+	{
+		++_load_stats.compiled_programs;
+		_load_stats.compile_ms += ms;
+		_pending_links.push_back(std::make_pair(name, program));
+		std::cout << "ShaderManager started compiling " << name << " in " << ms << " ms" << std::endl;
+	}
+	return program;
+}
+
+ShaderProgram* ShaderManager::create_variant(const std::string& name, VariantSet& set, const ShaderVariant& variant)
+{
+	ShaderProgram* program = create_program(get_variant_name(name, variant), apply_variant(variant, set.sources.vertex_source), apply_variant(variant, set.sources.fragment_source));
+	set.programs[variant.get_key()] = program;
+	_variant_set_names[program] = name;
+	return program;
+}
+
+void ShaderManager::finish_link(const std::string& name, const ShaderProgram& program)
+{
+	// a link the driver has finished, or one a draw already waited for, returns at once
+	const bool complete = program.is_link_complete();
+	const auto start = std::chrono::steady_clock::now();
+	program.wait();
+	if (!complete)
+		_load_stats.wait_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (!program.valid())
+		std::cout << "ShaderManager " << name << " failed : " << program.get_error_log() << std::endl;
+}
+
+void ShaderManager::watch(const ProgramSources& sources)
+{
+	if (!_watcher)
+		return;
+	for (const auto& path : sources.vertex_source.files)
+	{
+		_watcher->watch(path);
+	}
+	for (const auto& path : sources.fragment_source.files)
+	{
+		_watcher->watch(path);
+	}
+}
+
+void ShaderManager::reload_changed_files()
+{
+	const std::vector<std::string> changed = _watcher->take_changed();
+	if (changed.empty())
+		return;
+
+	std::string error_log;
+	for (auto& pair : _program_sources)
+	{
+		if (!pair.second.uses(changed))
+			continue;
+		ProgramSources sources = pair.second;
+		if (!sources.load(error_log, true))
+		{
+			std::cout << "ShaderManager reload of " << pair.first << " failed : " << error_log << std::endl;
+			continue;
+		}
+		// saved without a change that reaches the expanded code
+		if (sources.vertex_source.hash == pair.second.vertex_source.hash && sources.fragment_source.hash == pair.second.fragment_source.hash)
+			continue;
+		watch(sources);
+		reload(pair.first, _programs[pair.first], sources.vertex_source, sources.fragment_source);
+		pair.second = std::move(sources);
+	}
+
+	for (auto& pair : _variant_sets)
+	{
+		VariantSet& set = pair.second;
+		if (!set.sources.uses(changed))
+			continue;
+		ProgramSources sources = set.sources;
+		if (!sources.load(error_log, true))
+		{
+			std::cout << "ShaderManager reload of " << pair.first << " failed : " << error_log << std::endl;
+			continue;
+		}
+		if (sources.vertex_source.hash == set.sources.vertex_source.hash && sources.fragment_source.hash == set.sources.fragment_source.hash)
+			continue;
+		watch(sources);
+		// variants requested later compile from the new sources
+		set.sources = std::move(sources);
+		for (const auto& program : set.programs)
+		{
+			const ShaderVariant variant = ShaderVariant::from_key(program.first);
+			reload(get_variant_name(pair.first, variant), program.second,
+				apply_variant(variant, set.sources.vertex_source), apply_variant(variant, set.sources.fragment_source));
+		}
+	}
+}
+
+void ShaderManager::reload(const std::string& name, ShaderProgram* target, const ShaderSource& vertex_source, const ShaderSource& fragment_source)
+{
+	// a file saved again before the last reload finished replaces that reload
+	for (auto iter = _pending_reloads.begin(); iter != _pending_reloads.end(); ++iter)
+	{
+		if (iter->target == target)
+		{
+			delete iter->replacement;
+			_pending_reloads.erase(iter);
+			break;
+		}
+	}
+
+	const auto replacement = new ShaderProgram();
+	replacement->link(vertex_source, fragment_source, &_binary_cache);
+	_pending_reloads.push_back(Reload{ name, target, replacement, 0 });
+}
+
+void ShaderManager::finish_reloads()
+{
+	size_t count = 0;
+	for (size_t i = 0; i < _pending_reloads.size(); ++i)
+	{
+		Reload& reload = _pending_reloads[i];
+		// with parallel compile the reload waits for the link, without it the link can not be polled, the
+		// driver gets a frame before the swap waits on it
+		const bool parallel_compile = get_gl_extensions().parallel_shader_compile;
+		if (!reload.replacement->is_link_complete() && (parallel_compile || reload.frames++ == 0))
+		{
+			_pending_reloads[count++] = reload;
+			continue;
+		}
+
+		if (reload.replacement->valid())
+		{
+			reload.target->swap(*reload.replacement);
+			++_reload_generation;
+			std::cout << "ShaderManager reloaded " << reload.name << std::endl;
+		}
+		else
+		{
+			std::cout << "ShaderManager reload of " << reload.name << " failed, keeping the old program : " << reload.replacement->get_error_log() << std::endl;
+		}
+		// holds the old program after a swap
+		delete reload.replacement;
+	}
+	_pending_reloads.resize(count);
+}
+
+bool ShaderManager::ProgramSources::load(std::string& error_log, bool loose)
+{
+	return ShaderProgram::load_shader_file(vertex_path, vertex_source, error_log, loose) &&
+		ShaderProgram::load_shader_file(fragment_path, fragment_source, error_log, loose);
+}
+
+bool ShaderManager::ProgramSources::uses(const std::vector<std::string>& files) const
+{
+	for (const auto& file : files)
+	{
+		if (std::find(vertex_source.files.begin(), vertex_source.files.end(), file) != vertex_source.files.end() ||
+			std::find(fragment_source.files.begin(), fragment_source.files.end(), file) != fragment_source.files.end())
+			return true;
+	}
+	return false;
+}
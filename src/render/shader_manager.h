@@ -5,7 +5,11 @@
 #include "math/math.h"
 #include "common/singleton.h"
 #include "shader.h"
+#include "shader_variant.h"
+#include "program_binary_cache.h"
+#include "common/file_watcher.h"
 #include <map>
+#include <memory>
 #include <iostream>
 
 class ShaderManager : public Singleton<ShaderManager>
@@ -20,37 +24,94 @@ public:
 	ShaderManager& operator=(const ShaderManager&) = delete;
 	ShaderManager& operator=(ShaderManager&&) = delete;
 
-	ShaderProgram* get_program(const std::string& name) const
-	{
-		const auto iter = _programs.find(name);
-		return iter != _programs.end() ? iter->second : nullptr;
-	}
-	
-	ShaderProgram* load(const std::string& name, const std::string& vertex_path, const std::string& fragment_path)
-	{
-		assert(_programs.find(name) == _programs.end());
-
-		const auto program = new ShaderProgram(vertex_path, fragment_path);
-		if (!program->valid())
-		{
-			std::cout << "ShaderManager load failed, " << vertex_path << ", " << fragment_path << " : " << program->get_error_log() << std::endl;
-			delete program;
-			return nullptr;
-		}
-		_programs[name] = program;
-		return program;
-	}
+	// the default variant for programs loaded with variants
+	ShaderProgram* get_program(const std::string& name) const;
+	// compiles the variant on first use, null if the program has no variants or fails to compile
+	ShaderProgram* get_program(const std::string& name, const ShaderVariant& variant);
+	// the variant built from the same sources as program, program itself when it has no variants
+	ShaderProgram* get_variant(ShaderProgram* program, const ShaderVariant& variant);
+	bool has_variants(const ShaderProgram* program) const { return _variant_set_names.count(program) != 0; }
+
+	// starts compiling and returns at once, the program waits for the driver when it is first used
+	ShaderProgram* request(const std::string& name, const std::string& vertex_path, const std::string& fragment_path);
+	// like request, but waits for the link and fails if it does
+	ShaderProgram* load(const std::string& name, const std::string& vertex_path, const std::string& fragment_path);
+	// the sources are kept to compile other variants when they are requested, compiles like request
+	ShaderProgram* load_variants(const std::string& name, const std::string& vertex_path, const std::string& fragment_path, const ShaderVariant& default_variant);
+
+	// reads the result of the links the driver has finished without blocking and reloads changed
+	// shader files, called once per frame
+	void update();
+	// waits for all links still running
+	void wait_all();
+
+	// Recompiles programs whose loose source files, includes among them, change while running. A reload that links replaces
+	// the program behind the same pointer, a failed one leaves the old program in place.
+	void enable_hot_reload();
+	bool is_hot_reload_enabled() const { return _watcher != nullptr; }
+	// incremented by every reload, for caches of programs chosen by validity
+	unsigned int get_reload_generation() const { return _reload_generation; }
 	//bool create_from_source(const std::string& name, const std::string& vertex_src, const std::string& fragment_src);
 
-	void cleanup()
+	struct LoadStats
 	{
-		for (auto& pair : _programs)
-		{
-			delete pair.second;
-		}
-		_programs.clear();
-	}
+		unsigned int compiled_programs;
+		float compile_ms;
+		unsigned int cached_programs;
+		float cache_ms;
+		// time spent blocked on links which were not finished when they were needed
+		float wait_ms;
+	};
+	const LoadStats& get_load_stats() const { return _load_stats; }
+	ProgramBinaryCache& get_binary_cache() { return _binary_cache; }
+
+	void cleanup();
 
 private:
+	// the expanded sources of a program and the files they were read from
+	struct ProgramSources
+	{
+		std::string vertex_path;
+		std::string fragment_path;
+		ShaderSource vertex_source;
+		ShaderSource fragment_source;
+
+		bool load(std::string& error_log, bool loose = false);
+		bool uses(const std::vector<std::string>& files) const;
+	};
+
+	struct VariantSet
+	{
+		ProgramSources sources;
+		ShaderProgram* default_program;
+		std::map<uint64_t, ShaderProgram*> programs;
+	};
+
+	struct Reload
+	{
+		std::string name;
+		ShaderProgram* target;
+		ShaderProgram* replacement;
+		unsigned int frames;	// polled without a result
+	};
+
+	ShaderProgram* create_program(const std::string& name, const ShaderSource& vertex_source, const ShaderSource& fragment_source);
+	ShaderProgram* create_variant(const std::string& name, VariantSet& set, const ShaderVariant& variant);
+	void finish_link(const std::string& name, const ShaderProgram& program);
+	void watch(const ProgramSources& sources);
+	void reload_changed_files();
+	void reload(const std::string& name, ShaderProgram* target, const ShaderSource& vertex_source, const ShaderSource& fragment_source);
+	void finish_reloads();
+
 	std::map<std::string, ShaderProgram*> _programs{ };
+	std::map<std::string, ProgramSources> _program_sources{ };
+	std::map<std::string, VariantSet> _variant_sets{ };
+	std::map<const ShaderProgram*, std::string> _variant_set_names{ };
+	std::vector<std::pair<std::string, const ShaderProgram*>> _pending_links{ };
+	ProgramBinaryCache _binary_cache{ "shader_cache" };
+	LoadStats _load_stats{ };
+
+	std::unique_ptr<FileWatcher> _watcher{ };
+	std::vector<Reload> _pending_reloads{ };
+	unsigned int _reload_generation{ 0 };
 };
@@ -0,0 +1,163 @@
+﻿#include "shader_preprocessor.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include "common/file_system.h"
+#include "common/hash.h"
+
+namespace
+{
+	// the directive name of a preprocessor line, with pos after it, or an empty string
+	std::string get_directive(const std::string& line, size_t& pos)
+	{
+		pos = line.find_first_not_of(" \t");
+		if (pos == std::string::npos || line[pos] != '#')
+			return std::string();
+		pos = line.find_first_not_of(" \t", pos + 1);
+		if (pos == std::string::npos)
+			return std::string();
+		const size_t begin = pos;
+		while (pos < line.size() && isalpha((unsigned char)line[pos]))
+			++pos;
+		return line.substr(begin, pos - begin);
+	}
+}
+
+std::string remap_shader_log(const std::string& log, const std::vector<std::string>& files)
+{
+	// drivers report "0(12) : error" or "0:12(5): error", with the source string number first
+	std::string result;
+	size_t begin = 0;
+	while (begin < log.size())
+	{
+		size_t end = log.find('\n', begin);
+		end = end == std::string::npos ? log.size() : end + 1;
+		const std::string line = log.substr(begin, end - begin);
+		begin = end;
+
+		size_t digits = 0;
+		while (digits < line.size() && isdigit((unsigned char)line[digits]))
+			++digits;
+		if (digits > 0 && digits < line.size() && (line[digits] == '(' || line[digits] == ':'))
+		{
+			const size_t index = (size_t)std::stoul(line.substr(0, digits));
+			if (index < files.size())
+			{
+				result += files[index] + line.substr(digits);
+				continue;
+			}
+		}
+		result += line;
+	}
+	return result;
+}
+
+bool ShaderPreprocessor::process(const std::string& path, ShaderSource& source, std::string& error_log)
+{
+	source = ShaderSource();
+	_stack.clear();
+	_once.clear();
+	if (!expand(PackFile::normalize_path(path), source, error_log))
+		return false;
+	source.hash = hash_fnv1a(source.code);
+	return true;
+}
+
+bool ShaderPreprocessor::expand(const std::string& path, ShaderSource& source, std::string& error_log)
+{
+	if (_once.find(path) != _once.end())
+		return true;
+	if (std::find(_stack.begin(), _stack.end(), path) != _stack.end())
+	{
+		error_log = "include cycle at '" + path + "'";
+		return false;
+	}
+
+	std::string text;
+	if (!read_file(path, text))
+	{
+		error_log = "read file '" + path + "' failed";
+		return false;
+	}
+
+	auto file = std::find(source.files.begin(), source.files.end(), path);
+	if (file == source.files.end())
+		file = source.files.insert(source.files.end(), path);
+	const std::string file_index = std::to_string(file - source.files.begin());
+	// the main file is source string 0 and has to start with its #version line
+	if (!_stack.empty())
+		source.code += "#line 1 " + file_index + "\n";
+	_stack.push_back(path);
+
+	size_t begin = 0;
+	for (unsigned int line_number = 1; begin < text.size(); ++line_number)
+	{
+		size_t end = text.find('\n', begin);
+		end = end == std::string::npos ? text.size() : end + 1;
+		std::string line = text.substr(begin, end - begin);
+		begin = end;
+		if (line.empty() || line.back() != '\n')
+			line += '\n';
+
+		size_t pos = 0;
+		const std::string directive = get_directive(line, pos);
+		if (directive == "include")
+		{
+			const size_t open = line.find('"', pos);
+			const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			std::string include_path;
+			if (close == std::string::npos)
+			{
+				error_log = path + "(" + std::to_string(line_number) + ") : malformed #include";
+				return false;
+			}
+			if (!resolve_include(path, line.substr(open + 1, close - open - 1), include_path))
+			{
+				error_log = path + "(" + std::to_string(line_number) + ") : can not find '" + line.substr(open + 1, close - open - 1) + "'";
+				return false;
+			}
+			if (!expand(include_path, source, error_log))
+				return false;
+			source.code += "#line " + std::to_string(line_number + 1) + " " + file_index + "\n";
+		}
+		else if (directive == "pragma" && line.find("once", pos) != std::string::npos)
+		{
+			_once.insert(path);
+			source.code += "\n";
+		}
+		else
+		{
+			source.code += line;
+		}
+	}
+
+	_stack.pop_back();
+	return true;
+}
+
+bool ShaderPreprocessor::read_file(const std::string& path, std::string& text) const
+{
+	FileData file;
+	if (!(_loose ? FileSystem::read_loose(path, file) : FileSystem::get_singleton().read(path, file)))
+		return false;
+	text.assign(reinterpret_cast<const char*>(file.data), file.size);
+	return true;
+}
+
+bool ShaderPreprocessor::resolve_include(const std::string& including_path, const std::string& include, std::string& path) const
+{
+	const size_t slash = including_path.find_last_of('/');
+	if (slash != std::string::npos)
+	{
+		path = PackFile::normalize_path(including_path.substr(0, slash + 1) + include);
+		if (exists(path))
+			return true;
+	}
+	path = PackFile::normalize_path(include);
+	return exists(path);
+}
+
+bool ShaderPreprocessor::exists(const std::string& path) const
+{
+	return _loose ? std::ifstream(path).good() : FileSystem::get_singleton().exists(path);
+}
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+// A shader file with its includes expanded.
+struct ShaderSource
+{
+	std::string code{ "" };
+	// every file read, the main file first. The index is the source string number of the #line directives.
+	std::vector<std::string> files{ };
+	uint64_t hash{ 0 };		// of code
+};
+
+// replaces the source string numbers of a compile log with the names of the files
+std::string remap_shader_log(const std::string& log, const std::vector<std::string>& files);
+
+// Expands #include "path" directives, in the manner of stb_include but reading through the FileSystem.
+// Paths are relative to the including file, then to the working directory. Files with #pragma once
+// are expanded once, include cycles are an error. Every expansion is followed by a #line directive,
+// so that compile errors point at the file and line they come from.
+class ShaderPreprocessor
+{
+public:
+	// loose skips the mounted packs, for files edited while running
+	explicit ShaderPreprocessor(bool loose = false) : _loose(loose) { }
+
+	bool process(const std::string& path, ShaderSource& source, std::string& error_log);
+
+private:
+	bool expand(const std::string& path, ShaderSource& source, std::string& error_log);
+	bool read_file(const std::string& path, std::string& text) const;
+	bool resolve_include(const std::string& including_path, const std::string& include, std::string& path) const;
+	bool exists(const std::string& path) const;
+
+	bool _loose;
+	std::vector<std::string> _stack{ };
+	std::set<std::string> _once{ };
+};
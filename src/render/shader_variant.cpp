@@ -0,0 +1,74 @@
+﻿#include "shader_variant.h"
+#include <algorithm>
+
+namespace
+{
+	const char* const FEATURE_DEFINES[] = { "HAS_NORMAL_MAP", "ALPHA_TEST", "CLUSTERED_LIGHTS", "GBUFFER" };
+	static_assert(sizeof(FEATURE_DEFINES) / sizeof(FEATURE_DEFINES[0]) == (size_t)ShaderFeature::Count, "a define per feature");
+}
+
+ShaderVariant& ShaderVariant::with_textures(unsigned int diffuse, unsigned int specular)
+{
+	diffuse_textures = (uint8_t)std::min(diffuse, MAX_TEXTURES);
+	specular_textures = (uint8_t)std::min(specular, MAX_TEXTURES);
+	return *this;
+}
+
+ShaderVariant& ShaderVariant::with_lights(unsigned int omni, unsigned int spot)
+{
+	omni_lights = (uint8_t)std::min(omni, MAX_LIGHTS);
+	spot_lights = (uint8_t)std::min(spot, MAX_LIGHTS);
+	return *this;
+}
+
+uint64_t ShaderVariant::get_key() const
+{
+	return uint64_t(features) | uint64_t(diffuse_textures) << 32 | uint64_t(specular_textures) << 40 |
+		uint64_t(omni_lights) << 48 | uint64_t(spot_lights) << 56;
+}
+
+ShaderVariant ShaderVariant::from_key(uint64_t key)
+{
+	ShaderVariant variant;
+	variant.features = (uint32_t)key;
+	variant.diffuse_textures = (uint8_t)(key >> 32);
+	variant.specular_textures = (uint8_t)(key >> 40);
+	variant.omni_lights = (uint8_t)(key >> 48);
+	variant.spot_lights = (uint8_t)(key >> 56);
+	return variant;
+}
+
+std::string ShaderVariant::get_defines() const
+{
+	std::string defines;
+	for (unsigned int i = 0; i < (unsigned int)ShaderFeature::Count; ++i)
+	{
+		if (features & (1u << i))
+			defines += std::string("#define ") + FEATURE_DEFINES[i] + "\n";
+	}
+	defines += "#define NUM_DIFFUSE_TEXTURES " + std::to_string(diffuse_textures) + "\n";
+	defines += "#define NUM_SPECULAR_TEXTURES " + std::to_string(specular_textures) + "\n";
+	defines += "#define NUM_OMNI_LIGHTS " + std::to_string(omni_lights) + "\n";
+	defines += "#define NUM_SPOT_LIGHTS " + std::to_string(spot_lights) + "\n";
+	return defines;
+}
+
+std::string ShaderVariant::apply(const std::string& source) const
+{
+	size_t insert = 0;
+	size_t line = 1;
+	const size_t version = source.find("#version");
+	if (version != std::string::npos)
+	{
+		const size_t end = source.find('\n', version);
+		insert = end == std::string::npos ? source.size() : end + 1;
+		line = std::count(source.begin(), source.begin() + insert, '\n') + 1;
+	}
+	std::string result = source.substr(0, insert);
+	if (!result.empty() && result.back() != '\n')
+		result += '\n';
+	result += get_defines();
+	result += "#line " + std::to_string(line) + "\n";
+	result += source.substr(insert);
+	return result;
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum class ShaderFeature : unsigned int
+{
+	NormalMap = 0,	// HAS_NORMAL_MAP, needs tangents and bitangents at locations 3 and 4
+	AlphaTest,		// ALPHA_TEST, discards fragments whose diffuse alpha is below one half
+	ClusteredLights,	// CLUSTERED_LIGHTS, reads the omni and spot lights of the fragment froxel from the LightGrid
+	GBuffer,			// GBUFFER, writes the surface to the GBuffer targets instead of shading it
+	Count
+};
+
+// Compile time configuration of a program. Every feature and count becomes a #define inserted after
+// the #version line, so that the shader only contains the code and loops the variant needs.
+struct ShaderVariant
+{
+	static const unsigned int MAX_TEXTURES = 3;	// per texture type
+	static const unsigned int MAX_LIGHTS = 15;	// per light type
+
+	uint32_t features{ 0 };
+	uint8_t diffuse_textures{ 0 };	// NUM_DIFFUSE_TEXTURES
+	uint8_t specular_textures{ 0 };	// NUM_SPECULAR_TEXTURES
+	uint8_t omni_lights{ 0 };		// NUM_OMNI_LIGHTS
+	uint8_t spot_lights{ 0 };		// NUM_SPOT_LIGHTS
+
+	ShaderVariant& with(ShaderFeature feature) { features |= 1u << (unsigned int)feature; return *this; }
+	ShaderVariant& with_textures(unsigned int diffuse, unsigned int specular);
+	ShaderVariant& with_lights(unsigned int omni, unsigned int spot);
+	bool has(ShaderFeature feature) const { return (features & (1u << (unsigned int)feature)) != 0; }
+
+	uint64_t get_key() const;
+	static ShaderVariant from_key(uint64_t key);
+	std::string get_defines() const;
+
+	// inserts the defines after the #version line and keeps the line numbers of the rest
+	std::string apply(const std::string& source) const;
+};
@@ -0,0 +1,451 @@
+﻿#include "shadow_renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <glm/ext/matrix_clip_space.hpp> // glm::ortho, glm::perspective
+#include <glm/ext/matrix_transform.hpp> // glm::lookAt, glm::translate
+#include "glad/glad.h"
+#include "common/hash.h"
+#include "graphic_api.h"
+#include "engine/camera.h"
+#include "light_grid.h"
+#include "mesh.h"
+#include "shader.h"
+
+namespace
+{
+	// blend between uniform and logarithmic cascade splits
+	const float CASCADE_SPLIT_LAMBDA = 0.75f;
+	// casters this far towards the light from a cascade still shadow it
+	const float CASCADE_CASTER_DISTANCE = 50.0f;
+	const float LOCAL_NEAR = 0.05f;
+	// a little over 90 degrees so that the filtering at the face edges stays inside the tile
+	const float OMNI_FACE_FOV = 92.0f;
+
+	bool in_frustum(const Vector4 planes[6], const ShadowCaster& caster)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			if (glm::dot(Vector3(planes[i]), caster.bound_center) + planes[i].w < -caster.bound_radius)
+				return false;
+		}
+		return true;
+	}
+
+	uint64_t hash_lod(const ShadowCaster& caster, uint64_t seed)
+	{
+		return hash_fnv1a(&caster.lod, sizeof(caster.lod), hash_fnv1a(&caster.mesh, sizeof(caster.mesh), seed));
+	}
+
+	// in the order the shaders pick them: +X -X +Y -Y +Z -Z
+	const Vector3 CUBE_FACE_DIRECTIONS[] = {
+		Vector3(1.0f, 0.0f, 0.0f), Vector3(-1.0f, 0.0f, 0.0f),
+		Vector3(0.0f, 1.0f, 0.0f), Vector3(0.0f, -1.0f, 0.0f),
+		Vector3(0.0f, 0.0f, 1.0f), Vector3(0.0f, 0.0f, -1.0f)
+	};
+	const Vector3 CUBE_FACE_UPS[] = {
+		Vector3(0.0f, -1.0f, 0.0f), Vector3(0.0f, -1.0f, 0.0f),
+		Vector3(0.0f, 0.0f, 1.0f), Vector3(0.0f, 0.0f, -1.0f),
+		Vector3(0.0f, -1.0f, 0.0f), Vector3(0.0f, -1.0f, 0.0f)
+	};
+
+	// maps clip space to the texture coordinates of the rectangle at x, y
+	Matrix4 get_texture_matrix(float x, float y, float width, float height)
+	{
+		Matrix4 matrix(1.0f);
+		matrix[0][0] = 0.5f * width;
+		matrix[1][1] = 0.5f * height;
+		matrix[2][2] = 0.5f;
+		matrix[3] = Vector4(x + 0.5f * width, y + 0.5f * height, 0.5f, 1.0f);
+		return matrix;
+	}
+
+	// the live maps are sampled with a comparison and linear filtering, which gives 2x2 PCF
+	void create_depth_texture(unsigned int texture, GLenum target, int width, int height, int layers, bool compare)
+	{
+		CHECK_GL_ERROR(glBindTexture(target, texture));
+		if (target == GL_TEXTURE_2D_ARRAY)
+			CHECK_GL_ERROR(glTexImage3D(target, 0, GL_DEPTH_COMPONENT24, width, height, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL));
+		else
+			CHECK_GL_ERROR(glTexImage2D(target, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL));
+		CHECK_GL_ERROR(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST));
+		CHECK_GL_ERROR(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST));
+		CHECK_GL_ERROR(glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+		CHECK_GL_ERROR(glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+		if (compare)
+		{
+			CHECK_GL_ERROR(glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE));
+			CHECK_GL_ERROR(glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL));
+		}
+		CHECK_GL_ERROR(glBindTexture(target, 0));
+	}
+
+	// depth only, layer < 0 for a 2D texture
+	bool create_framebuffer(unsigned int framebuffer, unsigned int texture, int layer)
+	{
+		CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+		if (layer < 0)
+			CHECK_GL_ERROR(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0));
+		else
+			CHECK_GL_ERROR(glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer));
+		CHECK_GL_ERROR(glDrawBuffer(GL_NONE));
+		CHECK_GL_ERROR(glReadBuffer(GL_NONE));
+
+		const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ShadowRenderer incomplete framebuffer: " << std::hex << status << std::dec << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+bool ShadowRenderer::create()
+{
+	const int atlas_width = TILE_SIZE * ATLAS_COLUMNS;
+	const int atlas_height = TILE_SIZE * ATLAS_ROWS;
+	CHECK_GL_ERROR(glGenTextures(1, &_cascade_map));
+	CHECK_GL_ERROR(glGenTextures(1, &_cascade_cache));
+	CHECK_GL_ERROR(glGenTextures(1, &_atlas));
+	CHECK_GL_ERROR(glGenTextures(1, &_atlas_cache));
+	create_depth_texture(_cascade_map, GL_TEXTURE_2D_ARRAY, CASCADE_SIZE, CASCADE_SIZE, CASCADE_COUNT, true);
+	create_depth_texture(_cascade_cache, GL_TEXTURE_2D_ARRAY, CASCADE_SIZE, CASCADE_SIZE, CASCADE_COUNT, false);
+	create_depth_texture(_atlas, GL_TEXTURE_2D, atlas_width, atlas_height, 1, true);
+	create_depth_texture(_atlas_cache, GL_TEXTURE_2D, atlas_width, atlas_height, 1, false);
+
+	CHECK_GL_ERROR(glGenFramebuffers(CASCADE_COUNT, _cascade_framebuffers));
+	CHECK_GL_ERROR(glGenFramebuffers(CASCADE_COUNT, _cascade_cache_framebuffers));
+	CHECK_GL_ERROR(glGenFramebuffers(1, &_atlas_framebuffer));
+	CHECK_GL_ERROR(glGenFramebuffers(1, &_atlas_cache_framebuffer));
+	bool complete = create_framebuffer(_atlas_framebuffer, _atlas, -1) && create_framebuffer(_atlas_cache_framebuffer, _atlas_cache, -1);
+	for (unsigned int i = 0; i < CASCADE_COUNT && complete; ++i)
+	{
+		complete = create_framebuffer(_cascade_framebuffers[i], _cascade_map, i) && create_framebuffer(_cascade_cache_framebuffers[i], _cascade_cache, i);
+	}
+	if (!complete)
+	{
+		release();
+		return false;
+	}
+	CHECK_GL_ERROR(glGenQueries(2 * CASCADE_COUNT, &_timer_queries[0][0]));
+	return true;
+}
+
+void ShadowRenderer::release()
+{
+	if (!_cascade_map)
+		return;
+	const unsigned int textures[] = { _cascade_map, _cascade_cache, _atlas, _atlas_cache };
+	CHECK_GL_ERROR(glDeleteTextures(4, textures));
+	CHECK_GL_ERROR(glDeleteFramebuffers(CASCADE_COUNT, _cascade_framebuffers));
+	CHECK_GL_ERROR(glDeleteFramebuffers(CASCADE_COUNT, _cascade_cache_framebuffers));
+	CHECK_GL_ERROR(glDeleteFramebuffers(1, &_atlas_framebuffer));
+	CHECK_GL_ERROR(glDeleteFramebuffers(1, &_atlas_cache_framebuffer));
+	if (_timer_queries[0][0])
+		CHECK_GL_ERROR(glDeleteQueries(2 * CASCADE_COUNT, &_timer_queries[0][0]));
+	_cascade_map = _cascade_cache = _atlas = _atlas_cache = 0;
+	_timer_queries[0][0] = 0;
+	_timer_pending[0] = _timer_pending[1] = false;
+	for (auto& view : _cascades)
+	{
+		view.static_valid = false;
+	}
+	_local_views.clear();
+	_omni_views.clear();
+	_spot_views.clear();
+	_cascade_count = 0;
+	_local_view_count = 0;
+}
+
+void ShadowRenderer::render(const ShaderProgram& depth_program, const std::vector<ShadowCaster>& casters, const Camera& camera,
+	const Light& directional_light, const std::vector<Light>& omni_lights, const std::vector<Light>& spot_lights)
+{
+	_stats = Stats();
+	if (!_cascade_map && !create())
+		return;
+
+	_static_casters.clear();
+	_dynamic_casters.clear();
+	uint64_t static_lods = hash_fnv1a(nullptr, 0);
+	for (const auto& caster : casters)
+	{
+		(caster.is_static ? _static_casters : _dynamic_casters).push_back(&caster);
+		if (caster.is_static)
+			static_lods = hash_lod(caster, static_lods);
+	}
+	// the LOD of a static caster follows the camera, its cached depth is stale once it switched
+	_static_lods_changed = static_lods != _static_lods;
+	_static_lods = static_lods;
+
+	GLint viewport[4];
+	GLint framebuffer = 0;
+	CHECK_GL_ERROR(glGetIntegerv(GL_VIEWPORT, viewport));
+	CHECK_GL_ERROR(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer));
+	depth_program.bind();
+	depth_program.set_matrix4("view", Matrix4(1.0f));
+	CHECK_GL_ERROR(glDisable(GL_BLEND));
+	CHECK_GL_ERROR(glDisable(GL_CULL_FACE));
+	CHECK_GL_ERROR(glEnable(GL_DEPTH_TEST));
+	CHECK_GL_ERROR(glDepthFunc(GL_LESS));
+	CHECK_GL_ERROR(glDepthMask(GL_TRUE));
+	CHECK_GL_ERROR(glEnable(GL_SCISSOR_TEST));
+	CHECK_GL_ERROR(glEnable(GL_POLYGON_OFFSET_FILL));
+	CHECK_GL_ERROR(glPolygonOffset(1.5f, 4.0f));
+
+	_cascade_count = 0;
+	if (directional_light.cast_shadows)
+	{
+		update_cascades(camera, directional_light.directional.direction);
+
+		// the queries of the frame before last are done unless the GPU runs more than a frame behind
+		unsigned int* queries = _timer_queries[_timer_index];
+		if (_timer_pending[_timer_index])
+		{
+			GLuint available = 0;
+			CHECK_GL_ERROR(glGetQueryObjectuiv(queries[CASCADE_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available));
+			for (unsigned int i = 0; i < CASCADE_COUNT && available; ++i)
+			{
+				GLuint64 elapsed = 0;
+				CHECK_GL_ERROR(glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed));
+				_stats.cascade_gpu_ms[i] = elapsed * 1e-6f;
+			}
+		}
+		for (unsigned int i = 0; i < CASCADE_COUNT; ++i)
+		{
+			// every query is issued so that all of them are read together
+			const auto start = std::chrono::steady_clock::now();
+			CHECK_GL_ERROR(glBeginQuery(GL_TIME_ELAPSED, queries[i]));
+			if (i < _cascade_count)
+				_stats.cascade_draw_calls[i] = draw_view(_cascades[i], depth_program, _cascade_cache_framebuffers[i], _cascade_framebuffers[i], 0, 0, CASCADE_SIZE);
+			CHECK_GL_ERROR(glEndQuery(GL_TIME_ELAPSED));
+			_stats.cascade_cpu_ms[i] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		_timer_pending[_timer_index] = true;
+		_timer_index ^= 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	_local_view_count = 0;
+	_omni_views.assign(omni_lights.size(), -1);
+	_spot_views.assign(spot_lights.size(), -1);
+	for (size_t i = 0; i < omni_lights.size() && _local_view_count + 6 <= MAX_LOCAL_VIEWS; ++i)
+	{
+		const Light& light = omni_lights[i];
+		const float range = LightGrid::get_light_range(light, _shadow_distance);
+		if (!light.cast_shadows || range <= 0.0f)
+			continue;
+		_omni_views[i] = (int)_local_view_count;
+		for (int face = 0; face < 6; ++face)
+		{
+			add_local_view(light.omni.position, CUBE_FACE_DIRECTIONS[face], CUBE_FACE_UPS[face], glm::radians(OMNI_FACE_FOV), range);
+		}
+	}
+	for (size_t i = 0; i < spot_lights.size() && _local_view_count < MAX_LOCAL_VIEWS; ++i)
+	{
+		const Light& light = spot_lights[i];
+		const float range = LightGrid::get_light_range(light, _shadow_distance);
+		if (!light.cast_shadows || range <= 0.0f)
+			continue;
+		_spot_views[i] = (int)_local_view_count;
+		const Vector3 direction = glm::normalize(light.spot.direction);
+		const Vector3 up = std::abs(direction.y) > 0.99f ? Vector3(1.0f, 0.0f, 0.0f) : Vector3(0.0f, 1.0f, 0.0f);
+		const float fov = std::min(2.0f * std::acos(glm::clamp(light.spot.outerCutOff, 0.0f, 1.0f)) + glm::radians(2.0f), glm::radians(170.0f));
+		add_local_view(light.spot.position, direction, up, fov, range);
+	}
+	for (unsigned int i = 0; i < _local_view_count; ++i)
+	{
+		const int x = (i % ATLAS_COLUMNS) * TILE_SIZE;
+		const int y = (i / ATLAS_COLUMNS) * TILE_SIZE;
+		_stats.local_draw_calls += draw_view(_local_views[i], depth_program, _atlas_cache_framebuffer, _atlas_framebuffer, x, y, TILE_SIZE);
+	}
+	_stats.local_views = _local_view_count;
+	_stats.local_cpu_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	depth_program.unbind();
+	CHECK_GL_ERROR(glDisable(GL_POLYGON_OFFSET_FILL));
+	CHECK_GL_ERROR(glDisable(GL_SCISSOR_TEST));
+	CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+	CHECK_GL_ERROR(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+}
+
+// Each cascade is a slice of the view frustum up to the shadow distance, bounded by a sphere so that
+// its size does not change when the camera turns, and moved by whole texels in light space so that
+// its edges do not shimmer. A still camera keeps the same matrices, and so the static cache.
+void ShadowRenderer::update_cascades(const Camera& camera, const Vector3& light_direction)
+{
+	const float near = camera.get_near();
+	const float far = std::max(std::min(camera.get_far(), _shadow_distance), near * 2.0f);
+	const float tan_y = tan(glm::radians(camera.get_fov()) * 0.5f);
+	const float tan_x = tan_y * camera.get_aspect();
+	const Vector3 forward = glm::normalize(camera.get_forward());
+	const Vector3 right = glm::normalize(glm::cross(forward, camera.get_up()));
+	const Vector3 up = glm::cross(right, forward);
+
+	const Vector3 direction = glm::normalize(light_direction);
+	const Vector3 light_up = std::abs(direction.y) > 0.99f ? Vector3(1.0f, 0.0f, 0.0f) : Vector3(0.0f, 1.0f, 0.0f);
+	const Matrix4 light_rotation = glm::lookAt(Vector3(0.0f), direction, light_up);
+
+	float split_near = near;
+	for (unsigned int i = 0; i < CASCADE_COUNT; ++i)
+	{
+		const float t = (float)(i + 1) / CASCADE_COUNT;
+		const float split_far = glm::mix(near + (far - near) * t, near * std::pow(far / near, t), CASCADE_SPLIT_LAMBDA);
+
+		Vector3 corners[8];
+		Vector3 center(0.0f);
+		for (int k = 0; k < 8; ++k)
+		{
+			const float depth = k < 4 ? split_near : split_far;
+			const float sx = (k & 1) ? 1.0f : -1.0f;
+			const float sy = (k & 2) ? 1.0f : -1.0f;
+			corners[k] = camera.get_position() + forward * depth + right * (sx * tan_x * depth) + up * (sy * tan_y * depth);
+			center += corners[k] * 0.125f;
+		}
+		float radius = 0.0f;
+		for (const auto& corner : corners)
+		{
+			radius = std::max(radius, glm::distance(center, corner));
+		}
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		const float texel = 2.0f * radius / CASCADE_SIZE;
+		const Vector3 light_center = glm::floor(Vector3(light_rotation * Vector4(center, 1.0f)) / texel) * texel;
+		const Matrix4 view = glm::translate(Matrix4(1.0f), -light_center) * light_rotation;
+		const Matrix4 projection = glm::ortho(-radius, radius, -radius, radius, -radius - CASCADE_CASTER_DISTANCE, radius);
+		_cascades[i].view_projection = projection * view;
+		_cascade_matrices[i] = get_texture_matrix(0.0f, 0.0f, 1.0f, 1.0f) * _cascades[i].view_projection;
+		split_near = split_far;
+	}
+	_cascade_count = CASCADE_COUNT;
+}
+
+void ShadowRenderer::add_local_view(const Vector3& position, const Vector3& direction, const Vector3& up, float fov, float range)
+{
+	const unsigned int index = _local_view_count++;
+	if (_local_views.size() < _local_view_count)
+	{
+		_local_views.resize(_local_view_count, View());
+		_local_matrices.resize(_local_view_count);
+	}
+	const Matrix4 projection = glm::perspective(fov, 1.0f, LOCAL_NEAR, std::max(range, LOCAL_NEAR * 2.0f));
+	_local_views[index].view_projection = projection * glm::lookAt(position, position + direction, up);
+	const float column = (float)(index % ATLAS_COLUMNS) / ATLAS_COLUMNS;
+	const float row = (float)(index / ATLAS_COLUMNS) / ATLAS_ROWS;
+	_local_matrices[index] = get_texture_matrix(column, row, 1.0f / ATLAS_COLUMNS, 1.0f / ATLAS_ROWS) * _local_views[index].view_projection;
+}
+
+// The static casters are drawn into the cache when the view or one of them moved, or one of those in
+// the view switched LOD. When that happened, or dynamic casters are in the view now or were last
+// frame, the cache is copied to the live map and the dynamic casters drawn over it. Otherwise the live
+// map is still right.
+unsigned int ShadowRenderer::draw_view(View& view, const ShaderProgram& depth_program, unsigned int cache_framebuffer, unsigned int live_framebuffer, int x, int y, int size)
+{
+	unsigned int draw_calls = 0;
+	CHECK_GL_ERROR(glViewport(x, y, size, size));
+	CHECK_GL_ERROR(glScissor(x, y, size, size));
+	depth_program.set_matrix4("projection", view.view_projection);
+
+	bool redraw_static = !view.static_valid || view.static_generation != _static_generation || view.cached_view_projection != view.view_projection;
+	const uint64_t static_lods = (redraw_static || _static_lods_changed) ? hash_static_lods(view.view_projection) : view.static_lods;
+	redraw_static = redraw_static || static_lods != view.static_lods;
+	if (redraw_static)
+	{
+		CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, cache_framebuffer));
+		CHECK_GL_ERROR(glClear(GL_DEPTH_BUFFER_BIT));
+		cull_casters(_static_casters, view.view_projection);
+		draw_calls += draw_visible(depth_program);
+		view.cached_view_projection = view.view_projection;
+		view.static_generation = _static_generation;
+		view.static_lods = static_lods;
+		view.static_valid = true;
+		++_stats.static_views_rendered;
+	}
+
+	cull_casters(_dynamic_casters, view.view_projection);
+	if (redraw_static || view.has_dynamic || !_visible.empty())
+	{
+		CHECK_GL_ERROR(glBindFramebuffer(GL_READ_FRAMEBUFFER, cache_framebuffer));
+		CHECK_GL_ERROR(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, live_framebuffer));
+		CHECK_GL_ERROR(glBlitFramebuffer(x, y, x + size, y + size, x, y, x + size, y + size, GL_DEPTH_BUFFER_BIT, GL_NEAREST));
+		CHECK_GL_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, live_framebuffer));
+		draw_calls += draw_visible(depth_program);
+	}
+	view.has_dynamic = !_visible.empty();
+	return draw_calls;
+}
+
+// bounding spheres against the view frustum, then the clusters of the full detail meshes. Back faces
+// are kept, they cast shadows as well.
+void ShadowRenderer::cull_casters(const std::vector<const ShadowCaster*>& casters, const Matrix4& view_projection)
+{
+	_visible.clear();
+	_ranges.clear();
+	Vector4 planes[6];
+	MeshClusters::extract_frustum_planes(view_projection, planes);
+	for (const auto* caster : casters)
+	{
+		if (!in_frustum(planes, *caster))
+			continue;
+
+		VisibleCaster visible = { caster, 0, 0 };
+		const MeshClusters& clusters = caster->mesh->get_clusters();
+		if (caster->lod == 0 && !clusters.empty())
+		{
+			Vector4 model_planes[6];
+			MeshClusters::extract_frustum_planes(view_projection * caster->model, model_planes);
+			visible.first_range = (unsigned int)_ranges.size();
+			clusters.cull(model_planes, Vector3(0.0f), false, _ranges);
+			visible.range_count = (unsigned int)(_ranges.size() - visible.first_range);
+			if (visible.range_count == 0)
+				continue;
+		}
+		_visible.push_back(visible);
+	}
+}
+
+// by their bounds, as cull_casters
+uint64_t ShadowRenderer::hash_static_lods(const Matrix4& view_projection) const
+{
+	Vector4 planes[6];
+	MeshClusters::extract_frustum_planes(view_projection, planes);
+	uint64_t hash = hash_fnv1a(nullptr, 0);
+	for (const auto* caster : _static_casters)
+	{
+		if (in_frustum(planes, *caster))
+			hash = hash_lod(*caster, hash);
+	}
+	return hash;
+}
+
+unsigned int ShadowRenderer::draw_visible(const ShaderProgram& depth_program) const
+{
+	for (const auto& visible : _visible)
+	{
+		depth_program.set_matrix4("model", visible.caster->model);
+		if (visible.range_count > 0)
+			visible.caster->mesh->draw_position_ranges(&_ranges.counts[visible.first_range], &_ranges.offsets[visible.first_range], visible.range_count);
+		else
+			visible.caster->mesh->draw_positions(visible.caster->lod);
+	}
+	return (unsigned int)_visible.size();
+}
+
+void ShadowRenderer::bind(const ShaderProgram& shader, int first_unit) const
+{
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + first_unit));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D_ARRAY, _cascade_map));
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0 + first_unit + 1));
+	CHECK_GL_ERROR(glBindTexture(GL_TEXTURE_2D, _atlas));
+	CHECK_GL_ERROR(glActiveTexture(GL_TEXTURE0));
+	shader.set_int("shadow_cascades", first_unit);
+	shader.set_int("shadow_atlas", first_unit + 1);
+
+	shader.set_int("shadow_cascade_count", (int)_cascade_count);
+	if (_cascade_count > 0)
+		shader.set_matrix4_array("shadow_cascade_matrices", _cascade_matrices, _cascade_count);
+	if (_local_view_count > 0)
+		shader.set_matrix4_array("shadow_local_matrices", _local_matrices.data(), _local_view_count);
+}
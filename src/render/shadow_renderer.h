@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "math/math.h"
+#include "mesh_cluster.h"
+#include "Light.h"
+
+class Camera;
+class Mesh;
+class ShaderProgram;
+
+// An opaque draw of the frame, before culling against the camera
+struct ShadowCaster
+{
+	const Mesh* mesh;
+	Matrix4 model;
+	unsigned int lod;
+	Vector3 bound_center;	// world space
+	float bound_radius;
+	bool is_static;
+};
+
+// Cascaded shadow maps for the directional light and an atlas of tiles for spot and omni lights,
+// a spot light takes one tile and an omni light six, one per cube face.
+// Every view keeps the depth of the static casters in a cache texture. A view redraws them only when
+// its matrix changes, a static caster moves or one in the view switches LOD, otherwise the cache is
+// copied and the dynamic casters are drawn over it. Casters are drawn with the position only depth
+// program, culled per view by their bounds and then by mesh clusters.
+class ShadowRenderer
+{
+public:
+	static const unsigned int CASCADE_COUNT = 4;
+	static const unsigned int CASCADE_SIZE = 1024;
+	static const unsigned int TILE_SIZE = 512;
+	static const unsigned int ATLAS_COLUMNS = 8;
+	static const unsigned int ATLAS_ROWS = 4;
+	static const unsigned int MAX_LOCAL_VIEWS = ATLAS_COLUMNS * ATLAS_ROWS;
+
+	struct Stats
+	{
+		float cascade_cpu_ms[CASCADE_COUNT];
+		float cascade_gpu_ms[CASCADE_COUNT];		// from timer queries a frame behind
+		unsigned int cascade_draw_calls[CASCADE_COUNT];
+		unsigned int local_views;
+		unsigned int local_draw_calls;
+		float local_cpu_ms;
+		unsigned int static_views_rendered;			// views whose static casters were drawn again
+	};
+
+	ShadowRenderer() = default;
+	~ShadowRenderer() { release(); }
+
+	ShadowRenderer(const ShadowRenderer&) = delete;
+	ShadowRenderer(ShadowRenderer&&) = delete;
+	ShadowRenderer& operator=(const ShadowRenderer&) = delete;
+	ShadowRenderer& operator=(ShadowRenderer&&) = delete;
+
+	// local lights cast shadows in their order until the atlas is full
+	void render(const ShaderProgram& depth_program, const std::vector<ShadowCaster>& casters, const Camera& camera,
+		const Light& directional_light, const std::vector<Light>& omni_lights, const std::vector<Light>& spot_lights);
+	// sets the shadow samplers to their units in any case, so that they never share a unit with a sampler of another type
+	void bind(const ShaderProgram& shader, int first_unit) const;
+	void release();
+
+	// the static casters moved, were added or removed
+	void invalidate_static() { ++_static_generation; }
+
+	// first atlas view of each light, -1 for lights without shadow
+	const std::vector<int>& get_omni_views() const { return _omni_views; }
+	const std::vector<int>& get_spot_views() const { return _spot_views; }
+
+	void set_shadow_distance(float distance) { _shadow_distance = distance; }
+	float get_shadow_distance() const { return _shadow_distance; }
+	const Stats& get_stats() const { return _stats; }
+
+private:
+	struct View
+	{
+		Matrix4 view_projection;
+		Matrix4 cached_view_projection;
+		uint64_t static_generation;
+		uint64_t static_lods;	// hash of the LODs of the static casters in the view when cached
+		bool static_valid;
+		bool has_dynamic;		// the live map holds dynamic casters the cache does not
+	};
+
+	// a caster in the view, with its visible cluster ranges if any
+	struct VisibleCaster
+	{
+		const ShadowCaster* caster;
+		unsigned int first_range;
+		unsigned int range_count;
+	};
+
+	bool create();
+	void update_cascades(const Camera& camera, const Vector3& light_direction);
+	void add_local_view(const Vector3& position, const Vector3& direction, const Vector3& up, float fov, float range);
+	// renders the square region of a view in the live framebuffer, returns the number of draws
+	unsigned int draw_view(View& view, const ShaderProgram& depth_program, unsigned int cache_framebuffer, unsigned int live_framebuffer, int x, int y, int size);
+	void cull_casters(const std::vector<const ShadowCaster*>& casters, const Matrix4& view_projection);
+	uint64_t hash_static_lods(const Matrix4& view_projection) const;
+	unsigned int draw_visible(const ShaderProgram& depth_program) const;
+
+	unsigned int _cascade_map{ 0 };			// depth array, one layer per cascade
+	unsigned int _cascade_cache{ 0 };
+	unsigned int _cascade_framebuffers[CASCADE_COUNT]{ };
+	unsigned int _cascade_cache_framebuffers[CASCADE_COUNT]{ };
+	unsigned int _atlas{ 0 };
+	unsigned int _atlas_cache{ 0 };
+	unsigned int _atlas_framebuffer{ 0 };
+	unsigned int _atlas_cache_framebuffer{ 0 };
+	unsigned int _timer_queries[2][CASCADE_COUNT]{ };	// alternate so that the ones read are a frame old
+	bool _timer_pending[2]{ };
+	unsigned int _timer_index{ 0 };
+
+	View _cascades[CASCADE_COUNT]{ };
+	Matrix4 _cascade_matrices[CASCADE_COUNT]{ };	// world to shadow map texture space
+	unsigned int _cascade_count{ 0 };
+	std::vector<View> _local_views{ };
+	std::vector<Matrix4> _local_matrices{ };		// world to atlas texture space
+	unsigned int _local_view_count{ 0 };
+	std::vector<int> _omni_views{ };
+	std::vector<int> _spot_views{ };
+
+	std::vector<const ShadowCaster*> _static_casters{ };
+	std::vector<const ShadowCaster*> _dynamic_casters{ };
+	std::vector<VisibleCaster> _visible{ };
+	ClusterRanges _ranges{ };
+	uint64_t _static_generation{ 1 };
+	uint64_t _static_lods{ 0 };				// of every static caster, the views check theirs when it changes
+	bool _static_lods_changed{ false };
+	float _shadow_distance{ 60.0f };
+	Stats _stats{ };
+};
@@ -5,6 +5,11 @@
 #include <ostream>
 #include <iostream>
 #include "graphic_api.h"
+#include "texture_manager.h"
+#include "common/file_system.h"
+#include "common/profiler.h"
+
+template<> TextureManager* Singleton<TextureManager>::singleton = nullptr;
 
 Texture::Texture()
 	: _id(0)
@@ -24,18 +29,40 @@ Texture::~Texture()
 	}
 }
 
-bool Texture::load(const std::string& path, bool genMipmap/*=true*/)
+bool Texture::decode(const std::string& path, TextureImage& image)
 {
-	int width, height, channels;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+	PROFILE_ZONE("Texture::decode");
+	FileData file;
+	if (!FileSystem::get_singleton().read(path, file))
+	{
+		std::cout << "Failed to read texture: " << path.c_str() << std::endl;
+		return false;
+	}
+	unsigned char* data = stbi_load_from_memory(file.data, (int)file.size, &image.width, &image.height, &image.channels, 0);
 	if (!data)
 	{
 		std::cout << "Failed to load texture: " << path.c_str() << std::endl;
 		return false;
 	}
+	image.pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+	return true;
+}
+
+bool Texture::load(const std::string& path, bool genMipmap/*=true*/)
+{
+	PROFILE_ZONE("Texture::load");
+	TextureImage image;
+	return decode(path, image) && upload(path, image, genMipmap);
+}
+
+bool Texture::upload(const std::string& path, const TextureImage& image, bool genMipmap/*=true*/)
+{
+	PROFILE_ZONE("Texture::upload");
+	if (!image.pixels)
+		return false;
 
 	GLenum format;
-	switch (channels)
+	switch (image.channels)
 	{
 	case 1: format = GL_RED; break;
 	case 3: format = GL_RGB; break;
@@ -53,8 +80,9 @@ bool Texture::load(const std::string& path, bool genMipmap/*=true*/)
 	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
 	CHECK_GL_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
 
-	CHECK_GL_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, data));
-	stbi_image_free(data);
+	CHECK_GL_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get()));
+	_width = image.width;
+	_height = image.height;
 
 	if (genMipmap)
 	{
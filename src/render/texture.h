@@ -1,6 +1,17 @@
 ﻿#pragma once
 #include <vector>
 #include <map>
+#include <memory>
+#include <string>
+
+// Decoded pixels, independent from any GL context so it can be produced on worker threads
+struct TextureImage
+{
+	int width{ 0 };
+	int height{ 0 };
+	int channels{ 0 };
+	std::shared_ptr<unsigned char> pixels{ };
+};
 
 class Texture
 {
@@ -15,14 +26,19 @@ public:
 	Texture& operator=(Texture&&) = delete;
 
 	void active(unsigned char index = 0) const;
+	unsigned int get_id() const { return _id; }
 
 	size_t get_width() const { return _width; }
 	size_t get_height() const { return _height; }
 	const std::string& get_path() const { return _path; }
 
+	// thread safe, does not touch GL
+	static bool decode(const std::string& path, TextureImage& image);
+
 protected:
 	Texture();
 	bool load(const std::string& path, bool genMipmap = true);
+	bool upload(const std::string& path, const TextureImage& image, bool genMipmap = true);
 
 private:
 	unsigned int _id;
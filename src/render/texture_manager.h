@@ -6,6 +6,7 @@
 #include "common/singleton.h"
 #include "shader.h"
 #include <map>
+#include <mutex>
 #include "texture.h"
 
 class TextureManager : public Singleton<TextureManager>
@@ -20,29 +21,44 @@ public:
 	TextureManager& operator=(const TextureManager&) = delete;
 	TextureManager& operator=(TextureManager&&) = delete;
 
-	bool has_texture(const std::string& path) const { return _textures.find(path) != _textures.end(); }
+	// lookups may come from worker threads, creation needs the GL context thread
+	bool has_texture(const std::string& path) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _textures.find(path) != _textures.end();
+	}
 
 	Texture* get_texture(const std::string& path) const
 	{
+		std::lock_guard<std::mutex> lock(_mutex);
 		const auto iter = _textures.find(path);
 		return iter != _textures.end() ? iter->second : nullptr;
 	}
 
 	Texture* load_texture(const std::string& path)
+	{
+		TextureImage image;
+		return Texture::decode(path, image) ? add_texture(path, image) : nullptr;
+	}
+
+	// uploads an image decoded with Texture::decode
+	Texture* add_texture(const std::string& path, const TextureImage& image)
 	{
 		assert(!has_texture(path));
 		auto texture = new Texture();
-		if (!texture->load(path))
+		if (!texture->upload(path, image))
 		{
 			delete texture;
 			return nullptr;
 		}
+		std::lock_guard<std::mutex> lock(_mutex);
 		_textures[path] = texture;
 		return texture;
 	}
 
 	void cleanup()
 	{
+		std::lock_guard<std::mutex> lock(_mutex);
 		for (auto& pair : _textures)
 		{
 			delete pair.second;
@@ -52,4 +68,5 @@ public:
 
 private:
 	std::map<std::string, Texture*> _textures{ };
+	mutable std::mutex _mutex{ };
 };
@@ -0,0 +1,39 @@
+#version 330 core
+
+// shades the G-buffer with the directional light and the lights of each pixel froxel, see GBuffer and LightGrid
+#include "include/lights.glsl"
+#include "include/shadows.glsl"
+#include "include/clustered_lights.glsl"
+
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_specular;
+uniform sampler2D gbuffer_depth;
+uniform DirectionalLight directional_light;
+uniform vec3 viewPos;
+uniform vec2 viewport_size;
+uniform mat4 inverse_view_projection;
+
+out vec4 FragColor;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+	// nothing was drawn, the clear color stays
+	if (depth == 1.0)
+		discard;
+
+	vec4 position = inverse_view_projection * vec4(vec3(gl_FragCoord.xy / viewport_size, depth) * 2.0 - 1.0, 1.0);
+	vec3 fPos = position.xyz / position.w;
+	vec4 normal_shininess = texelFetch(gbuffer_normal, pixel, 0);
+	vec3 normal = normalize(normal_shininess.xyz);
+	float shininess = normal_shininess.w;
+	vec3 diffuse = texelFetch(gbuffer_albedo, pixel, 0).rgb;
+	vec3 specular = texelFetch(gbuffer_specular, pixel, 0).rgb;
+	vec3 viewDir = normalize(viewPos - fPos);
+
+	vec3 color = calc_directional_light(directional_light, normal, viewDir, diffuse, specular, shininess, calc_directional_shadow(fPos));
+	color += calc_clustered_lights(normal, fPos, viewDir, diffuse, specular, shininess);
+	FragColor = vec4(color, 1.0);
+}
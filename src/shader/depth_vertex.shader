@@ -0,0 +1,17 @@
+#version 330 core
+
+// position only, for the depth pre-pass and the overdraw view. The position is computed like the
+// shaders of the color pass so that both passes produce the same depth.
+layout (location = 0) in vec3 vPos;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+invariant gl_Position;
+
+void main()
+{
+	vec3 fPos = vec3(model * vec4(vPos, 1.0));
+	gl_Position = projection * view * vec4(fPos, 1.0);
+}
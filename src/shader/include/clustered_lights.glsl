@@ -0,0 +1,100 @@
+#pragma once
+
+#include "lights.glsl"
+#include "shadows.glsl"
+
+// omni lights take 4 texels of light_data, spot lights 6 starting at spot_light_base:
+// position constant, ambient linear, diffuse quadratic, specular outerCutOff, direction innerCutOff,
+// shadow view. The shadow view of omni lights replaces outerCutOff.
+uniform samplerBuffer light_data;
+uniform usamplerBuffer light_clusters;	// offset, omni count | spot count << 16
+uniform usamplerBuffer light_indices;
+uniform int spot_light_base;
+uniform vec3 light_grid_size;
+uniform vec2 light_grid_scale;		// tiles per pixel
+uniform vec2 light_grid_slice;		// slice = log(view depth) * x + y
+uniform mat4 view;
+
+OmniLight fetch_omni_light(int index)
+{
+	int base = index * 4;
+	vec4 t0 = texelFetch(light_data, base);
+	vec4 t1 = texelFetch(light_data, base + 1);
+	vec4 t2 = texelFetch(light_data, base + 2);
+	vec4 t3 = texelFetch(light_data, base + 3);
+	OmniLight light;
+	light.position = t0.xyz;
+	light.constant = t0.w;
+	light.ambient = t1.xyz;
+	light.linear = t1.w;
+	light.diffuse = t2.xyz;
+	light.quadratic = t2.w;
+	light.specular = t3.xyz;
+	return light;
+}
+
+SpotLight fetch_spot_light(int index)
+{
+	int base = spot_light_base + index * 6;
+	vec4 t0 = texelFetch(light_data, base);
+	vec4 t1 = texelFetch(light_data, base + 1);
+	vec4 t2 = texelFetch(light_data, base + 2);
+	vec4 t3 = texelFetch(light_data, base + 3);
+	vec4 t4 = texelFetch(light_data, base + 4);
+	SpotLight light;
+	light.position = t0.xyz;
+	light.constant = t0.w;
+	light.ambient = t1.xyz;
+	light.linear = t1.w;
+	light.diffuse = t2.xyz;
+	light.quadratic = t2.w;
+	light.specular = t3.xyz;
+	light.outerCutOff = t3.w;
+	light.direction = t4.xyz;
+	light.innerCutOff = t4.w;
+	return light;
+}
+
+int fetch_omni_shadow_view(int index)
+{
+	return int(texelFetch(light_data, index * 4 + 3).w);
+}
+
+int fetch_spot_shadow_view(int index)
+{
+	return int(texelFetch(light_data, spot_light_base + index * 6 + 5).x);
+}
+
+int get_light_cluster(vec3 fPos)
+{
+	float depth = max(-(view * vec4(fPos, 1.0)).z, 1e-4);
+	ivec3 size = ivec3(light_grid_size);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy * light_grid_scale), ivec2(0), size.xy - 1);
+	int slice = clamp(int(log(depth) * light_grid_slice.x + light_grid_slice.y), 0, size.z - 1);
+	return tile.x + size.x * (tile.y + size.y * slice);
+}
+
+vec3 calc_clustered_lights(vec3 normal, vec3 fPos, vec3 viewDir, vec3 diffuse, vec3 specular, float shininess)
+{
+	uvec2 cluster = texelFetch(light_clusters, get_light_cluster(fPos)).xy;
+	int offset = int(cluster.x);
+	int omni_count = int(cluster.y & 0xFFFFu);
+	int spot_count = int(cluster.y >> 16);
+
+	vec3 color = vec3(0.0);
+	for (int i = 0; i < omni_count; ++i)
+	{
+		int index = int(texelFetch(light_indices, offset + i).r);
+		OmniLight light = fetch_omni_light(index);
+		float shadow = calc_omni_shadow(fetch_omni_shadow_view(index), light.position, fPos);
+		color += calc_omni_light(light, normal, fPos, viewDir, diffuse, specular, shininess, shadow);
+	}
+	offset += omni_count;
+	for (int i = 0; i < spot_count; ++i)
+	{
+		int index = int(texelFetch(light_indices, offset + i).r);
+		float shadow = calc_local_shadow(fetch_spot_shadow_view(index), fPos);
+		color += calc_spot_light(fetch_spot_light(index), normal, fPos, viewDir, diffuse, specular, shininess, shadow);
+	}
+	return color;
+}
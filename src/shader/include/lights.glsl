@@ -0,0 +1,104 @@
+#pragma once
+
+#ifndef NUM_OMNI_LIGHTS
+	#define NUM_OMNI_LIGHTS 0
+#endif
+#ifndef NUM_SPOT_LIGHTS
+	#define NUM_SPOT_LIGHTS 0
+#endif
+
+// shadow scales the diffuse and specular terms, 1 when lit
+struct DirectionalLight {
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	vec3 direction;
+};
+
+struct OmniLight {
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	vec3 position;
+
+	float constant;
+	float linear;
+	float quadratic;
+};
+
+struct SpotLight {
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	vec3 position;
+	vec3 direction;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	float innerCutOff;
+	float outerCutOff;
+};
+
+vec3 calc_directional_light(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 diffuse, vec3 specular, float shininess, float shadow)
+{
+	vec3 lightDir = normalize(-light.direction);
+	// ambient
+	vec3 ambient = light.ambient * diffuse;
+	// diffuse
+	float diff = max(dot(normal, lightDir), 0.0);
+	diffuse = light.diffuse * diff * diffuse * shadow;
+	// specular
+	/*vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);*/
+	vec3 mid = normalize(viewDir + lightDir);
+	float spec = pow(max(dot(normal, mid), 0.0), shininess);
+	specular = light.specular * spec * specular * shadow;
+
+	return ambient + diffuse + specular;
+}
+
+vec3 calc_omni_light(OmniLight light, vec3 normal, vec3 fPos, vec3 viewDir, vec3 diffuse, vec3 specular, float shininess, float shadow)
+{
+	vec3 lightDir = normalize(light.position - fPos);
+	// ambient
+	vec3 ambient = light.ambient * diffuse;
+	// diffuse
+	float diff = max(dot(normal, lightDir), 0.0);
+	diffuse = light.diffuse * diff * diffuse * shadow;
+	// specular
+	vec3 mid = normalize(viewDir + lightDir);
+	float spec = pow(max(dot(normal, mid), 0.0), shininess);
+	specular = light.specular * spec * specular * shadow;
+	// attenuation
+	float distance = length(light.position - fPos);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 calc_spot_light(SpotLight light, vec3 normal, vec3 fPos, vec3 viewDir, vec3 diffuse, vec3 specular, float shininess, float shadow)
+{
+	vec3 lightDir = normalize(light.position - fPos);
+	// ambient
+	vec3 ambient = light.ambient * diffuse;
+	// diffuse
+	float diff = max(dot(normal, lightDir), 0.0);
+	diffuse = light.diffuse * diff * diffuse * shadow;
+	// specular
+	vec3 mid = normalize(viewDir + lightDir);
+	float spec = pow(max(dot(normal, mid), 0.0), shininess);
+	specular = light.specular * spec * specular * shadow;
+	// attenuation
+	float distance = length(light.position - fPos);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	// intensity
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = light.innerCutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+	return (ambient + diffuse + specular) * attenuation * intensity;
+}
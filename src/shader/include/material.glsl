@@ -0,0 +1,21 @@
+#pragma once
+
+#ifndef NUM_DIFFUSE_TEXTURES
+	#define NUM_DIFFUSE_TEXTURES 1
+#endif
+#ifndef NUM_SPECULAR_TEXTURES
+	#define NUM_SPECULAR_TEXTURES 0
+#endif
+
+struct Material {
+#if NUM_DIFFUSE_TEXTURES > 0
+	sampler2D diffuse_textures[NUM_DIFFUSE_TEXTURES];
+#endif
+#if NUM_SPECULAR_TEXTURES > 0
+	sampler2D specular_textures[NUM_SPECULAR_TEXTURES];
+#endif
+#ifdef HAS_NORMAL_MAP
+	sampler2D normal_textures[1];
+#endif
+	float shininess;
+};
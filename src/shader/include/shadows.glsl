@@ -0,0 +1,51 @@
+#pragma once
+
+// see ShadowRenderer. Cascades are tried from the nearest one, local lights keep the index of their
+// first view of shadow_local_matrices in their light data, omni lights have six from it.
+#define MAX_SHADOW_CASCADES 4
+#define MAX_LOCAL_SHADOW_VIEWS 32
+
+uniform sampler2DArrayShadow shadow_cascades;
+uniform sampler2DShadow shadow_atlas;
+uniform int shadow_cascade_count;
+uniform mat4 shadow_cascade_matrices[MAX_SHADOW_CASCADES];
+uniform mat4 shadow_local_matrices[MAX_LOCAL_SHADOW_VIEWS];
+
+float calc_directional_shadow(vec3 fPos)
+{
+	for (int i = 0; i < shadow_cascade_count; ++i)
+	{
+		vec3 coord = (shadow_cascade_matrices[i] * vec4(fPos, 1.0)).xyz;
+		if (all(greaterThanEqual(coord, vec3(0.0))) && all(lessThanEqual(coord, vec3(1.0))))
+			return texture(shadow_cascades, vec4(coord.xy, float(i), coord.z));
+	}
+	return 1.0;
+}
+
+// view < 0 for lights without shadow
+float calc_local_shadow(int view, vec3 fPos)
+{
+	if (view < 0)
+		return 1.0;
+	vec4 coord = shadow_local_matrices[view] * vec4(fPos, 1.0);
+	if (coord.w <= 0.0)
+		return 1.0;
+	return textureProj(shadow_atlas, coord);
+}
+
+// the view of the cube face the fragment is in, in the order +X -X +Y -Y +Z -Z
+float calc_omni_shadow(int view, vec3 light_position, vec3 fPos)
+{
+	if (view < 0)
+		return 1.0;
+	vec3 dir = fPos - light_position;
+	vec3 size = abs(dir);
+	int face;
+	if (size.x >= size.y && size.x >= size.z)
+		face = dir.x >= 0.0 ? 0 : 1;
+	else if (size.y >= size.z)
+		face = dir.y >= 0.0 ? 2 : 3;
+	else
+		face = dir.z >= 0.0 ? 4 : 5;
+	return calc_local_shadow(view + face, fPos);
+}
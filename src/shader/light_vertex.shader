@@ -9,8 +9,11 @@ uniform mat4 model;
 
 out vec3 fColor;
 
+invariant gl_Position;	// the depth pre-pass computes the same position, see depth_vertex
+
 void main()
 {
-	gl_Position = projection * view * model * vec4(vPos, 1.0);
+	vec3 fPos = vec3(model * vec4(vPos, 1.0));
+	gl_Position = projection * view * vec4(fPos, 1.0);
 	fColor = vColor;
 }
\ No newline at end of file
@@ -3,19 +3,32 @@
 layout (location = 0) in vec3 vPos;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec2 vUV;
+#ifdef HAS_NORMAL_MAP
+layout (location = 3) in vec3 vTangent;
+layout (location = 4) in vec3 vBitangent;
+#endif
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
+invariant gl_Position;	// the depth pre-pass computes the same position, see depth_vertex
+
 out vec3 fPos;
 out vec3 fNormal;
 out vec2 fUV;
+#ifdef HAS_NORMAL_MAP
+out mat3 fTBN;
+#endif
 
 void main()
 {
 	fPos = vec3(model * vec4(vPos, 1.0));
 	gl_Position = projection * view * vec4(fPos, 1.0);
-	fNormal = mat3(transpose(inverse(model))) * vNormal;
+	mat3 normal_matrix = mat3(transpose(inverse(model)));
+	fNormal = normal_matrix * vNormal;
 	fUV = vUV;
+#ifdef HAS_NORMAL_MAP
+	fTBN = mat3(normalize(normal_matrix * vTangent), normalize(normal_matrix * vBitangent), normalize(fNormal));
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 330 core
+
+// blended additively, red saturates at eight shaded fragments in a pixel
+out vec4 FragColor;
+
+void main()
+{
+	FragColor = vec4(0.125, 0.03125, 0.0, 1.0);
+}
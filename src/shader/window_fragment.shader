@@ -1,8 +1,6 @@
 #version 330 core
 
-struct Material {
-	sampler2D diffuse_textures[1];
-};
+#include "include/material.glsl"
 
 uniform Material material;
 
@@ -0,0 +1,96 @@
+﻿#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "common/job_system.h"
+#include "render/light_grid.h"
+
+// Measures the CPU cost of assigning lights to the clustered lighting grid.
+// usage: light_grid_bench [--omni N] [--spot N] [--frames N] [--workers N]
+// Lights are spread at random in front of the camera, with the ranges the demo scene uses.
+
+int main(int argc, char** argv)
+{
+	size_t omni_count = 1024;
+	size_t spot_count = 128;
+	unsigned int frames = 100;
+	int workers = -1;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--omni") == 0)
+			omni_count = (size_t)std::atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--spot") == 0)
+			spot_count = (size_t)std::atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--frames") == 0)
+			frames = (unsigned int)std::max(std::atoi(argv[i + 1]), 1);
+		else if (strcmp(argv[i], "--workers") == 0)
+			workers = std::atoi(argv[i + 1]);
+		else
+		{
+			std::cout << "usage: light_grid_bench [--omni N] [--spot N] [--frames N] [--workers N]" << std::endl;
+			return 1;
+		}
+	}
+
+	// no workers runs the slices serially on this thread
+	std::unique_ptr<JobSystem> job_system;
+	if (workers != 0)
+		job_system.reset(new JobSystem(workers > 0 ? (unsigned int)workers : 0));
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Light> omni_lights(omni_count);
+	for (auto& light : omni_lights)
+	{
+		light.type = LightType::Omni;
+		light.ambient = Vector3(0.0f);
+		light.diffuse = Vector3(0.8f);
+		light.specular = Vector3(1.0f);
+		light.omni.position = Vector3(unit(random) * 40.0f, unit(random) * 10.0f, unit(random) * 50.0f - 50.0f);
+		light.omni.constant = 1.0f;
+		light.omni.linear = 0.7f;
+		light.omni.quadratic = 1.8f;
+	}
+	std::vector<Light> spot_lights(spot_count);
+	for (auto& light : spot_lights)
+	{
+		light.type = LightType::Spot;
+		light.ambient = Vector3(0.0f);
+		light.diffuse = Vector3(1.0f);
+		light.specular = Vector3(1.0f);
+		light.spot.position = Vector3(unit(random) * 40.0f, unit(random) * 10.0f, unit(random) * 50.0f - 50.0f);
+		light.spot.direction = glm::normalize(Vector3(unit(random), unit(random), unit(random)) + Vector3(0.0f, 0.0f, 1e-3f));
+		light.spot.constant = 1.0f;
+		light.spot.linear = 0.35f;
+		light.spot.quadratic = 0.44f;
+		light.spot.innerCutOff = glm::cos(glm::radians(25.0f));
+		light.spot.outerCutOff = glm::cos(glm::radians(35.0f));
+	}
+
+	LightGrid grid;
+	const Matrix4 view(1.0f);
+	const float fov_y = glm::radians(45.0f);
+	const float aspect = 16.0f / 9.0f;
+	// the first update sizes the buffers and is left out
+	grid.update(view, fov_y, aspect, 0.1f, 100.0f, omni_lights, spot_lights);
+
+	float total_ms = 0.0f;
+	float best_ms = 0.0f;
+	for (unsigned int i = 0; i < frames; ++i)
+	{
+		grid.update(view, fov_y, aspect, 0.1f, 100.0f, omni_lights, spot_lights);
+		const float ms = grid.get_stats().assign_ms;
+		total_ms += ms;
+		best_ms = i == 0 ? ms : std::min(best_ms, ms);
+	}
+
+	const LightGrid::Stats& stats = grid.get_stats();
+	std::cout << omni_count << " omni and " << spot_count << " spot lights, " << stats.omni_lights << " and " << stats.spot_lights << " in range, "
+		<< (job_system ? job_system->get_worker_count() : 0) << " workers" << std::endl;
+	std::cout << LightGrid::CLUSTER_COUNT << " clusters, " << stats.light_indices << " light indices, at most " << stats.max_cluster_lights << " per cluster" << std::endl;
+	std::cout << "assign " << total_ms / frames << " ms average, " << best_ms << " ms best over " << frames << " frames" << std::endl;
+	return 0;
+}
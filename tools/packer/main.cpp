@@ -0,0 +1,128 @@
+﻿#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "common/pack_file.h"
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <dirent.h>
+	#include <sys/stat.h>
+#endif
+
+// Packs asset files and directories into a single file mounted by the engine at startup.
+// usage: asset_packer [--no-compress] output.pack path...
+// Paths are stored as given on the command line, so run it from the directory the engine runs in.
+
+bool is_directory(const std::string& path)
+{
+#ifdef _WIN32
+	const DWORD attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+void list_files(const std::string& directory, std::vector<std::string>& files)
+{
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE handle = FindFirstFileA((directory + "/*").c_str(), &data);
+	if (handle == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		names.push_back(data.cFileName);
+	} while (FindNextFileA(handle, &data));
+	FindClose(handle);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return;
+	while (const dirent* entry = readdir(dir))
+	{
+		names.push_back(entry->d_name);
+	}
+	closedir(dir);
+#endif
+	// sorted so that the same assets always produce the same pack
+	std::sort(names.begin(), names.end());
+	for (const auto& name : names)
+	{
+		if (name == "." || name == "..")
+			continue;
+		const std::string path = directory + "/" + name;
+		if (is_directory(path))
+			list_files(path, files);
+		else
+			files.push_back(path);
+	}
+}
+
+bool read_file(const std::string& path, std::vector<unsigned char>& data)
+{
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream)
+		return false;
+	data.resize((size_t)stream.tellg());
+	stream.seekg(0);
+	return data.empty() || stream.read(reinterpret_cast<char*>(data.data()), data.size());
+}
+
+int main(int argc, char** argv)
+{
+	bool compress = true;
+	std::string output;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--no-compress") == 0)
+			compress = false;
+		else if (output.empty())
+			output = argv[i];
+		else
+			inputs.push_back(argv[i]);
+	}
+	if (output.empty() || inputs.empty())
+	{
+		std::cout << "usage: asset_packer [--no-compress] output.pack path..." << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> files;
+	for (const auto& input : inputs)
+	{
+		if (is_directory(input))
+			list_files(input, files);
+		else
+			files.push_back(input);
+	}
+
+	PackWriter writer;
+	std::vector<unsigned char> data;
+	for (const auto& file : files)
+	{
+		if (!read_file(file, data))
+		{
+			std::cout << "can not read " << file << std::endl;
+			return 1;
+		}
+		writer.add(file, data, compress);
+	}
+	if (!writer.write(output))
+		return 1;
+
+	std::cout << "packed " << writer.get_entry_count() << " files, " << writer.get_total_size() << " bytes stored in " << writer.get_stored_size() << " bytes" << std::endl;
+	return 0;
+}
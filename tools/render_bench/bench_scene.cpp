@@ -0,0 +1,233 @@
+﻿#include "bench_scene.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "render/renderer.h"
+#include "render/model.h"
+
+namespace
+{
+	bool read_shadows(std::istringstream& stream)
+	{
+		std::string flag;
+		return (stream >> flag) && flag == "shadows";
+	}
+
+	Light make_omni_light(const Vector3& position, const Vector3& color, float linear, float quadratic)
+	{
+		Light light;
+		light.type = LightType::Omni;
+		light.ambient = Vector3(0.0f);
+		light.diffuse = color;
+		light.specular = color;
+		light.omni.position = position;
+		light.omni.constant = 1.0f;
+		light.omni.linear = linear;
+		light.omni.quadratic = quadratic;
+		return light;
+	}
+
+	Light make_spot_light(const Vector3& position, const Vector3& direction, const Vector3& color, float linear, float quadratic, float inner_angle, float outer_angle)
+	{
+		Light light;
+		light.type = LightType::Spot;
+		light.ambient = Vector3(0.0f);
+		light.diffuse = color;
+		light.specular = color;
+		light.spot.position = position;
+		light.spot.direction = glm::normalize(direction);
+		light.spot.constant = 1.0f;
+		light.spot.linear = linear;
+		light.spot.quadratic = quadratic;
+		light.spot.innerCutOff = glm::cos(glm::radians(inner_angle));
+		light.spot.outerCutOff = glm::cos(glm::radians(outer_angle));
+		return light;
+	}
+}
+
+bool BenchScene::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "Failed to open scene " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	for (unsigned int number = 1; std::getline(file, line); ++number)
+	{
+		const size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+
+		std::istringstream stream(line);
+		std::string item;
+		stream >> item;
+		bool valid = true;
+		if (item == "model")
+		{
+			ModelItem model;
+			valid = !!(stream >> model.path >> model.position.x >> model.position.y >> model.position.z >> model.scale);
+			if (!(stream >> model.count >> model.spacing))
+			{
+				model.count = 1;
+				model.spacing = 0.0f;
+			}
+			if (valid)
+				_models.push_back(model);
+		}
+		else if (item == "directional")
+		{
+			Vector3 direction;
+			valid = !!(stream >> direction.x >> direction.y >> direction.z);
+			_directional_light.type = LightType::Directional;
+			_directional_light.ambient = Vector3(0.05f);
+			_directional_light.diffuse = Vector3(0.4f);
+			_directional_light.specular = Vector3(0.5f);
+			_directional_light.directional.direction = direction;
+			_directional_light.cast_shadows = read_shadows(stream);
+			_has_directional_light = valid;
+		}
+		else if (item == "omni")
+		{
+			Vector3 position, color;
+			valid = !!(stream >> position.x >> position.y >> position.z >> color.r >> color.g >> color.b);
+			Light light = make_omni_light(position, color, 0.09f, 0.032f);
+			light.cast_shadows = read_shadows(stream);
+			if (valid)
+				_omni_lights.push_back(light);
+		}
+		else if (item == "spot")
+		{
+			Vector3 position, direction, color;
+			valid = !!(stream >> position.x >> position.y >> position.z >> direction.x >> direction.y >> direction.z >> color.r >> color.g >> color.b);
+			Light light = make_spot_light(position, direction, color, 0.09f, 0.032f, 12.5f, 15.0f);
+			light.cast_shadows = read_shadows(stream);
+			if (valid)
+				_spot_lights.push_back(light);
+		}
+		else if (item == "scatter_lights")
+		{
+			size_t count;
+			float extent;
+			valid = !!(stream >> count >> extent);
+			if (valid)
+				scatter_lights(count, extent);
+		}
+		else if (item == "flashlight")
+		{
+			_has_flashlight = true;
+			_flashlight_shadows = read_shadows(stream);
+		}
+		else if (item == "camera")
+		{
+			CameraPath::Key key;
+			valid = !!(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.forward.x >> key.forward.y >> key.forward.z);
+			if (valid)
+				_camera_path.add_key(key);
+		}
+		else
+		{
+			valid = false;
+		}
+
+		if (!valid)
+		{
+			std::cout << "Invalid scene item at " << path << ":" << number << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void BenchScene::instantiate() const
+{
+	Renderer& renderer = Renderer::get_singleton();
+	if (_has_directional_light)
+		renderer.get_directional_light() = _directional_light;
+
+	// the flashlight goes first, the renderer moves the spot light it is told with the camera
+	renderer.set_camera_spot_light(_has_flashlight ? 0 : -1);
+	if (_has_flashlight)
+	{
+		Light flashlight = make_spot_light(Vector3(0.0f), Vector3(0.0f, 0.0f, -1.0f), Vector3(1.0f), 0.09f, 0.032f, 12.5f, 15.0f);
+		flashlight.cast_shadows = _flashlight_shadows;
+		renderer.add_spot_light(flashlight);
+	}
+	for (const auto& light : _spot_lights)
+	{
+		renderer.add_spot_light(light);
+	}
+	for (const auto& light : _omni_lights)
+	{
+		renderer.add_omni_light(light);
+	}
+
+	for (const auto& item : _models)
+	{
+		auto prototype = new Model(item.path, true);
+		prototype->set_position(item.position);
+		prototype->set_scale(Vector3(item.scale));
+		prototype->set_static(true);
+		renderer.add_model(prototype);
+
+		const unsigned int columns = (unsigned int)std::ceil(std::sqrt((float)item.count));
+		for (unsigned int i = 1; i < item.count; ++i)
+		{
+			auto model = new Model(*prototype);
+			const float x = ((float)(i % columns) - columns * 0.5f) * item.spacing;
+			const float z = -(float)(i / columns) * item.spacing;
+			model->set_position(item.position + Vector3(x, 0.0f, z));
+			renderer.add_model(model);
+		}
+	}
+}
+
+size_t BenchScene::get_model_count() const
+{
+	size_t count = 0;
+	for (const auto& item : _models)
+	{
+		count += item.count;
+	}
+	return count;
+}
+
+float BenchScene::get_extent() const
+{
+	float extent = 10.0f;
+	for (const auto& item : _models)
+	{
+		// the grid of instantiate, the first copy at the position and the rows going away from the camera
+		const unsigned int columns = (unsigned int)std::ceil(std::sqrt((float)item.count));
+		const unsigned int rows = (item.count + columns - 1) / columns;
+		const float left = item.position.x - columns * 0.5f * item.spacing;
+		const float right = item.position.x + (columns * 0.5f - 1.0f) * item.spacing;
+		const float back = item.position.z - (rows - 1) * item.spacing;
+		extent = std::max(extent, 2.0f * std::max(std::abs(left), std::abs(right)));
+		extent = std::max(extent, std::max(-back, -item.position.z));
+	}
+	return extent;
+}
+
+// the same spread as the crowd lights of the demo, from a fixed seed so that runs compare. The lights
+// scattered before offset it, lights scattered again do not fall on the same spots.
+void BenchScene::scatter_lights(size_t count, float extent)
+{
+	std::mt19937 random(1234 + (unsigned int)_scattered_lights);
+	_scattered_lights += count;
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Vector3 color = glm::normalize(Vector3(unit(random), unit(random), unit(random)) + Vector3(0.1f));
+		const Vector3 position((unit(random) - 0.5f) * extent, unit(random) * 6.0f - 2.0f, -unit(random) * extent);
+		if (i % 8 == 7)
+			_spot_lights.push_back(make_spot_light(position, Vector3(0.0f, -1.0f, 0.0f), color, 0.35f, 0.44f, 25.0f, 35.0f));
+		else
+			_omni_lights.push_back(make_omni_light(position, color, 0.7f, 1.8f));
+	}
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include "math/math.h"
+#include "render/Light.h"
+#include "engine/camera_path.h"
+
+// A scene of render_bench, a text file with one item per line. Lines starting with # are comments.
+//   model <path> <x> <y> <z> <scale> [<count> <spacing>]	count static copies on a square grid
+//   directional <dx> <dy> <dz> [shadows]
+//   omni <x> <y> <z> <r> <g> <b> [shadows]
+//   spot <x> <y> <z> <dx> <dy> <dz> <r> <g> <b> [shadows]
+//   scatter_lights <count> <extent>	small lights over the area, one in eight is a spot light facing down
+//   flashlight [shadows]				a spot light following the camera
+//   camera <t> <px> <py> <pz> <fx> <fy> <fz>	key of the camera path, as in CameraPath
+class BenchScene
+{
+public:
+	bool load(const std::string& path);
+	// adds the models and the lights to the renderer, the models stream in
+	void instantiate() const;
+	// small lights over a square of the extent in front of the origin, as scatter_lights of the file
+	void scatter_lights(size_t count, float extent);
+
+	const CameraPath& get_camera_path() const { return _camera_path; }
+	size_t get_model_count() const;
+	// of the square in front of the origin scatter_lights covers to reach every model
+	float get_extent() const;
+	size_t get_light_count() const { return _omni_lights.size() + _spot_lights.size() + (_has_flashlight ? 1 : 0); }
+
+private:
+	struct ModelItem
+	{
+		std::string path;
+		Vector3 position;
+		float scale;
+		unsigned int count;
+		float spacing;
+	};
+
+	std::vector<ModelItem> _models{ };
+	Light _directional_light{ };
+	bool _has_directional_light{ false };
+	std::vector<Light> _omni_lights{ };
+	std::vector<Light> _spot_lights{ };
+	size_t _scattered_lights{ 0 };
+	bool _has_flashlight{ false };
+	bool _flashlight_shadows{ false };
+	CameraPath _camera_path{ };
+};
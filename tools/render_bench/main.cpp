@@ -0,0 +1,413 @@
+﻿#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <vector>
+#include "bench_scene.h"
+#include "engine/engine.h"
+#include "render/renderer.h"
+#include "render/gpu_profiler.h"
+#include "render/gl_interceptor.h"
+#include "render/shader_manager.h"
+#include "render/texture_manager.h"
+#include "render/material_manager.h"
+#include "render/model_loader.h"
+#include "common/job_system.h"
+#include "common/file_system.h"
+#include "common/profiler.h"
+
+// Renders a scene headless and reports the CPU cost of its frames as JSON.
+// usage: render_bench <scene> [options]
+// Run from the repository root, the scenes name their models from there. Frames start once every model
+// is loaded, the warmup frames are left out of the results and of the trace. The heap allocations of
+// every frame are counted, steady frames should make none. The bookkeeping of the bench is left out.
+//   --warmup N                 frames left out before the measured ones, 60 by default
+//   --frames N                 measured frames, 300 by default
+//   --resolution WxH           1280x720 by default
+//   --output file              render_bench.json by default
+//   --pack file                asset.pack by default
+//   --trace file               Chrome trace of the measured frames
+//   --deferred                 deferred shading instead of forward
+//   --depth-prepass            depth pre-pass before the forward passes
+//   --no-shadows
+//   --no-clustered-lights
+//   --lights N                 N more lights scattered over the models of the scene
+//   --no-lod                   every model at full detail, for the triangles the LODs save
+//   --gl-stats                 counts the GL calls of the frames, which costs CPU time of its own
+//   --null-backend             no GPU or driver, the CPU cost of the engine alone and no GPU times
+//   --render-thread            submits the frames on a render thread while the next one is prepared
+//   --frame-cap fps            paces the frames, the spread of the wall time between them shows how evenly
+//   --expect-no-allocations    fails the run when a measured frame allocated, a trace and --gl-stats do
+
+namespace
+{
+	struct FrameSample
+	{
+		float cpu_ms;
+		float interval_ms;		// wall time since the frame before
+		float cull_ms;
+		float sort_ms;
+		float submit_ms;
+		float shadow_ms;
+		float light_assign_ms;
+		unsigned int draw_calls;
+		unsigned int shadow_draw_calls;
+		size_t triangles;
+		size_t clusters_tested;
+		size_t cluster_culled_triangles;
+		unsigned int material_changes;
+		unsigned int mesh_changes;
+		float shaded_fragments_per_pixel;	// a frame behind, 0 without a GPU
+		size_t heap_allocations;
+		size_t arena_bytes;
+	};
+
+	// by every thread, those between two calls of the frame handler are the ones of a frame
+	std::atomic<size_t> heap_allocations{ 0 };
+
+	// nearest rank of sorted values
+	float percentile(const std::vector<float>& sorted, float p)
+	{
+		const size_t rank = (size_t)std::ceil(p / 100.0f * sorted.size());
+		return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+	}
+
+	template<typename Sample, typename Getter>
+	std::vector<float> collect(const std::vector<Sample>& samples, Getter get)
+	{
+		std::vector<float> values;
+		values.reserve(samples.size());
+		for (const auto& sample : samples)
+		{
+			values.push_back((float)get(sample));
+		}
+		return values;
+	}
+
+	void write_summary(std::ostream& out, const std::string& name, std::vector<float> values, bool last = false)
+	{
+		double sum = 0.0;
+		double square_sum = 0.0;
+		for (const float value : values)
+		{
+			sum += value;
+			square_sum += (double)value * value;
+		}
+		const double mean = sum / values.size();
+		const double stddev = std::sqrt(std::max(square_sum / values.size() - mean * mean, 0.0));
+		std::sort(values.begin(), values.end());
+		out << "\t\t\"" << name << "\": { \"mean\": " << mean << ", \"stddev\": " << stddev
+			<< ", \"min\": " << values.front() << ", \"p50\": " << percentile(values, 50.0f) << ", \"p90\": " << percentile(values, 90.0f)
+			<< ", \"p95\": " << percentile(values, 95.0f) << ", \"p99\": " << percentile(values, 99.0f) << ", \"max\": " << values.back()
+			<< " }" << (last ? "" : ",") << "\n";
+	}
+}
+
+void* operator new(size_t size)
+{
+	++heap_allocations;
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+int main(int argc, char** argv)
+{
+	const char* usage = "usage: render_bench <scene> [--warmup N] [--frames N] [--resolution WxH] [--output file] "
+		"[--deferred] [--depth-prepass] [--no-shadows] [--no-clustered-lights] [--pack file] [--trace file] [--lights N] [--no-lod] [--gl-stats] [--null-backend] [--render-thread] [--frame-cap fps] [--expect-no-allocations]";
+	if (argc < 2 || argv[1][0] == '-')
+	{
+		std::cout << usage << std::endl;
+		return 1;
+	}
+	const std::string scene_path = argv[1];
+	unsigned int warmup_frames = 60;
+	unsigned int measured_frames = 300;
+	int width = 1280;
+	int height = 720;
+	std::string output_path = "render_bench.json";
+	std::string pack_path = "asset.pack";
+	std::string trace_path{ };
+	bool deferred = false;
+	bool depth_prepass = false;
+	bool shadows = true;
+	bool clustered_lighting = true;
+	bool lod = true;
+	size_t extra_lights = 0;
+	bool gl_stats = false;
+	bool null_backend = false;
+	bool render_thread = false;
+	float frame_cap = 0.0f;
+	bool expect_no_allocations = false;
+	for (int i = 2; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmup_frames = (unsigned int)std::max(std::atoi(argv[++i]), 0);
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			measured_frames = (unsigned int)std::max(std::atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc)
+			std::sscanf(argv[++i], "%dx%d", &width, &height);
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			output_path = argv[++i];
+		else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+			pack_path = argv[++i];
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			trace_path = argv[++i];
+		else if (strcmp(argv[i], "--deferred") == 0)
+			deferred = true;
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+			depth_prepass = true;
+		else if (strcmp(argv[i], "--no-shadows") == 0)
+			shadows = false;
+		else if (strcmp(argv[i], "--no-clustered-lights") == 0)
+			clustered_lighting = false;
+		else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+			extra_lights = (size_t)std::max(std::atoi(argv[++i]), 0);
+		else if (strcmp(argv[i], "--no-lod") == 0)
+			lod = false;
+		else if (strcmp(argv[i], "--gl-stats") == 0)
+			gl_stats = true;
+		else if (strcmp(argv[i], "--null-backend") == 0)
+			null_backend = true;
+		else if (strcmp(argv[i], "--render-thread") == 0)
+			render_thread = true;
+		else if (strcmp(argv[i], "--frame-cap") == 0 && i + 1 < argc)
+			frame_cap = (float)std::max(std::atof(argv[++i]), 0.0);
+		else if (strcmp(argv[i], "--expect-no-allocations") == 0)
+			expect_no_allocations = true;
+		else
+		{
+			std::cout << usage << std::endl;
+			return 1;
+		}
+	}
+
+	BenchScene scene;
+	if (!scene.load(scene_path))
+		return 1;
+	scene.scatter_lights(extra_lights, scene.get_extent());
+
+	std::shared_ptr<Profiler> profiler;
+	if (!trace_path.empty())
+		profiler = std::make_shared<Profiler>();
+	std::shared_ptr<JobSystem> job_system = std::make_shared<JobSystem>();
+	std::shared_ptr<FileSystem> file_system = std::make_shared<FileSystem>();
+	file_system->mount(pack_path);
+	std::shared_ptr<Engine> engine = std::make_shared<Engine>();
+	engine->set_headless(true);
+	engine->set_render_backend(null_backend ? RenderBackend::Null : RenderBackend::OpenGL);
+	engine->set_render_thread_enabled(render_thread);
+	engine->set_frame_cap(frame_cap);
+	engine->set_resolution(width, height);
+	engine->set_frame_limit(warmup_frames + measured_frames);
+	if (!scene.get_camera_path().empty())
+		engine->set_camera_path(scene.get_camera_path());
+	std::shared_ptr<Renderer> renderer = std::make_shared<Renderer>();
+	renderer->set_clustered_lighting_enabled(clustered_lighting);
+	renderer->set_shading_mode(deferred ? ShadingMode::Deferred : ShadingMode::Forward);
+	renderer->set_depth_prepass_enabled(depth_prepass);
+	renderer->set_shadows_enabled(shadows);
+	renderer->set_lod_enabled(lod);
+	std::shared_ptr<MaterialManager> material_mgr = std::make_shared<MaterialManager>();
+	std::shared_ptr<ShaderManager> shader_mgr = std::make_shared<ShaderManager>();
+	std::shared_ptr<TextureManager> texture_mgr = std::make_shared<TextureManager>();
+	std::shared_ptr<ModelLoader> model_loader = std::make_shared<ModelLoader>();
+	std::shared_ptr<GLInterceptor> gl_interceptor;
+	if (gl_stats)
+		gl_interceptor = std::make_shared<GLInterceptor>();
+
+	if (!engine->startup())
+		return 1;
+	if (gl_interceptor)
+		gl_interceptor->install();
+
+	// the light program draws the boxes of the models still loading
+	if (!shader_mgr->load_variants("mesh", "src/shader/mesh_vertex.shader", "src/shader/mesh_fragment.shader", ShaderVariant().with_textures(1, 0)) ||
+		!shader_mgr->request("light", "src/shader/light_vertex.shader", "src/shader/light_fragment.shader"))
+		return 1;
+	if (deferred && !shader_mgr->request("deferred_lighting", "src/shader/deferred_lighting_vertex.shader", "src/shader/deferred_lighting_fragment.shader"))
+		return 1;
+	if ((depth_prepass || shadows) && !shader_mgr->request("depth", "src/shader/depth_vertex.shader", "src/shader/depth_fragment.shader"))
+		return 1;
+
+	scene.instantiate();
+
+	std::vector<FrameSample> samples;
+	samples.reserve(measured_frames);
+	// results come a few frames late, those of the warmup are left out the same. A frame without new
+	// results, read or dropped, adds none.
+	std::map<std::string, std::vector<float>> gpu_samples;
+	uint64_t gpu_results_frame = 0;
+	std::vector<GLInterceptor::FrameStats> gl_samples;
+	renderer->get_gpu_profiler().set_enabled(!null_backend);
+	std::chrono::steady_clock::time_point last_frame_end{ };
+	size_t handler_allocations = 0;
+	engine->set_frame_handler([&](unsigned int frame, float cpu_ms)
+	{
+		const size_t frame_allocations = heap_allocations - handler_allocations;
+		// the first frame has none before, its CPU time stands in
+		const auto now = std::chrono::steady_clock::now();
+		const float interval_ms = frame > 0 ? std::chrono::duration<float, std::milli>(now - last_frame_end).count() : cpu_ms;
+		last_frame_end = now;
+		// the handler runs at the end of a frame, the next one is the first measured
+		if (profiler && frame + 1 == warmup_frames)
+			profiler->start_capture();
+		if (frame < warmup_frames)
+		{
+			handler_allocations = heap_allocations;
+			return;
+		}
+		const auto& stats = Renderer::get_singleton().get_frame_stats();
+		samples.push_back({ cpu_ms, interval_ms, stats.cluster_cull_ms, stats.sort_ms, stats.submit_ms, stats.shadow_ms, stats.light_assign_ms,
+			stats.draw_calls, stats.shadow_draw_calls, stats.triangles, stats.clusters_tested, stats.cluster_culled_triangles, stats.material_changes, stats.mesh_changes,
+			stats.shaded_fragments_per_pixel, frame_allocations, stats.arena_bytes });
+		const GpuProfiler& gpu_profiler = Renderer::get_singleton().get_gpu_profiler();
+		if (gpu_profiler.get_results_frame() != gpu_results_frame)
+		{
+			gpu_results_frame = gpu_profiler.get_results_frame();
+			// zones of the same name in a frame add up
+			std::map<std::string, float> gpu_ms;
+			for (const auto& result : gpu_profiler.get_results())
+			{
+				gpu_ms[result.name] += result.ms;
+			}
+			for (const auto& zone : gpu_ms)
+			{
+				gpu_samples[zone.first].push_back(zone.second);
+			}
+		}
+		if (gl_interceptor)
+			gl_samples.push_back(gl_interceptor->get_frame_stats());
+		handler_allocations = heap_allocations;
+	});
+	if (profiler && warmup_frames == 0)
+		profiler->start_capture();
+	engine->run();
+	if (profiler)
+	{
+		profiler->stop_capture();
+		profiler->write_chrome_trace(trace_path);
+	}
+
+	const size_t allocating_frames = std::count_if(samples.begin(), samples.end(), [](const FrameSample& s) { return s.heap_allocations > 0; });
+	const FrameArena::Stats arena_stats = renderer->get_arena_stats();
+	bool written = false;
+	if (!samples.empty())
+	{
+		std::ofstream out(output_path);
+		out << "{\n";
+		out << "\t\"scene\": \"" << scene_path << "\",\n";
+		out << "\t\"resolution\": [" << width << ", " << height << "],\n";
+		out << "\t\"backend\": \"" << (null_backend ? "null" : "opengl") << "\",\n";
+		out << "\t\"options\": { \"deferred\": " << (deferred ? "true" : "false") << ", \"depth_prepass\": " << (depth_prepass ? "true" : "false")
+			<< ", \"shadows\": " << (shadows ? "true" : "false") << ", \"clustered_lighting\": " << (clustered_lighting ? "true" : "false") << ", \"lod\": " << (lod ? "true" : "false")
+			<< ", \"render_thread\": " << (render_thread ? "true" : "false") << ", \"frame_cap\": " << frame_cap << " },\n";
+		out << "\t\"models\": " << scene.get_model_count() << ",\n";
+		out << "\t\"lights\": " << scene.get_light_count() << ",\n";
+		out << "\t\"warmup_frames\": " << warmup_frames << ",\n";
+		out << "\t\"measured_frames\": " << samples.size() << ",\n";
+		double wall_ms = 0.0;
+		for (const auto& sample : samples)
+		{
+			wall_ms += sample.interval_ms;
+		}
+		out << "\t\"frames_per_second\": " << (wall_ms > 0.0 ? samples.size() * 1000.0 / wall_ms : 0.0) << ",\n";
+		out << "\t\"heap_allocating_frames\": " << allocating_frames << ",\n";
+		out << "\t\"frame_arena\": { \"peak_bytes\": " << arena_stats.peak << ", \"capacity_bytes\": " << arena_stats.capacity
+			<< ", \"block_allocations\": " << arena_stats.heap_allocations << " },\n";
+		out << "\t\"frame_wall_ms\": {\n";
+		write_summary(out, "interval", collect(samples, [](const FrameSample& s) { return s.interval_ms; }), true);
+		out << "\t},\n";
+		out << "\t\"frame_cpu_ms\": {\n";
+		write_summary(out, "total", collect(samples, [](const FrameSample& s) { return s.cpu_ms; }));
+		write_summary(out, "cull", collect(samples, [](const FrameSample& s) { return s.cull_ms; }));
+		write_summary(out, "sort", collect(samples, [](const FrameSample& s) { return s.sort_ms; }));
+		write_summary(out, "submit", collect(samples, [](const FrameSample& s) { return s.submit_ms; }));
+		write_summary(out, "shadows", collect(samples, [](const FrameSample& s) { return s.shadow_ms; }));
+		write_summary(out, "light_assign", collect(samples, [](const FrameSample& s) { return s.light_assign_ms; }), true);
+		out << "\t},\n";
+		out << "\t\"frame_gpu_ms\": {\n";
+		size_t zone = 0;
+		for (const auto& values : gpu_samples)
+		{
+			write_summary(out, values.first, values.second, ++zone == gpu_samples.size());
+		}
+		out << "\t},\n";
+		out << "\t\"per_frame\": {\n";
+		write_summary(out, "draw_calls", collect(samples, [](const FrameSample& s) { return s.draw_calls; }));
+		write_summary(out, "shadow_draw_calls", collect(samples, [](const FrameSample& s) { return s.shadow_draw_calls; }));
+		write_summary(out, "triangles", collect(samples, [](const FrameSample& s) { return s.triangles; }));
+		write_summary(out, "clusters_tested", collect(samples, [](const FrameSample& s) { return s.clusters_tested; }));
+		write_summary(out, "cluster_culled_triangles", collect(samples, [](const FrameSample& s) { return s.cluster_culled_triangles; }));
+		write_summary(out, "material_changes", collect(samples, [](const FrameSample& s) { return s.material_changes; }));
+		write_summary(out, "mesh_changes", collect(samples, [](const FrameSample& s) { return s.mesh_changes; }));
+		write_summary(out, "shaded_fragments_per_pixel", collect(samples, [](const FrameSample& s) { return s.shaded_fragments_per_pixel; }));
+		write_summary(out, "heap_allocations", collect(samples, [](const FrameSample& s) { return s.heap_allocations; }));
+		write_summary(out, "arena_bytes", collect(samples, [](const FrameSample& s) { return s.arena_bytes; }), true);
+		out << (gl_samples.empty() ? "\t}\n" : "\t},\n");
+		if (!gl_samples.empty())
+		{
+			typedef GLInterceptor::FrameStats GLStats;
+			out << "\t\"gl\": {\n";
+			write_summary(out, "calls", collect(gl_samples, [](const GLStats& s) { return s.calls; }));
+			write_summary(out, "draws", collect(gl_samples, [](const GLStats& s) { return s.draws; }));
+			write_summary(out, "state_changes", collect(gl_samples, [](const GLStats& s) { return s.state_changes; }));
+			write_summary(out, "redundant_state_changes", collect(gl_samples, [](const GLStats& s) { return s.redundant_state_changes; }));
+			write_summary(out, "uniform_updates", collect(gl_samples, [](const GLStats& s) { return s.uniform_updates; }));
+			write_summary(out, "queries", collect(gl_samples, [](const GLStats& s) { return s.queries; }));
+			write_summary(out, "uploaded_bytes", collect(gl_samples, [](const GLStats& s) { return s.uploaded_bytes; }));
+			// mean calls a frame of the entry points called
+			out << "\t\t\"calls_by_entry\": {";
+			const char* separator = " ";
+			for (unsigned int entry = 0; entry < GLInterceptor::get_entry_count(); ++entry)
+			{
+				double sum = 0.0;
+				for (const auto& sample : gl_samples)
+				{
+					sum += sample.calls_by_entry[entry];
+				}
+				if (sum == 0.0)
+					continue;
+				out << separator << "\"" << GLInterceptor::get_entry_name(entry) << "\": " << sum / gl_samples.size();
+				separator = ", ";
+			}
+			out << " }\n";
+			out << "\t}\n";
+		}
+		out << "}\n";
+		written = !!out;
+	}
+	std::cout << allocating_frames << " of " << samples.size() << " frames allocated from the heap, the frame arena peaked at "
+		<< arena_stats.peak << " bytes" << std::endl;
+	const bool allocations_passed = !expect_no_allocations || allocating_frames == 0;
+	if (!allocations_passed)
+		std::cout << "Expected no heap allocations in the measured frames" << std::endl;
+	if (written)
+		std::cout << "Wrote " << samples.size() << " frames to " << output_path << std::endl;
+	else
+		std::cout << "Failed to write the results to " << output_path << std::endl;
+
+	gl_interceptor.reset();
+	model_loader.reset();
+	texture_mgr.reset();
+	shader_mgr.reset();
+	material_mgr.reset();
+	renderer.reset();
+	engine->shutdown();
+	engine.reset();
+
+	return written && allocations_passed ? 0 : 1;
+}
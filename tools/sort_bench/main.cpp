@@ -0,0 +1,185 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+#include "math/math.h"
+#include "common/radix_sort.h"
+
+// Measures the sort of the render list against the comparison sorts it replaced.
+// usage: sort_bench [--draws N] [--rounds N] [--programs N] [--materials N]
+// The draws get random programs, materials and bounds in front of the camera, keyed as the renderer
+// keys them: program, material and quantized distance for the opaque draws, the inverted distance alone
+// for the translucent ones. Every round sorts the same unsorted input, the copies are not timed.
+
+namespace
+{
+	// the layout of Renderer::RenderInfo, which the comparison sort of the draws moves around
+	struct Draw
+	{
+		void* mesh;
+		Matrix4 model;
+		unsigned int lod;
+		unsigned int first_range;
+		unsigned int range_count;
+		Vector3 bound_center;
+		float bound_radius;
+		bool is_static;
+	};
+
+	struct Timing
+	{
+		double total_ms;
+		double best_ms;
+	};
+
+	template<typename Sort>
+	Timing measure(unsigned int rounds, Sort sort)
+	{
+		Timing timing{ 0.0, 0.0 };
+		for (unsigned int i = 0; i < rounds; ++i)
+		{
+			const double ms = sort();
+			timing.total_ms += ms;
+			timing.best_ms = i == 0 ? ms : std::min(timing.best_ms, ms);
+		}
+		return timing;
+	}
+
+	double elapsed_ms(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void print(const char* name, const Timing& timing, unsigned int rounds)
+	{
+		std::cout << name << ": " << timing.total_ms / rounds << " ms average, " << timing.best_ms << " ms best" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t draw_count = 100000;
+	unsigned int rounds = 20;
+	unsigned int program_count = 8;
+	unsigned int material_count = 64;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--draws") == 0)
+			draw_count = (size_t)std::max(std::atoi(argv[i + 1]), 1);
+		else if (strcmp(argv[i], "--rounds") == 0)
+			rounds = (unsigned int)std::max(std::atoi(argv[i + 1]), 1);
+		else if (strcmp(argv[i], "--programs") == 0)
+			program_count = (unsigned int)std::min(std::max(std::atoi(argv[i + 1]), 1), 0xFFFF);
+		else if (strcmp(argv[i], "--materials") == 0)
+			material_count = (unsigned int)std::min(std::max(std::atoi(argv[i + 1]), 1), 0xFFFF);
+		else
+		{
+			std::cout << "usage: sort_bench [--draws N] [--rounds N] [--programs N] [--materials N]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Draw> draws(draw_count);
+	std::vector<uint64_t> opaque_keys(draw_count);
+	std::vector<uint64_t> translucent_keys(draw_count);
+	const Vector3 camera_position(0.0f);
+	const float far_plane = 100.0f;
+	const float depth_scale = 65535.0f / far_plane;
+	for (size_t i = 0; i < draw_count; ++i)
+	{
+		Draw& draw = draws[i];
+		draw.mesh = nullptr;
+		draw.bound_center = Vector3(unit(random) * 40.0f, unit(random) * 10.0f, unit(random) * 50.0f - 50.0f);
+		draw.model = Matrix4(1.0f);
+		draw.model[3] = Vector4(draw.bound_center, 1.0f);
+		draw.lod = 0;
+		draw.first_range = 0;
+		draw.range_count = 0;
+		draw.bound_radius = 1.0f;
+		draw.is_static = true;
+
+		const uint64_t depth = (uint64_t)glm::clamp(glm::distance(camera_position, draw.bound_center) * depth_scale, 0.0f, 65535.0f);
+		const uint64_t program = random() % program_count;
+		const uint64_t material = random() % material_count;
+		opaque_keys[i] = program << 32 | material << 16 | depth;
+		translucent_keys[i] = 0xFFFF - depth;
+	}
+
+	std::vector<uint64_t> keys(draw_count);
+	std::vector<uint32_t> order(draw_count);
+	std::vector<uint64_t> key_scratch(draw_count);
+	std::vector<uint32_t> order_scratch(draw_count);
+	std::vector<uint32_t> radix_order(draw_count);
+	const auto radix = [&](const std::vector<uint64_t>& input)
+	{
+		return [&]()
+		{
+			keys = input;
+			for (size_t i = 0; i < draw_count; ++i)
+			{
+				order[i] = (uint32_t)i;
+			}
+			uint64_t* sorted_keys = keys.data();
+			uint32_t* sorted_order = order.data();
+			uint64_t* sorted_key_scratch = key_scratch.data();
+			uint32_t* sorted_order_scratch = order_scratch.data();
+			const auto start = std::chrono::steady_clock::now();
+			radix_sort(sorted_keys, sorted_order, draw_count, sorted_key_scratch, sorted_order_scratch);
+			const double ms = elapsed_ms(start);
+			std::copy(sorted_order, sorted_order + draw_count, radix_order.begin());
+			return ms;
+		};
+	};
+	const Timing opaque_radix = measure(rounds, radix(opaque_keys));
+	const Timing translucent_radix = measure(rounds, radix(translucent_keys));
+
+	// the radix sort is stable, the same keys and indices give the same order
+	std::vector<std::pair<uint64_t, uint32_t>> pairs(draw_count);
+	const Timing opaque_stable = measure(rounds, [&]()
+	{
+		for (size_t i = 0; i < draw_count; ++i)
+		{
+			pairs[i] = std::make_pair(opaque_keys[i], (uint32_t)i);
+		}
+		const auto start = std::chrono::steady_clock::now();
+		std::stable_sort(pairs.begin(), pairs.end(),
+			[](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+		return elapsed_ms(start);
+	});
+	radix(opaque_keys)();
+	for (size_t i = 0; i < draw_count; ++i)
+	{
+		if (pairs[i].second != radix_order[i])
+		{
+			std::cout << "the radix sort and std::stable_sort disagree at draw " << i << std::endl;
+			return 1;
+		}
+	}
+
+	// what the renderer did before, the draws themselves by the distance of the model translation
+	std::vector<Draw> sorted_draws(draw_count);
+	const Timing draw_sort = measure(rounds, [&]()
+	{
+		sorted_draws = draws;
+		const auto start = std::chrono::steady_clock::now();
+		std::sort(sorted_draws.begin(), sorted_draws.end(), [&](const Draw& a, const Draw& b)
+		{
+			return glm::distance(camera_position, Vector3(a.model[3])) < glm::distance(camera_position, Vector3(b.model[3]));
+		});
+		return elapsed_ms(start);
+	});
+
+	std::cout << draw_count << " draws, " << program_count << " programs, " << material_count << " materials, " << rounds << " rounds" << std::endl;
+	print("radix sort of the opaque keys", opaque_radix, rounds);
+	print("radix sort of the translucent keys", translucent_radix, rounds);
+	print("std::stable_sort of the opaque keys", opaque_stable, rounds);
+	print("std::sort of the draws by distance", draw_sort, rounds);
+	return 0;
+}